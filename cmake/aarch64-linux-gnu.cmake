@@ -0,0 +1,21 @@
+# Cross toolchain for AArch64 Linux (Debian/Ubuntu gcc-aarch64-linux-gnu)
+#
+#   cmake -S . -B build-arm64 -DCMAKE_TOOLCHAIN_FILE=cmake/aarch64-linux-gnu.cmake
+#
+# The test programs run under qemu-user, see README.md.
+
+set(CMAKE_SYSTEM_NAME Linux)
+set(CMAKE_SYSTEM_PROCESSOR aarch64)
+
+set(YCRYPT_CROSS_PREFIX aarch64-linux-gnu- CACHE STRING "Cross compiler prefix")
+set(YCRYPT_CROSS_SYSROOT /usr/aarch64-linux-gnu CACHE PATH "Target root for libraries and qemu -L")
+
+set(CMAKE_C_COMPILER ${YCRYPT_CROSS_PREFIX}gcc)
+set(CMAKE_FIND_ROOT_PATH ${YCRYPT_CROSS_SYSROOT})
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_PACKAGE ONLY)
+
+# "-cpu max" exposes the SM3/SM4 hwcaps, e.g. -cpu cortex-a72 does not
+set(CMAKE_CROSSCOMPILING_EMULATOR qemu-aarch64 -cpu max -L ${YCRYPT_CROSS_SYSROOT})
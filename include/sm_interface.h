@@ -89,12 +89,294 @@ int sm2_verify(
     size_t id_len,
     const PubKey* pubkey);
 
+/**
+ * A public key with its identity digest ZA = SM3(ENTL || id || a || b ||
+ * xG || yG || xA || yA), computed once at init. Signing or verifying
+ * with it then only hashes ZA || M. Read-only after init, so one context
+ * can serve any number of threads.
+ */
+typedef struct SM2_ID_CTX
+{
+    PubKey pubkey;
+    u1 ZA[32];
+} SM2_ID_CTX;
+
+/**
+ * @return 1 on success, 0 if id is longer than 50 bytes or the key is invalid
+ */
+int sm2_id_ctx_init(SM2_ID_CTX *ctx, const u1 *id, size_t id_len, const PubKey *pubkey);
+
+/**
+ * dgst = e = SM3(ZA || M)
+ */
+void sm2_id_ctx_digest(const SM2_ID_CTX *ctx, const u1 *msg, size_t msg_len, u1 dgst[32]);
+
+/**
+ * sm2_sign / sm2_verify with the id and public key of ctx
+ * @return 1 on success / if signature is valid, 0 otherwise
+ */
+int sm2_sign_id_ctx(
+    SM2SIG *sig,
+    const u1 *msg,
+    size_t msg_len,
+    const SM2_ID_CTX *ctx,
+    const PrivKey *privkey);
+int sm2_verify_id_ctx(
+    const SM2SIG *sig,
+    const u1 *msg,
+    size_t msg_len,
+    const SM2_ID_CTX *ctx);
+
+/**
+ * A signing key with its id context and (1 + d)^-1 mod n computed once
+ * at init: s = (1 + d)^-1 * (k + r) - r then costs one modular
+ * multiplication and no inversion. Holds secret material, wipe it with
+ * sm2_sign_ctx_clean. Read-only after init, so one context can serve any
+ * number of threads.
+ */
+typedef struct SM2_SIGN_CTX
+{
+    SM2_ID_CTX id;
+    u32 inv;
+} SM2_SIGN_CTX;
+
+/**
+ * @return 1 on success, 0 if the id or key is invalid or pubkey is not d * G
+ */
+int sm2_sign_ctx_init(
+    SM2_SIGN_CTX *ctx,
+    const u1 *id,
+    size_t id_len,
+    const PubKey *pubkey,
+    const PrivKey *privkey);
+void sm2_sign_ctx_clean(SM2_SIGN_CTX *ctx);
+
+/**
+ * sm2_sign with the id and keys of ctx
+ * @return 1 on success, 0 on failure
+ */
+int sm2_sign_ctx(
+    SM2SIG *sig,
+    const u1 *msg,
+    size_t msg_len,
+    const SM2_SIGN_CTX *ctx);
+
+/**
+ * Verify n signatures over 32-byte digests e = SM3(ZA || M), dgsts holds
+ * n * 32 bytes. Each signature is checked on its own, the field inversions
+ * are shared by up to 16 of them and the public key window tables are
+ * built in affine form. Bit i % 8 of valid[i / 8] ((n + 7) / 8 bytes) is
+ * set when signature i is valid.
+ * @return 1 if every signature is valid, 0 otherwise
+ */
+int sm2_verify_dgst_batch(
+    const SM2SIG *sigs,
+    const u1 *dgsts,
+    const PubKey *pubkeys,
+    size_t n,
+    u1 *valid);
+
+/**
+ * Comb table of one public key, 2^w - 1 points for every w-bit window of
+ * the scalar: tP then costs ceil(256 / w) point additions and no
+ * doublings, about the price of sG. A table takes ceil(256 / w) *
+ * (2^w - 1) * 64 bytes: 64 KB for w = 4, 173 KB for w = 6, 510 KB for
+ * w = 8, and a few milliseconds to build. Read-only after init, so one
+ * table can serve any number of threads.
+ */
+typedef struct SM2_PUBKEY_TABLE
+{
+    PubKey pubkey;
+    int w;
+    AFPoint *table;
+} SM2_PUBKEY_TABLE;
+
+/**
+ * Build the table of pubkey with w-bit windows, 1 <= w <= 8
+ * @return 1 on success, 0 if the key is invalid or out of memory
+ */
+int sm2_pubkey_table_init(SM2_PUBKEY_TABLE *tab, const PubKey *pubkey, int w);
+void sm2_pubkey_table_clean(SM2_PUBKEY_TABLE *tab);
+
+/**
+ * Verify a signature over e = SM3(ZA || M) with the table of the key
+ * @return 1 if signature is valid, 0 if invalid
+ */
+int sm2_verify_dgst_table(
+    const SM2SIG *signature,
+    const u1 dgst[32],
+    const SM2_PUBKEY_TABLE *tab);
+
+/**
+ * Least recently used cache of up to capacity public key tables, for
+ * services that see the same few keys over and over. Lookups scan the
+ * entries, so keep capacity in the tens. Not locked: use one cache per
+ * thread or serialize the calls.
+ */
+typedef struct SM2_PUBKEY_CACHE
+{
+    SM2_PUBKEY_TABLE *entries;
+    size_t count;
+    size_t capacity;
+    int w;
+} SM2_PUBKEY_CACHE;
+
+/**
+ * @return 1 on success, 0 if capacity is 0, w is out of range or out of memory
+ */
+int sm2_pubkey_cache_init(SM2_PUBKEY_CACHE *cache, size_t capacity, int w);
+void sm2_pubkey_cache_clean(SM2_PUBKEY_CACHE *cache);
+
+/**
+ * Table of pubkey, built on a miss and evicting the least recently used
+ * one when full. The pointer is valid until the next call on the cache.
+ * @return NULL if the key is invalid or out of memory
+ */
+const SM2_PUBKEY_TABLE *sm2_pubkey_cache_get(SM2_PUBKEY_CACHE *cache, const PubKey *pubkey);
+
+/**
+ * Verify a signature over e = SM3(ZA || M) through the cache
+ * @return 1 if signature is valid, 0 if invalid
+ */
+int sm2_verify_dgst_cached(
+    SM2_PUBKEY_CACHE *cache,
+    const SM2SIG *signature,
+    const u1 dgst[32],
+    const PubKey *pubkey);
+
+/**
+ * Random bytes from an SM3 Hash_DRBG (SP 800-90A, GM/T 0105), one per
+ * thread, seeded from the OS and reseeded periodically and after fork.
+ * Signing nonces come from here; any length, in one call.
+ */
+void sm3_drbg_random(u1 *out, size_t len);
+
 // ===============================
 // ============ SM3 ==============
 // ===============================
 size_t sm3		(const u1 * data, size_t len, u1 digest[SM3_DIGEST_LENGTH]);
 size_t sm3_hmac	(const u1 * data, size_t len, const u1 * key, size_t keyLen, u1 mac[SM3_HMAC_SIZE]);
 
+/*
+ * HMAC-SM3 key with the key ^ ipad and key ^ opad blocks compressed
+ * once: a MAC then costs the message blocks and one outer compression.
+ * Read-only after init, so one key can serve any number of threads.
+ */
+typedef struct {
+    uint32_t ipad_digest[8];
+    uint32_t opad_digest[8];
+} SM3_HMAC_KEY;
+
+void   sm3_hmac_key_init(SM3_HMAC_KEY *hkey, const u1 *key, size_t key_len);
+void   sm3_hmac_key_clean(SM3_HMAC_KEY *hkey);
+size_t sm3_hmac_with_key(const SM3_HMAC_KEY *hkey, const u1 *data, size_t len, u1 mac[SM3_HMAC_SIZE]);
+
+/**
+ * GM/T 0003 key derivation with SM3: len bytes of SM3(z || ct) for
+ * ct = 1, 2, ... as a 32-bit big-endian counter, written straight to out.
+ * SM3_KDF_CTX in sm3.h streams the same output in pieces.
+ * @return 1 on success, 0 if len exceeds (2^32 - 1) * SM3_DIGEST_LENGTH
+ */
+int sm3_kdf(const u1 *z, size_t zlen, u1 *out, size_t len);
+
+/**
+ * SM3 of a file, regular files are mmap'ed instead of copied, pipes and
+ * other descriptors are read(). sm3_fd hashes from the current offset to
+ * EOF and leaves the offset there. A mapped file that is truncated while
+ * it is hashed raises SIGBUS.
+ * @return 1 on success, 0 on failure (errno set)
+ */
+int sm3_fd(int fd, u1 digest[SM3_DIGEST_LENGTH]);
+int sm3_file(const char *path, u1 digest[SM3_DIGEST_LENGTH]);
+
+/*
+ * SM3 tree mode: NOT the same digest as sm3(). Chunks of chunk_size
+ * bytes are hashed on `threads` threads (0: one per online CPU) and a
+ * root hash is taken over the chunk hashes; the format is specified in
+ * sm3/sm3_tree.c. Both sides must agree on SM3_TREE_VERSION and
+ * chunk_size, a non-zero multiple of SM3_BLOCK_SIZE.
+ * sm3_tree_file maps a regular file (POSIX only).
+ * @return 1 on success, 0 on bad chunk_size, I/O or allocation failure
+ */
+#define SM3_TREE_VERSION        1
+#define SM3_TREE_CHUNK_DEFAULT  ((size_t)1 << 20)
+int sm3_tree(const u1 *data, size_t len, size_t chunk_size, unsigned int threads, u1 digest[SM3_DIGEST_LENGTH]);
+int sm3_tree_file(const char *path, size_t chunk_size, unsigned int threads, u1 digest[SM3_DIGEST_LENGTH]);
+
+/* SM3 implementation selection, the default picks the fastest for this CPU */
+typedef enum {
+    SM3_IMPL_AUTO = 0,
+    SM3_IMPL_PORTABLE,      /* scalar, any CPU */
+    SM3_IMPL_AVX2,          /* x86-64 AVX2, 8 multi-buffer lanes (+ SSSE3 single stream) */
+    SM3_IMPL_AVX512,        /* x86-64 AVX-512, 16 multi-buffer lanes */
+    SM3_IMPL_SSSE3,         /* x86-64 SSSE3 message expansion, single stream only */
+    SM3_IMPL_ARMV8          /* AArch64 SM3 instructions (Linux), single stream only */
+} SM3_IMPL;
+
+/**
+ * Force an SM3 implementation for all later calls in the process. For
+ * tests and benchmarks only: must not be called while other threads use
+ * the library.
+ * @return 1 on success, 0 if unavailable on this CPU
+ */
+int sm3_set_impl(SM3_IMPL impl);
+const char *sm3_get_impl_name(void);
+
+/* SM3 multi-buffer job: one message, owned by the caller until it completes */
+typedef struct {
+    const u1 *data;
+    size_t len;
+    u1 digest[SM3_DIGEST_LENGTH];   /* written when the job is returned */
+    void *user_data;                /* not touched by the manager */
+} SM3_MB_JOB;
+
+#define SM3_MB_MAX_LANES 16
+
+typedef struct {
+    SM3_MB_JOB *job;                /* NULL when the lane is free */
+    const u1 *data;                 /* next block to compress */
+    size_t nblocks;                 /* blocks left in the current segment */
+    int in_tail;                    /* compressing tail[] */
+    int done;                       /* digest written, job not returned yet */
+    u1 tail[2 * SM3_BLOCK_SIZE];    /* last partial block and the padding */
+    size_t tail_blocks;
+} SM3_MB_LANE;
+
+/* SM3 multi-buffer job manager, must not be moved while jobs are in flight */
+typedef struct {
+    uint32_t state[8 * SM3_MB_MAX_LANES];   /* word i of lane d at [i * lanes + d] */
+    SM3_MB_LANE lane[SM3_MB_MAX_LANES];
+    size_t lanes;
+    const void *backend;
+} SM3_MB_MGR;
+
+/*
+ * SM3 multi-buffer API: messages of any length are hashed in parallel
+ * SIMD lanes. submit hands a job to the manager and returns a completed
+ * job or NULL; once all lanes are busy it compresses until one finishes.
+ * flush returns the next completed job, NULL when the manager is empty.
+ * Jobs complete in any order.
+ */
+void        sm3_mb_init(SM3_MB_MGR *mgr);
+SM3_MB_JOB *sm3_mb_submit(SM3_MB_MGR *mgr, SM3_MB_JOB *job);
+SM3_MB_JOB *sm3_mb_flush(SM3_MB_MGR *mgr);
+
+/* Hash njobs messages through one manager */
+void sm3_mb(SM3_MB_JOB *jobs, size_t njobs);
+
+/*
+ * Batch HMAC-SM3 over the multi-buffer engine: message i (msgs[i],
+ * lens[i]) with key *keys[i]; the same key may appear any number of
+ * times. sm3_hmac_batch writes n tags to macs (n * SM3_HMAC_SIZE bytes).
+ * sm3_hmac_verify_batch checks them against tags and sets bit i % 8 of
+ * valid[i / 8] when tag i matches, in constant time for the tag bytes.
+ * @return 1 if every tag matches, 0 otherwise
+ */
+void sm3_hmac_batch(const SM3_HMAC_KEY *const *keys, const u1 *const *msgs, const size_t *lens,
+                    size_t n, u1 *macs);
+int  sm3_hmac_verify_batch(const SM3_HMAC_KEY *const *keys, const u1 *const *msgs, const size_t *lens,
+                           const u1 *tags, size_t n, u1 *valid);
+
 
 // ===============================
 // ============ SM4 ==============
@@ -106,6 +388,30 @@ void sm4_encrypt(const uint32_t rk[SM4_KEY_SCHEDULE],
 void sm4_decrypt(const uint32_t rk[SM4_KEY_SCHEDULE],
     const u1 ciphertext[SM4_BLOCK_SIZE], u1 plaintext[SM4_BLOCK_SIZE]);
 
+/* SM4 multi-block ECB: nblocks independent blocks, in and out may alias */
+void sm4_encrypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_decrypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+
+/* SM4 implementation selection, the default picks the fastest for this CPU */
+typedef enum {
+    SM4_IMPL_AUTO = 0,
+    SM4_IMPL_PORTABLE,      /* table rounds + bit-sliced multi-block, any CPU */
+    SM4_IMPL_AESNI,         /* x86-64 AES-NI (SSSE3 / AVX2 / AVX-512 + VAES) */
+    SM4_IMPL_GFNI,          /* x86-64 GFNI (AVX2 / AVX-512), YCRYPT_ENABLE_GFNI builds */
+    SM4_IMPL_ARMV8          /* AArch64 SM4 instructions (Linux) */
+} SM4_IMPL;
+
+/**
+ * Force an SM4 implementation for all later calls in the process. For
+ * tests and benchmarks only: must not be called while other threads use
+ * the library.
+ * @return 1 on success, 0 if unavailable on this CPU
+ */
+int sm4_set_impl(SM4_IMPL impl);
+const char *sm4_get_impl_name(void);
+
 /* SM4 CBC mode */
 void sm4_cbc_encrypt(
     const uint32_t rk[SM4_KEY_SCHEDULE],
@@ -120,16 +426,69 @@ void sm4_cbc_decrypt(
     uint8_t *output,
     size_t length);
 
+/*
+ * SM4 CBC decryption of a chunk: output may equal input, iv_out receives
+ * the chaining value for the next chunk (may be the same buffer as iv)
+ */
+void sm4_cbc_decrypt_chain(
+    const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t iv[SM4_BLOCK_SIZE],
+    const uint8_t *input,
+    uint8_t *output,
+    size_t length,
+    uint8_t iv_out[SM4_BLOCK_SIZE]);
+
+/* SM4 CBC multi-buffer job: one independent stream */
+typedef struct {
+    const uint32_t *rk;         /* key schedule of this stream */
+    const uint8_t *iv;
+    const uint8_t *input;
+    uint8_t *output;
+    size_t length;              /* whole blocks only, as sm4_cbc_encrypt */
+} SM4_CBC_JOB;
+
+/* Encrypt njobs CBC streams, interleaved through the SIMD core with per-lane keys */
+void sm4_cbc_encrypt_mb(const SM4_CBC_JOB *jobs, size_t njobs);
+
+/* SM4 CBC mode context */
+typedef struct {
+    uint32_t rk[SM4_KEY_SCHEDULE];
+    u1 iv[SM4_BLOCK_SIZE];          /* chaining value */
+    u1 buffer[SM4_BLOCK_SIZE];      /* partial (or held back) input block */
+    size_t buffer_used;
+    int enc;
+    int padding;
+} SM4_CBC_CTX;
+
+/*
+ * SM4 CBC mode streaming API, functions return 1 on success and 0 on failure.
+ * padding selects PKCS#7. update writes whole blocks only (up to len + 15
+ * bytes), final at most one block; decryption with padding holds back the
+ * last block until final. out may equal in when every update is block aligned,
+ * except for padded decryption where the output lags the input by one block.
+ */
+void sm4_cbc_init(SM4_CBC_CTX *ctx, const u1 key[SM4_KEY_SIZE],
+    const u1 iv[SM4_BLOCK_SIZE], int enc, int padding);
+int  sm4_cbc_update(SM4_CBC_CTX *ctx, const u1 *in, u1 *out, size_t len, size_t *out_len);
+int  sm4_cbc_final(SM4_CBC_CTX *ctx, u1 *out, size_t *out_len);
+void sm4_cbc_clean(SM4_CBC_CTX *ctx);
+
 /* SM4 CTR mode context */
 typedef struct {
     uint32_t rk[SM4_KEY_SCHEDULE];
     u1 counter[SM4_BLOCK_SIZE];
     u1 buffer[SM4_BLOCK_SIZE];
     size_t buffer_used;
+    int ctr32;                      /* only the low 32 bits of counter count */
+    int simd;                       /* AVX2 counter layout and XOR */
 } SM4_CTR_CTX;
 
-/* SM4 CTR mode streaming API */
+/*
+ * SM4 CTR mode streaming API. sm4_ctr_init counts with the whole block as a
+ * 128-bit big-endian integer, sm4_ctr32_init with its last 4 bytes only.
+ */
 void sm4_ctr_init(SM4_CTR_CTX *ctx, const u1 key[SM4_KEY_SIZE], const u1 iv[SM4_BLOCK_SIZE]);
+void sm4_ctr32_init(SM4_CTR_CTX *ctx, const u1 key[SM4_KEY_SIZE], const u1 iv[SM4_BLOCK_SIZE]);
 void sm4_ctr_update(SM4_CTR_CTX *ctx, const u1 *in, u1 *out, size_t len);
 void sm4_ctr_clean(SM4_CTR_CTX *ctx);
 
@@ -138,6 +497,116 @@ size_t sm4_ctr(u1 *input, size_t len, u1 *output, u1 key[SM4_KEY_SIZE], u1 iv[SM
 size_t sm4_ctr_once(const u1 *input, size_t len, u1 *output,
     const u1 key[SM4_KEY_SIZE], const u1 iv[SM4_BLOCK_SIZE]);
 
+/* SM4 GCM mode context */
+typedef struct {
+    uint32_t rk[SM4_KEY_SCHEDULE];
+    u8 Htable[16][2];               /* GHASH key: 4-bit table or powers of H */
+    u1 J0[SM4_BLOCK_SIZE];          /* pre-counter block, masks the tag */
+    u1 counter[SM4_BLOCK_SIZE];
+    u1 X[SM4_BLOCK_SIZE];           /* GHASH accumulator */
+    u1 buffer[SM4_BLOCK_SIZE];      /* keystream of the current partial block */
+    size_t buffer_used;
+    u8 aad_len;
+    u8 msg_len;
+    int aad_done;
+    int ghash_impl;
+} SM4_GCM_CTX;
+
+/* GHASH implementation of SM4 GCM */
+typedef enum {
+    SM4_GHASH_IMPL_AUTO = 0,
+    SM4_GHASH_IMPL_PORTABLE,    /* 4-bit tables, any CPU */
+    SM4_GHASH_IMPL_CLMUL        /* x86-64 PCLMULQDQ */
+} SM4_GHASH_IMPL;
+
+/**
+ * Force a GHASH implementation for GCM contexts initialized afterwards.
+ * For tests and benchmarks only, like sm4_set_impl.
+ * @return 1 on success, 0 if unavailable on this CPU
+ */
+int sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL impl);
+
+/* SM4 GCM mode streaming API, functions return 1 on success and 0 on failure */
+int  sm4_gcm_init(SM4_GCM_CTX *ctx, const u1 key[SM4_KEY_SIZE], const u1 *iv, size_t iv_len);
+int  sm4_gcm_update_aad(SM4_GCM_CTX *ctx, const u1 *aad, size_t len);
+int  sm4_gcm_encrypt_update(SM4_GCM_CTX *ctx, const u1 *in, u1 *out, size_t len);
+int  sm4_gcm_decrypt_update(SM4_GCM_CTX *ctx, const u1 *in, u1 *out, size_t len);
+int  sm4_gcm_encrypt_final(SM4_GCM_CTX *ctx, u1 *tag, size_t tag_len);
+int  sm4_gcm_decrypt_final(SM4_GCM_CTX *ctx, const u1 *tag, size_t tag_len);
+void sm4_gcm_clean(SM4_GCM_CTX *ctx);
+
+/* SM4 GCM mode one-shot API, decrypt returns 0 and wipes output on tag mismatch */
+int sm4_gcm_encrypt(const u1 key[SM4_KEY_SIZE], const u1 *iv, size_t iv_len,
+    const u1 *aad, size_t aad_len, const u1 *input, size_t len,
+    u1 *output, u1 *tag, size_t tag_len);
+int sm4_gcm_decrypt(const u1 key[SM4_KEY_SIZE], const u1 *iv, size_t iv_len,
+    const u1 *aad, size_t aad_len, const u1 *input, size_t len,
+    u1 *output, const u1 *tag, size_t tag_len);
+
+/* SM4 CCM mode context */
+typedef struct {
+    uint32_t rk[SM4_KEY_SCHEDULE];
+    u1 mac[SM4_BLOCK_SIZE];         /* CBC-MAC state xor the block being absorbed */
+    u1 counter[SM4_BLOCK_SIZE];
+    u1 s0[SM4_BLOCK_SIZE];          /* E(A0), masks the tag */
+    u1 buffer[SM4_BLOCK_SIZE];      /* keystream of the current partial block */
+    size_t buffer_used;
+    size_t mac_used;                /* bytes xored into mac since the last encryption */
+    size_t L;                       /* size of the length / counter field, 15 - nonce_len */
+    size_t tag_len;
+    u8 aad_len;
+    u8 aad_done;
+    u8 msg_len;
+    u8 msg_done;
+} SM4_CCM_CTX;
+
+/*
+ * SM4 CCM mode streaming API, functions return 1 on success and 0 on failure.
+ * AAD and payload lengths are declared at init, nonce is 7..13 bytes,
+ * tag_len is even and 4..16.
+ */
+int  sm4_ccm_init(SM4_CCM_CTX *ctx, const u1 key[SM4_KEY_SIZE],
+    const u1 *nonce, size_t nonce_len, u8 aad_len, u8 msg_len, size_t tag_len);
+int  sm4_ccm_update_aad(SM4_CCM_CTX *ctx, const u1 *aad, size_t len);
+int  sm4_ccm_encrypt_update(SM4_CCM_CTX *ctx, const u1 *in, u1 *out, size_t len);
+int  sm4_ccm_decrypt_update(SM4_CCM_CTX *ctx, const u1 *in, u1 *out, size_t len);
+int  sm4_ccm_encrypt_final(SM4_CCM_CTX *ctx, u1 *tag);
+int  sm4_ccm_decrypt_final(SM4_CCM_CTX *ctx, const u1 *tag);
+void sm4_ccm_clean(SM4_CCM_CTX *ctx);
+
+/* SM4 CCM mode one-shot API, decrypt returns 0 and wipes output on tag mismatch */
+int sm4_ccm_encrypt(const u1 key[SM4_KEY_SIZE], const u1 *nonce, size_t nonce_len,
+    const u1 *aad, size_t aad_len, const u1 *input, size_t len,
+    u1 *output, u1 *tag, size_t tag_len);
+int sm4_ccm_decrypt(const u1 key[SM4_KEY_SIZE], const u1 *nonce, size_t nonce_len,
+    const u1 *aad, size_t aad_len, const u1 *input, size_t len,
+    u1 *output, const u1 *tag, size_t tag_len);
+
+/* SM4 XTS mode context */
+typedef struct {
+    uint32_t rk1[SM4_KEY_SCHEDULE];     /* data key */
+    uint32_t rk1_dec[SM4_KEY_SCHEDULE]; /* data key, decryption order */
+    uint32_t rk2[SM4_KEY_SCHEDULE];     /* tweak key */
+} SM4_XTS_CTX;
+
+/*
+ * SM4 XTS mode (IEEE 1619 tweak), functions return 1 on success and 0 on
+ * failure. The key is data key || tweak key, data units are at least one
+ * block long and need not be block aligned. in and out may alias.
+ */
+int  sm4_xts_init(SM4_XTS_CTX *ctx, const u1 key[2 * SM4_KEY_SIZE]);
+int  sm4_xts_encrypt(const SM4_XTS_CTX *ctx, const u1 iv[SM4_BLOCK_SIZE],
+    const u1 *in, u1 *out, size_t len);
+int  sm4_xts_decrypt(const SM4_XTS_CTX *ctx, const u1 iv[SM4_BLOCK_SIZE],
+    const u1 *in, u1 *out, size_t len);
+void sm4_xts_clean(SM4_XTS_CTX *ctx);
+
+/* SM4 XTS batch API: nsectors data units, tweak values sector, sector + 1, ... */
+int  sm4_xts_encrypt_sectors(const SM4_XTS_CTX *ctx, u8 sector, size_t sector_size,
+    const u1 *in, u1 *out, size_t nsectors);
+int  sm4_xts_decrypt_sectors(const SM4_XTS_CTX *ctx, u8 sector, size_t sector_size,
+    const u1 *in, u1 *out, size_t nsectors);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,70 @@
+#ifndef YCRYPT_CPU_H
+#define YCRYPT_CPU_H
+
+/*
+ * Runtime CPU feature detection shared by the SIMD backends.
+ *
+ * SIMD kernels are compiled with per-function target attributes, so the
+ * library is built without any -m/-march flag and picks a kernel at run
+ * time. x86 features come from CPUID, AArch64 ones from the Linux hwcaps.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define YCRYPT_HAVE_X86_SIMD 1
+#endif
+
+/* SM3/SM4 instructions (ARMv8.2), intrinsics need GCC 8 or Clang 16 */
+#if defined(__aarch64__) && defined(__linux__) && \
+    ((defined(__clang__) && __clang_major__ >= 16) || \
+     (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8))
+#define YCRYPT_HAVE_ARM_CE 1
+#include <sys/auxv.h>
+#ifndef HWCAP_SM3
+#define HWCAP_SM3 (1UL << 18)
+#endif
+#ifndef HWCAP_SM4
+#define HWCAP_SM4 (1UL << 19)
+#endif
+#endif
+
+#define YCRYPT_CPU_AESNI      (1U << 0)
+#define YCRYPT_CPU_PCLMUL     (1U << 1)
+#define YCRYPT_CPU_SSSE3      (1U << 2)
+#define YCRYPT_CPU_AVX2       (1U << 3)
+#define YCRYPT_CPU_AVX512     (1U << 4)   /* AVX512F + AVX512BW + AVX512VL */
+#define YCRYPT_CPU_VAES       (1U << 5)
+#define YCRYPT_CPU_VPCLMUL    (1U << 6)
+#define YCRYPT_CPU_GFNI       (1U << 7)
+#define YCRYPT_CPU_ARM_SM3    (1U << 8)
+#define YCRYPT_CPU_ARM_SM4    (1U << 9)
+
+/* Bit mask of YCRYPT_CPU_* features usable on this CPU and OS */
+static inline unsigned int ycrypt_cpu_features(void)
+{
+  unsigned int f = 0;
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("aes"))        f |= YCRYPT_CPU_AESNI;
+  if (__builtin_cpu_supports("pclmul"))     f |= YCRYPT_CPU_PCLMUL;
+  if (__builtin_cpu_supports("ssse3"))      f |= YCRYPT_CPU_SSSE3;
+  if (__builtin_cpu_supports("avx2"))       f |= YCRYPT_CPU_AVX2;
+  if (__builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vl"))   f |= YCRYPT_CPU_AVX512;
+  if (__builtin_cpu_supports("vaes"))       f |= YCRYPT_CPU_VAES;
+  if (__builtin_cpu_supports("vpclmulqdq")) f |= YCRYPT_CPU_VPCLMUL;
+  if (__builtin_cpu_supports("gfni"))       f |= YCRYPT_CPU_GFNI;
+#endif
+
+#ifdef YCRYPT_HAVE_ARM_CE
+  unsigned long hwcap = getauxval(AT_HWCAP);
+
+  if (hwcap & HWCAP_SM3)                    f |= YCRYPT_CPU_ARM_SM3;
+  if (hwcap & HWCAP_SM4)                    f |= YCRYPT_CPU_ARM_SM4;
+#endif
+
+  return f;
+}
+
+#endif
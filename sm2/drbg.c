@@ -0,0 +1,130 @@
+/**
+ * Per-thread SM3 Hash_DRBG
+ *
+ * sm3_drbg_random keeps one SM3_DRBG (sm3/sm3_drbg.c) per thread. It is
+ * seeded from randombytes on first use, reseeded every
+ * SM3_DRBG_RESEED_INTERVAL requests, and reseeded in a child after fork()
+ * so that parent and child never return the same bytes. Small reads are
+ * served from a per-thread buffer filled one request at a time, so the
+ * state update and the multi-buffer pass are shared by many nonces and
+ * no read costs a system call.
+ */
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#define DRBG_PTHREAD 1
+#endif
+
+#include "include/drbg.h"
+#include "include/randombytes.h"
+
+#ifdef DRBG_PTHREAD
+#include <pthread.h>
+#endif
+
+#if defined(_MSC_VER)
+#define DRBG_THREAD_LOCAL __declspec(thread)
+#else
+#define DRBG_THREAD_LOCAL _Thread_local
+#endif
+
+// 16 SM3 blocks, one pass of the widest multi-buffer backend
+#define DRBG_BUFFER_SIZE 512
+
+typedef struct
+{
+	SM3_DRBG drbg;
+	u1 buf[DRBG_BUFFER_SIZE];
+	size_t avail;                   // unread bytes at the end of buf
+	unsigned int generation;        // fork generation the state was seeded in
+	int seeded;
+} DRBG_THREAD_STATE;
+
+static DRBG_THREAD_LOCAL DRBG_THREAD_STATE drbg_state;
+
+// Bumped in the child of every fork(), so inherited states look stale
+static volatile unsigned int drbg_generation;
+
+#ifdef DRBG_PTHREAD
+static pthread_once_t drbg_once = PTHREAD_ONCE_INIT;
+
+static void drbg_atfork_child(void)
+{
+	drbg_generation++;
+}
+
+static void drbg_register_atfork(void)
+{
+	pthread_atfork(NULL, NULL, drbg_atfork_child);
+}
+#endif
+
+static void drbg_seed_thread(DRBG_THREAD_STATE *st)
+{
+	u1 seed[SM3_DRBG_ENTROPY_LEN + SM3_DRBG_NONCE_LEN];
+
+#ifdef DRBG_PTHREAD
+	pthread_once(&drbg_once, drbg_register_atfork);
+#endif
+	randombytes(seed, sizeof(seed));
+	if (st->seeded)
+	{
+		sm3_drbg_reseed(&st->drbg, seed, SM3_DRBG_ENTROPY_LEN, NULL, 0);
+	}
+	else
+	{
+		sm3_drbg_instantiate(&st->drbg, seed, SM3_DRBG_ENTROPY_LEN,
+			seed + SM3_DRBG_ENTROPY_LEN, SM3_DRBG_NONCE_LEN, NULL, 0);
+		st->seeded = 1;
+	}
+	// Whatever was buffered before a fork is shared with the parent
+	memset(st->buf, 0, sizeof(st->buf));
+	st->avail = 0;
+	st->generation = drbg_generation;
+
+	memset(seed, 0, sizeof(seed));
+}
+
+static void drbg_generate(DRBG_THREAD_STATE *st, u1 *out, size_t len)
+{
+	while (!sm3_drbg_generate(&st->drbg, out, len, NULL, 0))
+	{
+		drbg_seed_thread(st);
+	}
+}
+
+void sm3_drbg_random(u1 *out, size_t len)
+{
+	DRBG_THREAD_STATE *st = &drbg_state;
+	size_t n;
+
+	if (!st->seeded || st->generation != drbg_generation)
+	{
+		drbg_seed_thread(st);
+	}
+
+	while (len)
+	{
+		if (st->avail == 0)
+		{
+			// Bulk reads skip the buffer
+			if (len >= DRBG_BUFFER_SIZE)
+			{
+				n = len < SM3_DRBG_MAX_REQUEST ? len : SM3_DRBG_MAX_REQUEST;
+				drbg_generate(st, out, n);
+				out += n;
+				len -= n;
+				continue;
+			}
+			drbg_generate(st, st->buf, DRBG_BUFFER_SIZE);
+			st->avail = DRBG_BUFFER_SIZE;
+		}
+
+		// Bytes handed out are wiped from the buffer
+		n = len < st->avail ? len : st->avail;
+		memcpy(out, st->buf + DRBG_BUFFER_SIZE - st->avail, n);
+		memset(st->buf + DRBG_BUFFER_SIZE - st->avail, 0, n);
+		st->avail -= n;
+		out += n;
+		len -= n;
+	}
+}
@@ -479,6 +479,46 @@ void get_naf_w5_2(const u32* pk, int8_t naf_w5[257])
 	}
 }
 
+// Computing the NAF of a positive integer k
+// 2 <= w <= 8, non-zero digits are odd with |ki| < 2^(w-1)
+void get_naf_w(const u32* pk, int w, int8_t naf[257])
+{
+	int i = 0;
+	int ki;
+	const int mask = (1 << w) - 1;
+	u32 x = { 0 }, k;
+
+	memcpy(&k, pk, sizeof(k));
+	for (i = 0; i < 257; i++)
+	{
+		ki = (int)(k.v[0] & mask);  // k mod (2^w)
+
+		if ((ki & 1) != 0)  // k is odd
+		{
+			if (ki >= (1 << (w - 1))) //  -2^(w-1) < ki < 2^(w-1)
+			{
+				ki -= 1 << w;
+			}
+			if (ki >= 0)
+			{
+				x.v[0] = ki;
+				u32_sub(&k, &x, &k);
+			}
+			else  // ki < 0
+			{
+				x.v[0] = -ki;
+				u32_add(&k, &x, &k);
+			}
+			naf[i] = (int8_t)ki;
+		}
+		else
+		{
+			naf[i] = 0;
+		}
+		u32_shr(&k);   // k = k / 2
+	}
+}
+
 // Computing the NAF of a positive integer k
 // w = 3
 void get_naf_w3(const u32* pk, int8_t naf_w3[257])
@@ -399,6 +399,7 @@ int montg_add_jpoint_and_apoint(const JPoint* a, const AFPoint* b, JPoint* r)
 	u32* ry = &(r->y);
 	u32* rz = &(r->z);
 	u32 A, B, C, D, E, Zsqr, Ccub, T;
+	JPoint T_b;
 
 
 	if (montg_is_jpoint_zero(a))
@@ -421,6 +422,21 @@ int montg_add_jpoint_and_apoint(const JPoint* a, const AFPoint* b, JPoint* r)
 	sub_mod_p(&A, ax, &C);               // C = A - x1
 	sub_mod_p(&B, ay, &D);               // D = B - y1
 
+	// a == b or a == -b, the formulas below would give zero for both
+	if (bignum_is_equal(C.v, BN_ZERO))
+	{
+		if (bignum_is_equal(D.v, BN_ZERO))
+		{
+			montg_apoint_to_jpoint2(b, &T_b);
+			montg_double_jpoint(&T_b, r);
+		}
+		else
+		{
+			montg_set_jpoint_to_zero(r);
+		}
+		return 1;
+	}
+
 	montg_sqr_mod_p(&C, &T);             // T = C^2
 	montg_mul_mod_p(&C, &T, &Ccub);       // Ccub = C^3
 	montg_mul_mod_p(ax, &T, &E);         // E = x1 * C^2
@@ -757,6 +773,215 @@ void montg_naive_times_point(const AFPoint* P, const u32* k, JPoint* result)
 	CopyJPoint(&T, result);
 }
 
+// Convert n jacobian points (montgomery domain) to affine points (montgomery domain)
+// with a single inversion (Montgomery's trick). Zero points become (0, 0).
+// Input: 
+//      a       -- in montgomery domain
+//      scratch -- n temporaries
+// Output: 
+//      r       -- in montgomery domain
+// Complexity:
+//      n(7M + 1S) + 1I instead of n(3M + 1S + 1I)
+void montg_batch_jpoint_to_apoint2(const JPoint* a, AFPoint* r, u32* scratch, size_t n)
+{
+	u32 acc, inv, Zinv, Zisqr, T;
+	size_t i;
+
+	// scratch[i] = product of the non-zero z before point i
+	copy_bignum(MONTG_ONE, acc.v);
+	for (i = 0; i < n; i++)
+	{
+		copy_bignum(acc.v, scratch[i].v);
+		if (!montg_is_jpoint_zero(a + i))
+		{
+			montg_mul_mod_p(&acc, &(a[i].z), &acc);
+		}
+	}
+
+	montg_back_mod_p(&acc, &T);
+	montg_inv_mod_p_ex(T.v, inv.v);       // inv = 1 / (z_0 * ... * z_n-1)
+
+	for (i = n; i-- > 0;)
+	{
+		if (montg_is_jpoint_zero(a + i))
+		{
+			bignum_set_to_zero(r[i].x.v);
+			bignum_set_to_zero(r[i].y.v);
+			continue;
+		}
+		montg_mul_mod_p(&inv, scratch + i, &Zinv);  // Zinv = 1 / z_i
+		montg_mul_mod_p(&inv, &(a[i].z), &inv);     // drop z_i from inv
+
+		montg_sqr_mod_p(&Zinv, &Zisqr);
+		montg_mul_mod_p(&(a[i].x), &Zisqr, &(r[i].x));
+		montg_mul_mod_p(&Zisqr, &Zinv, &T);
+		montg_mul_mod_p(&(a[i].y), &T, &(r[i].y));
+	}
+}
+
+// Odd multiples for a w = 5 NAF: T[i] = (2i + 1)P, i = 0..7, left in jacobian
+// coordinates so that many tables can share one montg_batch_jpoint_to_apoint2
+// Input: 
+//      apoint -- in residue domain
+// Output: 
+//      T      -- in montgomery domain
+// Complexity:
+//      1 JPOINT_DBL + 7 JPOINT_ADD = 88M + 32S
+void montg_pre_compute_naf_w5_odd(const AFPoint* apoint, JPoint T[8])
+{
+	JPoint dr;
+	int i;
+
+	montg_apoint_to_jpoint(apoint, T);     // 1 P
+	montg_double_jpoint_ex(T, &dr);        // 2 P
+	for (i = 1; i < 8; i++)
+	{
+		montg_add_jpoint_ex(T + i - 1, &dr, T + i);
+	}
+}
+
+// Joint scalar multiplication sG + tP in montgomery domain
+// Both scalars share one doubling chain: s is recoded as a w = 8 NAF and
+// served from the odd multiples of G in the fixed-base table, t as a w = 5
+// NAF served from T.
+// Input: 
+//      s, t         -- in residue domain
+//      T            -- T[i] = (2i + 1)P, affine, in montgomery domain
+// Output: 
+//      result       -- in montgomery domain
+// Complexity:
+//      ~256 JPOINT_DBL + ~(28 + 43) MPOINT_ADD = 256(4M + 4S) + 71(8M + 3S) = 1592M + 1237S
+//      instead of 1555M + 1228S + 1I for tP plus 260M + 96S for sG
+void montg_times_base_and_point_table(const u32* s, const AFPoint T[8], const u32* t, JPoint* result)
+{
+	int i = 0;
+	int8_t si = 0, ti = 0;
+	int8_t naf_s[257] = { 0 };
+	int8_t naf_t[257] = { 0 };
+	// g_montg_AFTable_for_base_point_mul[0][0][i] = iG, i < 256
+	const AFPoint* G = g_montg_AFTable_for_base_point_mul[0][0];
+	AFPoint N;
+	JPoint Q;
+
+	get_naf_w(s, 8, naf_s);
+	get_naf_w5_2(t, naf_t);
+	montg_set_jpoint_to_zero(&Q);
+
+	for (i = 256; i >= 0; i--)
+	{
+		montg_double_jpoint_ex(&Q, &Q);
+		ti = naf_t[i];
+		if (ti > 0)
+		{
+			montg_add_jpoint_and_apoint_ex(&Q, T + (ti >> 1), &Q);
+		}
+		else if (ti < 0)
+		{
+			AFPoint_neg(T + ((-ti) >> 1), &N);
+			montg_add_jpoint_and_apoint_ex(&Q, &N, &Q);
+		}
+		si = naf_s[i];
+		if (si > 0)
+		{
+			montg_add_jpoint_and_apoint_ex(&Q, G + si, &Q);
+		}
+		else if (si < 0)
+		{
+			AFPoint_neg(G - si, &N);
+			montg_add_jpoint_and_apoint_ex(&Q, &N, &Q);
+		}
+	}
+	CopyJPoint(&Q, result);
+}
+
+// Joint scalar multiplication sG + tP in montgomery domain
+// Input: 
+//      s, t         -- in residue domain
+//      P            -- in residue domain
+// Output: 
+//      result       -- in montgomery domain
+// Complexity:
+//      1592M + 1237S for the chain + 88M + 32S + 8(7M + 1S) + 1I for the table of P
+void montg_times_base_and_point(const u32* s, const AFPoint* P, const u32* t, JPoint* result)
+{
+	JPoint TJ[8];
+	AFPoint T[8];
+	u32 scratch[8];
+
+	montg_pre_compute_naf_w5_odd(P, TJ);
+	montg_batch_jpoint_to_apoint2(TJ, T, scratch, 8);
+	montg_times_base_and_point_table(s, T, t, result);
+}
+
+// Pre-compute the comb table of P, one window of 2^w - 1 points at a time
+// Input: 
+//      P      -- in residue domain
+//      w      -- window bits, 1 <= w <= 8
+// Output: 
+//      table  -- table[j * (2^w - 1) + b - 1] = b * 2^(w * j) * P, in montgomery domain
+// Complexity:
+//      MONTG_COMB_WINDOWS(w) * (2^w JPOINT_ADD + 2^w - 1 (7M + 1S) + 1I)
+void montg_pre_compute_comb(const AFPoint* P, int w, AFPoint* table)
+{
+	const int m = (1 << w) - 1;
+	JPoint B, TJ[255];
+	u32 scratch[255];
+	int i, j;
+
+	montg_apoint_to_jpoint(P, &B);               // B = 2^(w * j) * P
+	for (j = 0; j < MONTG_COMB_WINDOWS(w); j++)
+	{
+		CopyJPoint(&B, TJ);
+		for (i = 1; i < m; i++)
+		{
+			montg_add_jpoint_ex(TJ + i - 1, &B, TJ + i);
+		}
+		montg_add_jpoint_ex(TJ + m - 1, &B, &B);  // 2^w * B
+		montg_batch_jpoint_to_apoint2(TJ, table + (size_t)j * m, scratch, m);
+	}
+}
+
+// Bits [pos, pos + w) of k, w <= 8
+static inline unsigned int u32_get_bits(const u32* k, int pos, int w)
+{
+	int limb = pos >> 6, off = pos & 63;
+	UINT64 v = k->v[limb] >> off;
+
+	if (off + w > 64 && limb < 3)
+	{
+		v |= k->v[limb + 1] << (64 - off);
+	}
+	return (unsigned int)(v & ((1u << w) - 1));
+}
+
+// Scalar multiplication in montgomery domain with a comb table
+// Input: 
+//      table        -- from montg_pre_compute_comb
+//      w            -- window bits of table
+//      k            -- in residue domain
+// Output: 
+//      result = kP  -- in montgomery domain
+// Complexity:
+//      MONTG_COMB_WINDOWS(w) MPOINT_ADD, e.g. 43(8M + 3S) = 344M + 129S for w = 6
+void montg_times_point_comb(const AFPoint* table, int w, const u32* k, JPoint* result)
+{
+	const int m = (1 << w) - 1;
+	unsigned int b;
+	int j;
+	JPoint Q;
+
+	montg_set_jpoint_to_zero(&Q);
+	for (j = 0; j < MONTG_COMB_WINDOWS(w); j++)
+	{
+		b = u32_get_bits(k, w * j, w);
+		if (b)
+		{
+			montg_add_jpoint_and_apoint_ex(&Q, table + (size_t)j * m + b - 1, &Q);
+		}
+	}
+	CopyJPoint(&Q, result);
+}
+
 // ============================================================================
 // Portable C implementations of ECC assembly functions (originally in ecc_as.s)
 // These wrapper functions call the existing C implementations
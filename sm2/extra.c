@@ -109,26 +109,19 @@ void u4_to_u32(u4 input[8], u32* result)
 }
 
 
-//KDF Key-derived algorithm (for the convenience of processing length, dedicated to the sm2 encryption algorithm), using the sm3 hash algorithm (256-bit output)
+//KDF Key-derived algorithm using the sm3 hash algorithm (256-bit output), any klen up to (2^32 - 1) * 32 bytes
 int KDF(u1 Z[], u8 zlen, u8 klen, u1 K[])
 {
-	u4 ct = 0x1;	//32bits
-	size_t klenmod = klen % 32;
-	size_t loop = klenmod ? (klen / 32 + 1) : (klen / 32);
-	u1 ha[11][32] = { 0 }; //Restricted size
-	u1 msg_md[200] = { 0 };
-	if (loop > 10)
+	SM3_KDF_CTX ctx;
+	int ok;
+
+	if (klen > SIZE_MAX)
 	{
 		return -1;
 	}
-	for (size_t i = 0; i < loop; i++)
-	{
-		memcpy(msg_md, Z, zlen);
-		memcpy(msg_md + zlen, &ct, sizeof(ct));
-		str_reverse_in_place(msg_md + zlen, sizeof(ct));
-		sm3(msg_md, zlen + 4, ha[i]);
-		ct++;
-	}
-	memcpy(K, ha, klen);
-	return 0;
+	sm3_kdf_init(&ctx, Z, (size_t)zlen);
+	ok = sm3_kdf_squeeze(&ctx, K, (size_t)klen);
+	sm3_kdf_clean(&ctx);
+
+	return ok ? 0 : -1;
 }
\ No newline at end of file
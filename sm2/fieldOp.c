@@ -1,5 +1,6 @@
 #include "include/fieldOp.h"
 #include "include/utils.h"
+#include "include/drbg.h"
 // const static size_t BITS = 256;
 
 void get_random_u32_in_mod_n(u32* k)
@@ -7,6 +8,19 @@ void get_random_u32_in_mod_n(u32* k)
 	u32_rand(k);
 	mod_n(k, k);
 }
+// Uniform in [1, n-1] by rejection, from the per-thread SM3 DRBG (no system call per draw)
+void get_drbg_u32_in_mod_n(u32* k)
+{
+	u1 buf[32];
+
+	do
+	{
+		sm3_drbg_random(buf, sizeof(buf));
+		memcpy(k->v, buf, sizeof(buf));
+	} while (u32_eq_zero(k) || u32_ge(k, &SM2_N));
+
+	memset(buf, 0, sizeof(buf));
+}
 void get_random_u32_in_mod_p(u32* k)
 {
 	u32_rand(k);
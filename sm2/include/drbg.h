@@ -0,0 +1,10 @@
+#ifndef DRBG_H
+#define DRBG_H
+
+#include "dataType.h"
+#include "sm3.h"
+
+// Per-thread SM3 Hash_DRBG seeded from randombytes, also declared in include/sm_interface.h
+void sm3_drbg_random(u1 *out, size_t len);
+
+#endif
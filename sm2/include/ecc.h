@@ -41,6 +41,10 @@ void get_naf_w3(const u32* k, int8_t naf_w3[257]);
 // w = 5
 void get_naf_w5_2(const u32* pk, int8_t naf_w5[257]);
 
+// Computing the NAF of a positive integer k
+// 2 <= w <= 8
+void get_naf_w(const u32* pk, int w, int8_t naf[257]);
+
 
 // NAF method for w = 3
 void times_point_naf_w3(const AFPoint* point, const u32* times, JPoint* result);
@@ -129,6 +133,54 @@ void montg_times_point_naf_w3(const AFPoint* P, const u32* k, JPoint* result);
 //      result = kG  -- in montgomery domain
 void montg_times_base_point(const u32* k, JPoint* result);
 
+// Convert n jacobian points(montgomery domain) to affine points(montgomery domain)
+// with one inversion for all of them, scratch holds n temporaries
+void montg_batch_jpoint_to_apoint2(const JPoint* a, AFPoint* r, u32* scratch, size_t n);
+
+// Odd multiples T[i] = (2i + 1)P, i = 0..7, for montg_times_base_and_point_table
+// Input: 
+//      P            -- in residue domain
+// Output: 
+//      T            -- in montgomery domain, jacobian
+void montg_pre_compute_naf_w5_odd(const AFPoint* P, JPoint T[8]);
+
+// Joint scalar multiplication sG + tP in montgomery domain, one doubling chain
+// Input: 
+//      s, t         -- in residue domain
+//      T            -- T[i] = (2i + 1)P, in montgomery domain, affine
+// Output: 
+//      result       -- in montgomery domain
+void montg_times_base_and_point_table(const u32* s, const AFPoint T[8], const u32* t, JPoint* result);
+
+// Joint scalar multiplication sG + tP in montgomery domain, one doubling chain
+// Input: 
+//      s, t         -- in residue domain
+//      P            -- in residue domain
+// Output: 
+//      result       -- in montgomery domain
+void montg_times_base_and_point(const u32* s, const AFPoint* P, const u32* t, JPoint* result);
+
+// Comb table of a fixed point P with w-bit windows, 1 <= w <= 8:
+// table[j * (2^w - 1) + b - 1] = b * 2^(w * j) * P, b = 1 .. 2^w - 1
+#define MONTG_COMB_WINDOWS(w) ((256 + (w) - 1) / (w))
+#define MONTG_COMB_POINTS(w)  (MONTG_COMB_WINDOWS(w) * ((1 << (w)) - 1))
+
+// Pre-compute the comb table of P
+// Input: 
+//      P            -- in residue domain
+//      w            -- window bits
+// Output: 
+//      table        -- MONTG_COMB_POINTS(w) points, in montgomery domain, affine
+void montg_pre_compute_comb(const AFPoint* P, int w, AFPoint* table);
+
+// Scalar multiplication in montgomery domain with a comb table, no doublings
+// Input: 
+//      table        -- from montg_pre_compute_comb
+//      k            -- in residue domain
+// Output: 
+//      result = kP  -- in montgomery domain
+void montg_times_point_comb(const AFPoint* table, int w, const u32* k, JPoint* result);
+
 // Simplest scalar multiplication in montgomery domain for random point
 // Input: 
 //      P            -- in montgomery domain
@@ -5,6 +5,7 @@
 #include "extra.h"
 
 void get_random_u32_in_mod_n(u32* k);
+void get_drbg_u32_in_mod_n(u32* k);
 void get_random_u32_in_mod_p(u32* k);
 
 //void mod(u32* input, const u32* m);
@@ -24,6 +24,9 @@ int sm2_get_message_digest(
     const u1 *msg,
     size_t msg_len);
 
+/* Coordinates below p, on the curve and not the point at infinity */
+bool sm2_pubkey_is_valid(const PubKey* pubkey);
+
 /* Sign/verify on raw digest (internal use) */
 int sm2_sign_dgst(
     SM2SIG *sig,
@@ -35,6 +38,87 @@ int sm2_verify_dgst(
     const u1 dgst[32],
     const AFPoint * pubkey);
 
+/* Public API - also declared in include/sm_interface.h */
+int sm2_verify_dgst_batch(
+    const SM2SIG *sigs,
+    const u1 *dgsts,
+    const PubKey *pubkeys,
+    size_t n,
+    u1 *valid);
+
+/* Public API - also declared in include/sm_interface.h */
+typedef struct SM2_PUBKEY_TABLE
+{
+    PubKey pubkey;
+    int w;                      /* window bits, 1 .. 8 */
+    AFPoint *table;             /* MONTG_COMB_POINTS(w) points */
+} SM2_PUBKEY_TABLE;
+
+typedef struct SM2_PUBKEY_CACHE
+{
+    SM2_PUBKEY_TABLE *entries;  /* most recently used first */
+    size_t count;
+    size_t capacity;
+    int w;
+} SM2_PUBKEY_CACHE;
+
+int sm2_pubkey_table_init(SM2_PUBKEY_TABLE *tab, const PubKey *pubkey, int w);
+void sm2_pubkey_table_clean(SM2_PUBKEY_TABLE *tab);
+int sm2_verify_dgst_table(
+    const SM2SIG *signature,
+    const u1 dgst[32],
+    const SM2_PUBKEY_TABLE *tab);
+
+int sm2_pubkey_cache_init(SM2_PUBKEY_CACHE *cache, size_t capacity, int w);
+void sm2_pubkey_cache_clean(SM2_PUBKEY_CACHE *cache);
+const SM2_PUBKEY_TABLE *sm2_pubkey_cache_get(SM2_PUBKEY_CACHE *cache, const PubKey *pubkey);
+int sm2_verify_dgst_cached(
+    SM2_PUBKEY_CACHE *cache,
+    const SM2SIG *signature,
+    const u1 dgst[32],
+    const PubKey *pubkey);
+
+/* Public API - also declared in include/sm_interface.h */
+typedef struct SM2_ID_CTX
+{
+    PubKey pubkey;
+    u1 ZA[32];
+} SM2_ID_CTX;
+
+int sm2_id_ctx_init(SM2_ID_CTX *ctx, const u1 *id, size_t id_len, const PubKey *pubkey);
+void sm2_id_ctx_digest(const SM2_ID_CTX *ctx, const u1 *msg, size_t msg_len, u1 dgst[32]);
+int sm2_sign_id_ctx(
+    SM2SIG *sig,
+    const u1 *msg,
+    size_t msg_len,
+    const SM2_ID_CTX *ctx,
+    const PrivKey *privkey);
+int sm2_verify_id_ctx(
+    const SM2SIG *sig,
+    const u1 *msg,
+    size_t msg_len,
+    const SM2_ID_CTX *ctx);
+
+/* Public API - also declared in include/sm_interface.h */
+typedef struct SM2_SIGN_CTX
+{
+    SM2_ID_CTX id;
+    u32 inv;                    /* (1 + d)^-1 mod n, montgomery form */
+} SM2_SIGN_CTX;
+
+int sm2_sign_ctx_init(
+    SM2_SIGN_CTX *ctx,
+    const u1 *id,
+    size_t id_len,
+    const PubKey *pubkey,
+    const PrivKey *privkey);
+void sm2_sign_ctx_clean(SM2_SIGN_CTX *ctx);
+int sm2_sign_ctx(
+    SM2SIG *sig,
+    const u1 *msg,
+    size_t msg_len,
+    const SM2_SIGN_CTX *ctx);
+
 /* Public API - also declared in include/sm_interface.h */
 void sm2_keypair(PubKey* pubkey, PrivKey *privkey);
 void sm2_get_public_key(const PrivKey *privkey, PubKey* pubkey);
@@ -28,18 +28,76 @@ typedef struct _SM3_CTX
 void sm3_init(SM3_CTX *ctx);
 void sm3_update(SM3_CTX *ctx, const u1 *data, size_t data_len);
 void sm3_final(SM3_CTX *ctx, u1 digest[SM3_DIGEST_LENGTH]);
+/* Feed fd from its current offset to EOF, @return 1 on success, 0 on read error */
+int sm3_update_fd(SM3_CTX *ctx, int fd);
 void sm3_compress(u4 digest[8], const u1* block, size_t nblocks);
 size_t sm3(const u1 *data, size_t datalen, u1 dgst[SM3_DIGEST_LENGTH]);
+/*
+ * Portable snapshot of a running hash, to resume it in another process
+ * or on another host. SM3_STATE_SIZE bytes, big-endian:
+ *   "SM3S" | version 1 | num | 0 0 | digest[8] | nblocks (64 bit) | block,
+ * the block bytes past num are zero. Not authenticated: MAC it if it is
+ * stored where it could be tampered with.
+ * sm3_import @return 1 on success, 0 on a malformed state (ctx untouched)
+ */
+#define SM3_STATE_SIZE 112
+void sm3_export(const SM3_CTX *ctx, u1 state[SM3_STATE_SIZE]);
+int sm3_import(SM3_CTX *ctx, const u1 state[SM3_STATE_SIZE]);
 
 typedef struct _SM3_HMAC_CTX
 {
 	SM3_CTX sm3_ctx;
-	u1 key[SM3_BLOCK_SIZE];
+	uint32_t ipad_digest[8];           // State after the key ^ ipad block
+	uint32_t opad_digest[8];           // State after the key ^ opad block
 } SM3_HMAC_CTX;
 
 void sm3_hmac_init(SM3_HMAC_CTX *ctx, const u1 *key, size_t key_len);
 void sm3_hmac_update(SM3_HMAC_CTX *ctx, const u1 *data, size_t data_len);
 void sm3_hmac_final(SM3_HMAC_CTX *ctx, u1 mac[SM3_HMAC_SIZE]);
+/* Back to the state right after init, the key blocks are not compressed again */
+void sm3_hmac_reset(SM3_HMAC_CTX *ctx);
 size_t sm3_hmac(const u1 *data, size_t data_len, const u1 *key, size_t key_len, u1 mac[SM3_HMAC_SIZE]);
 
+/*
+ * Streaming SM3 KDF, see sm3/sm3_kdf.c. Z is hashed once by init, then
+ * any number of squeeze calls return consecutive bytes of the output.
+ * sm3_kdf_squeeze @return 1 on success, 0 past 2^32 - 1 blocks (nothing written)
+ */
+typedef struct _SM3_KDF_CTX
+{
+	SM3_CTX    z_ctx;                      // State after Z
+	uint64_t   blocks;                     // Counter of the last block produced
+	uint8_t    block[SM3_DIGEST_LENGTH];   // Last block, bytes from used on not returned yet
+	size_t     used;
+} SM3_KDF_CTX;
+
+void sm3_kdf_init(SM3_KDF_CTX *ctx, const u1 *z, size_t zlen);
+int sm3_kdf_squeeze(SM3_KDF_CTX *ctx, u1 *out, size_t len);
+void sm3_kdf_clean(SM3_KDF_CTX *ctx);
+
+/*
+ * SM3 Hash_DRBG (SP 800-90A 10.1.1, GM/T 0105), see sm3/sm3_drbg.c.
+ * Security strength 256 bits, seedlen 440 bits.
+ * sm3_drbg_generate @return 1 on success, 0 if a reseed is due or
+ * len > SM3_DRBG_MAX_REQUEST (nothing written)
+ */
+#define SM3_DRBG_SEED_LEN           55
+#define SM3_DRBG_ENTROPY_LEN        32
+#define SM3_DRBG_NONCE_LEN          16
+#define SM3_DRBG_MAX_REQUEST        ((size_t)1 << 16)   // 2^19 bits
+#define SM3_DRBG_RESEED_INTERVAL    ((uint64_t)1 << 10) // Requests between reseeds
+
+typedef struct _SM3_DRBG
+{
+	uint8_t    V[SM3_DRBG_SEED_LEN];
+	uint8_t    C[SM3_DRBG_SEED_LEN];
+	uint64_t   reseed_counter;
+} SM3_DRBG;
+
+void sm3_drbg_instantiate(SM3_DRBG *drbg, const u1 *entropy, size_t entropy_len,
+	const u1 *nonce, size_t nonce_len, const u1 *pers, size_t pers_len);
+void sm3_drbg_reseed(SM3_DRBG *drbg, const u1 *entropy, size_t entropy_len, const u1 *add, size_t add_len);
+int sm3_drbg_generate(SM3_DRBG *drbg, u1 *out, size_t len, const u1 *add, size_t add_len);
+void sm3_drbg_clean(SM3_DRBG *drbg);
+
 #endif // end of sm3.h
@@ -0,0 +1,133 @@
+/**
+ * Per public key comb tables and an LRU cache of them
+ *
+ * A table holds b * 2^(w * j) * P for every w-bit window j and digit b,
+ * so tP is one mixed addition per window and no doubling, the same way
+ * montg_times_base_point works for G. The cache keeps the tables of the
+ * most recently seen keys, most recent first, and rebuilds on a miss.
+ */
+
+#include <stdlib.h>
+
+#include "include/sm2.h"
+
+// Success: return 1.
+// Fail: return 0.
+int sm2_pubkey_table_init(SM2_PUBKEY_TABLE *tab, const PubKey *pubkey, int w)
+{
+	memset(tab, 0, sizeof(SM2_PUBKEY_TABLE));
+	if (w < 1 || w > 8 || !sm2_pubkey_is_valid(pubkey))
+	{
+		return 0;
+	}
+
+	tab->table = (AFPoint *)malloc(MONTG_COMB_POINTS(w) * sizeof(AFPoint));
+	if (!tab->table)
+	{
+		return 0;
+	}
+	montg_pre_compute_comb(pubkey, w, tab->table);
+	tab->pubkey = *pubkey;
+	tab->w = w;
+
+	return 1;
+}
+
+void sm2_pubkey_table_clean(SM2_PUBKEY_TABLE *tab)
+{
+	free(tab->table);
+	memset(tab, 0, sizeof(SM2_PUBKEY_TABLE));
+}
+
+// Success: return 1.
+// Fail: return 0.
+int sm2_pubkey_cache_init(SM2_PUBKEY_CACHE *cache, size_t capacity, int w)
+{
+	memset(cache, 0, sizeof(SM2_PUBKEY_CACHE));
+	if (capacity == 0 || w < 1 || w > 8)
+	{
+		return 0;
+	}
+
+	cache->entries = (SM2_PUBKEY_TABLE *)calloc(capacity, sizeof(SM2_PUBKEY_TABLE));
+	if (!cache->entries)
+	{
+		return 0;
+	}
+	cache->capacity = capacity;
+	cache->w = w;
+
+	return 1;
+}
+
+void sm2_pubkey_cache_clean(SM2_PUBKEY_CACHE *cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->count; i++)
+	{
+		sm2_pubkey_table_clean(cache->entries + i);
+	}
+	free(cache->entries);
+	memset(cache, 0, sizeof(SM2_PUBKEY_CACHE));
+}
+
+const SM2_PUBKEY_TABLE *sm2_pubkey_cache_get(SM2_PUBKEY_CACHE *cache, const PubKey *pubkey)
+{
+	SM2_PUBKEY_TABLE tab;
+	size_t i;
+
+	for (i = 0; i < cache->count; i++)
+	{
+		if (memcmp(&(cache->entries[i].pubkey), pubkey, sizeof(PubKey)) == 0)
+		{
+			break;
+		}
+	}
+
+	if (i < cache->count)
+	{
+		tab = cache->entries[i];
+	}
+	else
+	{
+		if (!sm2_pubkey_table_init(&tab, pubkey, cache->w))
+		{
+			return NULL;
+		}
+		if (cache->count == cache->capacity)
+		{
+			// Evict the least recently used table
+			i = --cache->count;
+			sm2_pubkey_table_clean(cache->entries + i);
+		}
+		else
+		{
+			i = cache->count;
+		}
+		cache->count++;
+	}
+
+	// Move to the front
+	memmove(cache->entries + 1, cache->entries, i * sizeof(SM2_PUBKEY_TABLE));
+	cache->entries[0] = tab;
+
+	return cache->entries;
+}
+
+// Success: return 1.
+// Fail: return 0.
+int sm2_verify_dgst_cached(
+	SM2_PUBKEY_CACHE *cache,
+	const SM2SIG *signature,
+	const u1 dgst[32],
+	const PubKey *pubkey)
+{
+	const SM2_PUBKEY_TABLE *tab = sm2_pubkey_cache_get(cache, pubkey);
+
+	if (!tab)
+	{
+		return 0;
+	}
+	return sm2_verify_dgst_table(signature, dgst, tab);
+}
@@ -21,6 +21,14 @@ void sm2_get_public_key(const PrivKey *privkey, PubKey* pubkey)
 	jacobian_to_affine(&rst_jacobian, pubkey);
 }
 
+// Coordinates below p, on the curve and not the point at infinity,
+// which is encoded as (0, 0) and passes is_on_curve
+bool sm2_pubkey_is_valid(const PubKey* pubkey)
+{
+	return !u32_ge(&(pubkey->x), &SM2_P) && !u32_ge(&(pubkey->y), &SM2_P) &&
+		!equ_to_AFPoint_one(pubkey) && is_on_curve(pubkey);
+}
+
 // Get ZA=Hash256(ENTLA || id || a || b || xG || yG || xA || yA)
 // result contains ZA.
 int sm2_get_id_digest(
@@ -80,18 +88,33 @@ int sm2_get_message_digest(
 	return 0;
 }
 
+// inv = (1 + d)^-1 * R mod n, the montgomery form taken by sm2_sign_dgst_inv
 // Success: return 1.
-// Fail: return 0.
-int sm2_sign_dgst(
-	SM2SIG *sig, 
-	u1 dgst[32], 
-	const PrivKey* privkey)
+// Fail: return 0 (1 + d = 0 mod n).
+static int sm2_get_sign_inverse(const u32* d, u32* inv)
+{
+	u32 t = { 1,0,0,0 };
+
+	add_mod_n(d, &t, &t);
+	if (u32_eq_zero(&t))
+		return 0;
+	montg_inv_mod_n_ex(t.v, inv->v);
+
+	return 1;
+}
+
+// s = (1 + d)^-1 * (k - r * d) = (1 + d)^-1 * (k + r) - r,
+// so d only enters through inv = (1 + d)^-1 * R mod n
+static int sm2_sign_dgst_inv(
+	SM2SIG *sig,
+	const u1 dgst[32],
+	const u32* inv)
 {
 	u32 r = { 0,0,0,0 };
 	u32 s = { 0,0,0,0 };
 	u32 k;
 
-	u32 e, tmp, inversion_da_and_1, k_subtract_rda;
+	u32 e, tmp;
 	JPoint rand_JPoint;
 	AFPoint rand_AFPoint;
 
@@ -100,7 +123,7 @@ int sm2_sign_dgst(
 
 	while (u32_eq_zero(&s))
 	{
-		get_random_u32_in_mod_n(&k);
+		get_drbg_u32_in_mod_n(&k);
 
 		montg_times_base_point(&k, &rand_JPoint);
 		montg_jpoint_to_apoint(&rand_JPoint, rand_AFPoint.x.v, NULL);
@@ -113,24 +136,35 @@ int sm2_sign_dgst(
 			continue;
 		}
 
-		// Calculate s = (1+da)^-1 * (k-r*da);
-		inversion_da_and_1.v[0] = 1;
-		inversion_da_and_1.v[1] = 0;
-		inversion_da_and_1.v[2] = 0;
-		inversion_da_and_1.v[3] = 0;
-		add_mod_n(&(privkey->da), &(inversion_da_and_1), &(inversion_da_and_1));
-		inv_for_mul_mod_n(&inversion_da_and_1, &inversion_da_and_1);
-		
-		mul_mod_n(&r, &(privkey->da), &k_subtract_rda);
-		sub_mod_n(&k, &k_subtract_rda, &k_subtract_rda);
-		mul_mod_n(&inversion_da_and_1, &k_subtract_rda, &s);
+		// Calculate s = (1+da)^-1 * (k+r) - r;
+		sm2n_mong_mul(inv, &tmp, &s);
+		sub_mod_n(&s, &r, &s);
 	}
 	sig->r = r;
 	sig->s = s;
 
+	memset(&k, 0, sizeof(k));
 	return 1;
 }
 
+// Success: return 1.
+// Fail: return 0.
+int sm2_sign_dgst(
+	SM2SIG *sig, 
+	u1 dgst[32], 
+	const PrivKey* privkey)
+{
+	u32 inv;
+	int ok;
+
+	if (!sm2_get_sign_inverse(&(privkey->da), &inv))
+		return 0;
+	ok = sm2_sign_dgst_inv(sig, dgst, &inv);
+
+	memset(&inv, 0, sizeof(inv));
+	return ok;
+}
+
 // Success: return 1.
 // Fail: return 0.
 int sm2_sign(
@@ -155,6 +189,96 @@ int sm2_sign(
 	return sm2_sign_dgst(sig, dgst, privkey);
 }
 
+// Success: return 1.
+// Fail: return 0 (id longer than 50 bytes or invalid public key).
+int sm2_id_ctx_init(
+	SM2_ID_CTX *ctx,
+	const u1 *id,
+	size_t id_len,
+	const PubKey* pubkey)
+{
+	memset(ctx, 0, sizeof(SM2_ID_CTX));
+	if (id_len > 50 || !sm2_pubkey_is_valid(pubkey))
+	{
+		return 0;
+	}
+	sm2_get_id_digest(ctx->ZA, id, id_len, pubkey);
+	ctx->pubkey = *pubkey;
+
+	return 1;
+}
+
+// dgst = Hash256(ZA || msg)
+void sm2_id_ctx_digest(
+	const SM2_ID_CTX *ctx,
+	const u1 *msg,
+	size_t msg_len,
+	u1 dgst[32])
+{
+	sm2_get_message_digest(dgst, ctx->ZA, msg, msg_len);
+}
+
+// Success: return 1.
+// Fail: return 0.
+int sm2_sign_id_ctx(
+	SM2SIG *sig,
+	const u1 *msg,
+	size_t msg_len,
+	const SM2_ID_CTX *ctx,
+	const PrivKey* privkey)
+{
+	u1 dgst[32];
+
+	sm2_id_ctx_digest(ctx, msg, msg_len, dgst);
+	return sm2_sign_dgst(sig, dgst, privkey);
+}
+
+// Success: return 1.
+// Fail: return 0 (invalid id or public key, d not in [1, n - 2]
+// or pubkey is not d * G).
+int sm2_sign_ctx_init(
+	SM2_SIGN_CTX *ctx,
+	const u1 *id,
+	size_t id_len,
+	const PubKey* pubkey,
+	const PrivKey* privkey)
+{
+	PubKey dG;
+
+	memset(ctx, 0, sizeof(SM2_SIGN_CTX));
+	if (u32_eq_zero(&(privkey->da)) || u32_ge(&(privkey->da), &SM2_N))
+		return 0;
+	sm2_get_public_key(privkey, &dG);
+	if (!equ_to_AFPoint(&dG, pubkey) ||
+		!sm2_id_ctx_init(&(ctx->id), id, id_len, pubkey) ||
+		!sm2_get_sign_inverse(&(privkey->da), &(ctx->inv)))
+	{
+		memset(ctx, 0, sizeof(SM2_SIGN_CTX));
+		return 0;
+	}
+
+	return 1;
+}
+
+void sm2_sign_ctx_clean(SM2_SIGN_CTX *ctx)
+{
+	memset(ctx, 0, sizeof(SM2_SIGN_CTX));
+}
+
+// Success: return 1.
+// Fail: return 0.
+int sm2_sign_ctx(
+	SM2SIG *sig,
+	const u1 *msg,
+	size_t msg_len,
+	const SM2_SIGN_CTX *ctx)
+{
+	u1 dgst[32];
+
+	sm2_id_ctx_digest(&(ctx->id), msg, msg_len, dgst);
+	return sm2_sign_dgst_inv(sig, dgst, &(ctx->inv));
+}
+
 // Success: return 1.
 // Fail: return 0.
 int sm2_verify_dgst(
@@ -165,13 +289,10 @@ int sm2_verify_dgst(
 	// verify that Q is indeed on the curve
 	// to prevent false curve attack
 	u32 e, t, R;
-	JPoint tmp1 = JPoint_ZERO, point1_jacobian = JPoint_ZERO;
+	JPoint point1_jacobian = JPoint_ZERO;
 
-	if (!is_on_curve(pubkey))
-	{
-		printf("Public key not on curve!\n");
+	if (!sm2_pubkey_is_valid(pubkey))
 		return 0;
-	}
 
 	const u32* r = &(signature->r);
 	const u32* s = &(signature->s);
@@ -185,10 +306,10 @@ int sm2_verify_dgst(
 
 	u1_to_u32(dgst, &e);
 
-	montg_times_base_point(s, &tmp1);
-	montg_times_point_naf_w3(pubkey, &t, &point1_jacobian);
-
-	montg_add_jpoint(&tmp1, &point1_jacobian, &point1_jacobian);
+	// (x, y) = sG + tP, over one doubling chain
+	montg_times_base_and_point(s, pubkey, &t, &point1_jacobian);
+	if (u32_eq_zero(&(point1_jacobian.z)))
+		return 0;
 	montg_jpoint_to_apoint(&point1_jacobian, t.v, NULL); // Get x coordinate;
 
 	mod_n(&e, &e);
@@ -198,6 +319,135 @@ int sm2_verify_dgst(
 	return u32_eq(&R, r);
 }
 
+// Same as sm2_verify_dgst, tP from the comb table of the key.
+// Success: return 1.
+// Fail: return 0.
+int sm2_verify_dgst_table(
+	const SM2SIG *signature,
+	const u1 dgst[32],
+	const SM2_PUBKEY_TABLE *tab)
+{
+	u32 e, t, R;
+	JPoint sG, tP;
+
+	const u32* r = &(signature->r);
+	const u32* s = &(signature->s);
+
+	if (u32_ge(r, &SM2_N) || u32_eq_zero(r) || u32_ge(s, &SM2_N) || u32_eq_zero(s))
+		return 0;
+
+	add_mod_n(r, s, &t);
+	if (u32_eq_zero(&t))
+		return 0;
+
+	u1_to_u32(dgst, &e);
+
+	montg_times_base_point(s, &sG);
+	montg_times_point_comb(tab->table, tab->w, &t, &tP);
+	montg_add_jpoint_ex(&sG, &tP, &tP);
+	if (u32_eq_zero(&(tP.z)))
+		return 0;
+	montg_jpoint_to_apoint(&tP, t.v, NULL); // Get x coordinate;
+
+	mod_n(&e, &e);
+	mod_n(&t, &t);
+	add_mod_n(&e, &t, &R);
+
+	return u32_eq(&R, r);
+}
+
+// Signatures per group of sm2_verify_dgst_batch, bounds the stack use (~30 KB)
+#define SM2_VERIFY_BATCH 16
+
+// Verify n <= SM2_VERIFY_BATCH signatures, ok[i] = 1 when signature i is valid
+static void sm2_verify_dgst_group(const SM2SIG *sigs, const u1 *dgsts, const PubKey *pubkeys, size_t n, int ok[])
+{
+	JPoint tabJ[SM2_VERIFY_BATCH * 8], Q[SM2_VERIFY_BATCH];
+	AFPoint tab[SM2_VERIFY_BATCH * 8], X[SM2_VERIFY_BATCH];
+	u32 scratch[SM2_VERIFY_BATCH * 8], t[SM2_VERIFY_BATCH], e, R;
+	size_t idx[SM2_VERIFY_BATCH];
+	size_t i, j, m = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		const u32 *r = &(sigs[i].r);
+		const u32 *s = &(sigs[i].s);
+		const AFPoint *P = pubkeys + i;
+
+		ok[i] = sm2_pubkey_is_valid(P) &&
+			!u32_ge(r, &SM2_N) && !u32_eq_zero(r) && !u32_ge(s, &SM2_N) && !u32_eq_zero(s);
+		if (!ok[i])
+		{
+			continue;
+		}
+		add_mod_n(r, s, t + m);
+		if (u32_eq_zero(t + m))
+		{
+			ok[i] = 0;
+			continue;
+		}
+		idx[m++] = i;
+	}
+
+	// Window tables of all keys normalized with one inversion
+	for (j = 0; j < m; j++)
+	{
+		montg_pre_compute_naf_w5_odd(pubkeys + idx[j], tabJ + 8 * j);
+	}
+	montg_batch_jpoint_to_apoint2(tabJ, tab, scratch, 8 * m);
+
+	// R = s * G + t * P, then the x coordinates with one more inversion
+	for (j = 0; j < m; j++)
+	{
+		montg_times_base_and_point_table(&(sigs[idx[j]].s), tab + 8 * j, t + j, Q + j);
+	}
+	montg_batch_jpoint_to_apoint2(Q, X, scratch, m);
+
+	for (j = 0; j < m; j++)
+	{
+		i = idx[j];
+		if (u32_eq_zero(&(Q[j].z)))
+		{
+			ok[i] = 0;
+			continue;
+		}
+		montg_back_mod_p(&(X[j].x), &R);
+		u1_to_u32(dgsts + 32 * i, &e);
+		mod_n(&e, &e);
+		mod_n(&R, &R);
+		add_mod_n(&e, &R, &R);
+		ok[i] = u32_eq(&R, &(sigs[i].r));
+	}
+}
+
+// Success (every signature valid): return 1.
+// Fail: return 0, valid tells which ones.
+int sm2_verify_dgst_batch(
+	const SM2SIG *sigs,
+	const u1 *dgsts,
+	const PubKey *pubkeys,
+	size_t n,
+	u1 *valid)
+{
+	int ok[SM2_VERIFY_BATCH];
+	int all = 1;
+	size_t i, j, k;
+
+	memset(valid, 0, (n + 7) / 8);
+	for (i = 0; i < n; i += k)
+	{
+		k = n - i < SM2_VERIFY_BATCH ? n - i : SM2_VERIFY_BATCH;
+		sm2_verify_dgst_group(sigs + i, dgsts + 32 * i, pubkeys + i, k, ok);
+		for (j = 0; j < k; j++)
+		{
+			valid[(i + j) / 8] |= (u1)(ok[j] << ((i + j) % 8));
+			all &= ok[j];
+		}
+	}
+
+	return all;
+}
+
 // Success: return 1.
 // Fail: return 0.
 int sm2_verify(
@@ -216,3 +466,17 @@ int sm2_verify(
 
 	return sm2_verify_dgst(sig, dgst, pubkey);
 }
+
+// Success: return 1.
+// Fail: return 0.
+int sm2_verify_id_ctx(
+	const SM2SIG *sig,
+	const u1 *msg,
+	size_t msg_len,
+	const SM2_ID_CTX *ctx)
+{
+	u1 dgst[32];
+
+	sm2_id_ctx_digest(ctx, msg, msg_len, dgst);
+	return sm2_verify_dgst(sig, dgst, &(ctx->pubkey));
+}
@@ -25,6 +25,13 @@
 
 #include "../include/sm2.h"
 #include "../include/utils.h"
+#include "../include/drbg.h"
+#include "../include/fieldOp.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 #ifdef TEST_WITH_OPENSSL
 #include <openssl/evp.h>
@@ -156,6 +163,415 @@ int sm2_self_check()
 	return 0;
 }
 
+void sm2_id_ctx_self_check()
+{
+	unsigned char IDA[17] = "1234567812345678";
+	unsigned char message[MSG_LEN];
+	u1 ZA[32], dgst[32], dgst_ctx[32], long_id[51] = { 0 };
+	SM2_ID_CTX ctx;
+	PubKey pubkey, bad;
+	PrivKey privkey;
+	SM2SIG sig;
+	int ok = 1;
+
+	puts("======== SM2 id context test =======");
+
+	sm2_keypair(&pubkey, &privkey);
+	random_fill(message, MSG_LEN);
+	ok &= sm2_id_ctx_init(&ctx, IDA, strlen((char*)IDA), &pubkey);
+
+	sm2_get_id_digest(ZA, IDA, strlen((char*)IDA), &pubkey);
+	sm2_get_message_digest(dgst, ZA, message, MSG_LEN);
+	sm2_id_ctx_digest(&ctx, message, MSG_LEN, dgst_ctx);
+	ok &= memcmp(dgst, dgst_ctx, 32) == 0;
+
+	/* Each side against the plain API */
+	ok &= sm2_sign_id_ctx(&sig, message, MSG_LEN, &ctx, &privkey);
+	ok &= sm2_verify(&sig, message, MSG_LEN, IDA, strlen((char*)IDA), &pubkey);
+	ok &= sm2_sign(&sig, message, MSG_LEN, IDA, strlen((char*)IDA), &pubkey, &privkey);
+	ok &= sm2_verify_id_ctx(&sig, message, MSG_LEN, &ctx);
+	message[0] ^= 1;
+	ok &= !sm2_verify_id_ctx(&sig, message, MSG_LEN, &ctx);
+
+	/* Empty message, empty id */
+	ok &= sm2_id_ctx_init(&ctx, IDA, 0, &pubkey);
+	ok &= sm2_sign_id_ctx(&sig, message, 0, &ctx, &privkey);
+	ok &= sm2_verify(&sig, message, 0, IDA, 0, &pubkey);
+
+	ok &= !sm2_id_ctx_init(&ctx, long_id, sizeof(long_id), &pubkey);
+	bad = pubkey;
+	bad.x.v[1] ^= 1;
+	ok &= !sm2_id_ctx_init(&ctx, IDA, strlen((char*)IDA), &bad);
+	memset(&bad, 0, sizeof(bad));
+	ok &= !sm2_id_ctx_init(&ctx, IDA, strlen((char*)IDA), &bad);
+
+	if (ok)
+	{
+		printf("[SUCCESS] SM2 id context test correct.\n");
+	}
+	else
+	{
+		printf("[ERROR] SM2 id context test failed.\n");
+	}
+}
+
+void sm2_sign_ctx_self_check()
+{
+	unsigned char IDA[17] = "1234567812345678";
+	unsigned char message[MSG_LEN];
+	u1 long_id[51] = { 0 };
+	SM2_SIGN_CTX ctx, zero;
+	PubKey pubkey, other;
+	PrivKey privkey, bad;
+	SM2SIG sig;
+	int i, ok = 1;
+
+	puts("======== SM2 sign context test =======");
+
+	sm2_keypair(&pubkey, &privkey);
+	ok &= sm2_sign_ctx_init(&ctx, IDA, strlen((char*)IDA), &pubkey, &privkey);
+	for (i = 0; i < 32; i++)
+	{
+		random_fill(message, MSG_LEN);
+		ok &= sm2_sign_ctx(&sig, message, MSG_LEN, &ctx);
+		ok &= sm2_verify(&sig, message, MSG_LEN, IDA, strlen((char*)IDA), &pubkey);
+	}
+	sm2_sign_ctx_clean(&ctx);
+	memset(&zero, 0, sizeof(zero));
+	ok &= memcmp(&ctx, &zero, sizeof(ctx)) == 0;
+
+	/* d = 1 and d = n - 2, the ends of the valid range */
+	memset(&privkey, 0, sizeof(privkey));
+	privkey.da.v[0] = 1;
+	sm2_get_public_key(&privkey, &pubkey);
+	ok &= sm2_sign_ctx_init(&ctx, IDA, strlen((char*)IDA), &pubkey, &privkey);
+	ok &= sm2_sign_ctx(&sig, message, MSG_LEN, &ctx);
+	ok &= sm2_verify(&sig, message, MSG_LEN, IDA, strlen((char*)IDA), &pubkey);
+	privkey.da.v[0] = 2;
+	sub_mod_n(&SM2_N, &(privkey.da), &(privkey.da));
+	sm2_get_public_key(&privkey, &pubkey);
+	ok &= sm2_sign_ctx_init(&ctx, IDA, strlen((char*)IDA), &pubkey, &privkey);
+	ok &= sm2_sign_ctx(&sig, message, MSG_LEN, &ctx);
+	ok &= sm2_verify(&sig, message, MSG_LEN, IDA, strlen((char*)IDA), &pubkey);
+
+	/* d = 0, d = n - 1, a key pair that does not match, a long id */
+	memset(&bad, 0, sizeof(bad));
+	ok &= !sm2_sign_ctx_init(&ctx, IDA, strlen((char*)IDA), &pubkey, &bad);
+	bad.da.v[0] = 1;
+	sub_mod_n(&SM2_N, &(bad.da), &(bad.da));
+	sm2_get_public_key(&bad, &other);
+	ok &= !sm2_sign_ctx_init(&ctx, IDA, strlen((char*)IDA), &other, &bad);
+	ok &= !sm2_sign_dgst(&sig, message, &bad);
+	sm2_keypair(&other, &bad);
+	ok &= !sm2_sign_ctx_init(&ctx, IDA, strlen((char*)IDA), &pubkey, &bad);
+	ok &= !sm2_sign_ctx_init(&ctx, long_id, sizeof(long_id), &other, &bad);
+	ok &= memcmp(&ctx, &zero, sizeof(ctx)) == 0;
+
+	if (ok)
+	{
+		printf("[SUCCESS] SM2 sign context test correct.\n");
+	}
+	else
+	{
+		printf("[ERROR] SM2 sign context test failed.\n");
+	}
+}
+
+/* sG + tP against two separate scalar multiplications */
+static int sm2_joint_mul_matches(const u32 *s, const AFPoint *P, const u32 *t)
+{
+	JPoint sG, tP, R;
+	u32 x0, y0, x1, y1;
+
+	montg_times_base_point(s, &sG);
+	montg_times_point_naf_w3(P, t, &tP);
+	montg_add_jpoint_ex(&sG, &tP, &sG);
+	montg_times_base_and_point(s, P, t, &R);
+
+	if (u32_eq_zero(&(sG.z)) || u32_eq_zero(&(R.z)))
+	{
+		return u32_eq_zero(&(sG.z)) && u32_eq_zero(&(R.z));
+	}
+	montg_jpoint_to_apoint(&sG, x0.v, y0.v);
+	montg_jpoint_to_apoint(&R, x1.v, y1.v);
+	return u32_eq(&x0, &x1) && u32_eq(&y0, &y1);
+}
+
+void sm2_joint_mul_self_check()
+{
+	PubKey P;
+	PrivKey d;
+	u32 s, t;
+	int i, ok = 1;
+
+	puts("======== SM2 joint sG + tP test =======");
+
+	for (i = 0; i < 32; i++)
+	{
+		sm2_keypair(&P, &d);
+		get_random_u32_in_mod_n(&s);
+		get_random_u32_in_mod_n(&t);
+		ok &= sm2_joint_mul_matches(&s, &P, &t);
+	}
+
+	/* P = G runs the additions into equal and opposite points */
+	memset(&s, 0, sizeof(s));
+	memset(&t, 0, sizeof(t));
+	s.v[0] = 1;
+	t.v[0] = 1;
+	ok &= sm2_joint_mul_matches(&s, &SM2_G, &t);      /* G + G */
+	sub_mod_n(&SM2_N, &s, &t);
+	ok &= sm2_joint_mul_matches(&s, &SM2_G, &t);      /* G - G */
+	for (i = 0; i < 8; i++)
+	{
+		get_random_u32_in_mod_n(&s);
+		t = s;
+		ok &= sm2_joint_mul_matches(&s, &SM2_G, &t);
+		sub_mod_n(&SM2_N, &s, &t);
+		ok &= sm2_joint_mul_matches(&s, &SM2_G, &t);
+	}
+
+	if (ok)
+	{
+		printf("[SUCCESS] SM2 joint sG + tP test correct.\n");
+	}
+	else
+	{
+		printf("[ERROR] SM2 joint sG + tP test failed.\n");
+	}
+}
+
+/* kP from a comb table against the w = 3 NAF ladder */
+static int sm2_comb_mul_matches(const SM2_PUBKEY_TABLE *tab, const u32 *k)
+{
+	JPoint A, B;
+	u32 x0, y0, x1, y1;
+
+	montg_times_point_naf_w3(&(tab->pubkey), k, &A);
+	montg_times_point_comb(tab->table, tab->w, k, &B);
+
+	if (u32_eq_zero(&(A.z)) || u32_eq_zero(&(B.z)))
+	{
+		return u32_eq_zero(&(A.z)) && u32_eq_zero(&(B.z));
+	}
+	montg_jpoint_to_apoint(&A, x0.v, y0.v);
+	montg_jpoint_to_apoint(&B, x1.v, y1.v);
+	return u32_eq(&x0, &x1) && u32_eq(&y0, &y1);
+}
+
+void sm2_pubkey_table_self_check()
+{
+	static const int ws[] = { 1, 3, 4, 6, 7, 8 };
+	SM2_PUBKEY_TABLE tab;
+	SM2_PUBKEY_CACHE cache;
+	PubKey P[3], bad;
+	PrivKey d[3];
+	SM2SIG sig[3];
+	u1 dgst[3][32];
+	u32 k;
+	size_t j;
+	int i, ok = 1;
+
+	puts("======== SM2 public key table test =======");
+
+	for (i = 0; i < 3; i++)
+	{
+		sm2_keypair(P + i, d + i);
+		random_fill(dgst[i], 32);
+		sm2_sign_dgst(sig + i, dgst[i], d + i);
+	}
+
+	for (j = 0; j < sizeof(ws) / sizeof(ws[0]); j++)
+	{
+		ok &= sm2_pubkey_table_init(&tab, P, ws[j]);
+		for (i = 0; i < 8; i++)
+		{
+			get_random_u32_in_mod_n(&k);
+			ok &= sm2_comb_mul_matches(&tab, &k);
+		}
+		memset(&k, 0, sizeof(k));
+		ok &= sm2_comb_mul_matches(&tab, &k);
+		k.v[0] = 1;
+		sub_mod_n(&SM2_N, &k, &k);                     /* n - 1 */
+		ok &= sm2_comb_mul_matches(&tab, &k);
+
+		ok &= sm2_verify_dgst_table(sig, dgst[0], &tab) == 1;
+		ok &= sm2_verify_dgst_table(sig + 1, dgst[1], &tab) == 0;
+		sm2_pubkey_table_clean(&tab);
+	}
+
+	/* Invalid keys and window sizes */
+	bad = P[0];
+	bad.y.v[0] ^= 1;
+	ok &= sm2_pubkey_table_init(&tab, &bad, 4) == 0;
+	memset(&bad, 0, sizeof(bad));
+	ok &= sm2_pubkey_table_init(&tab, &bad, 4) == 0;
+	ok &= sm2_pubkey_table_init(&tab, P, 0) == 0;
+	ok &= sm2_pubkey_table_init(&tab, P, 9) == 0;
+	ok &= sm2_pubkey_cache_init(&cache, 0, 4) == 0;
+
+	/* Two entries, three keys */
+	ok &= sm2_pubkey_cache_init(&cache, 2, 4);
+	ok &= sm2_verify_dgst_cached(&cache, sig, dgst[0], P) == 1;
+	ok &= sm2_verify_dgst_cached(&cache, sig + 1, dgst[1], P + 1) == 1;
+	ok &= sm2_verify_dgst_cached(&cache, sig, dgst[0], P) == 1;         /* hit, P[0] first */
+	ok &= cache.count == 2 && equ_to_AFPoint(&(cache.entries[0].pubkey), P) &&
+		equ_to_AFPoint(&(cache.entries[1].pubkey), P + 1);
+	ok &= sm2_verify_dgst_cached(&cache, sig + 2, dgst[2], P + 2) == 1; /* evicts P[1] */
+	ok &= cache.count == 2 && equ_to_AFPoint(&(cache.entries[0].pubkey), P + 2) &&
+		equ_to_AFPoint(&(cache.entries[1].pubkey), P);
+	ok &= sm2_verify_dgst_cached(&cache, sig + 1, dgst[1], P) == 0;
+	ok &= sm2_verify_dgst_cached(&cache, sig, dgst[0], &bad) == 0;
+	ok &= cache.count == 2 && equ_to_AFPoint(&(cache.entries[0].pubkey), P);
+	sm2_pubkey_cache_clean(&cache);
+
+	if (ok)
+	{
+		printf("[SUCCESS] SM2 public key table test correct.\n");
+	}
+	else
+	{
+		printf("[ERROR] SM2 public key table test failed.\n");
+	}
+}
+
+void sm2_verify_batch_self_check()
+{
+	enum { BATCH_SIGS = 70, BATCH_KEYS = 5 };
+	unsigned char IDA[17] = "1234567812345678";
+	unsigned char message[MSG_LEN];
+	PubKey pubkeys[BATCH_KEYS], pub[BATCH_SIGS];
+	PrivKey privkeys[BATCH_KEYS];
+	SM2SIG sigs[BATCH_SIGS];
+	u1 dgsts[BATCH_SIGS * 32], ZA[32], valid[(BATCH_SIGS + 7) / 8];
+	int expect[BATCH_SIGS];
+	int i, ok = 1;
+
+	puts("======== SM2 batch verify test =======");
+
+	for (i = 0; i < BATCH_KEYS; i++)
+	{
+		sm2_keypair(pubkeys + i, privkeys + i);
+	}
+	for (i = 0; i < BATCH_SIGS; i++)
+	{
+		int k = i % BATCH_KEYS;
+
+		random_fill(message, 100);
+		sm2_get_id_digest(ZA, IDA, strlen((char*)IDA), pubkeys + k);
+		sm2_get_message_digest(dgsts + 32 * i, ZA, message, 100);
+		sm2_sign_dgst(sigs + i, dgsts + 32 * i, privkeys + k);
+		pub[i] = pubkeys[k];
+	}
+
+	ok &= sm2_verify_dgst_batch(sigs, dgsts, pub, BATCH_SIGS, valid) == 1;
+	for (i = 0; i < BATCH_SIGS; i++)
+	{
+		ok &= (valid[i / 8] >> (i % 8)) & 1;
+	}
+	ok &= (valid[BATCH_SIGS / 8] >> (BATCH_SIGS % 8)) == 0;
+
+	/* Break some of them, one way each, on both sides of a group boundary */
+	sigs[3].s.v[0] ^= 1;
+	sigs[15].r.v[2] ^= 0x100;
+	dgsts[32 * 16 + 5] ^= 0x80;
+	pub[17] = pubkeys[(17 + 1) % BATCH_KEYS];
+	pub[31].y.v[0] ^= 1;                               /* not on the curve */
+	memset(&pub[32], 0, sizeof(PubKey));               /* point at infinity */
+	memset(&sigs[40].r, 0, sizeof(u32));
+	sigs[41].s = SM2_N;
+	sub_mod_n(&SM2_N, &sigs[42].r, &sigs[42].s);        /* r + s = n */
+	sigs[69].r = sigs[68].r;
+	for (i = 0; i < BATCH_SIGS; i++)
+	{
+		expect[i] = sm2_verify_dgst(sigs + i, dgsts + 32 * i, pub + i);
+	}
+
+	ok &= sm2_verify_dgst_batch(sigs, dgsts, pub, BATCH_SIGS, valid) == 0;
+	for (i = 0; i < BATCH_SIGS; i++)
+	{
+		int bad = i == 3 || i == 15 || i == 16 || i == 17 || i == 31 || i == 32 ||
+			i == 40 || i == 41 || i == 42 || i == 69;
+
+		ok &= ((valid[i / 8] >> (i % 8)) & 1) == !bad;
+		ok &= expect[i] == !bad;
+	}
+
+	/* Sizes that leave a partial group */
+	ok &= sm2_verify_dgst_batch(sigs, dgsts, pub, 3, valid) == 1 && valid[0] == 0x07;
+	ok &= sm2_verify_dgst_batch(sigs, dgsts, pub, 0, valid) == 1;
+
+	if (ok)
+	{
+		printf("[SUCCESS] SM2 batch verify test correct.\n");
+	}
+	else
+	{
+		printf("[ERROR] SM2 batch verify test failed.\n");
+	}
+}
+
+void sm3_drbg_self_check()
+{
+	const size_t bulk_len = 3 * SM3_DRBG_MAX_REQUEST + 100;
+	u1 *bulk = (u1 *)malloc(bulk_len);
+	u1 out[64], again[64];
+	u32 k;
+	size_t i;
+	int ok = 1;
+
+	puts("======== Per-thread SM3 Hash_DRBG test =======");
+
+	/* Buffered and bulk reads, across reseeds */
+	memset(bulk, 0, bulk_len);
+	for (i = 0; i < 20 * SM3_DRBG_RESEED_INTERVAL; i++)
+	{
+		sm3_drbg_random(out, 1 + i % 40);
+	}
+	sm3_drbg_random(bulk, bulk_len);
+	sm3_drbg_random(again, sizeof(again));
+	ok &= memcmp(bulk + bulk_len - sizeof(again), again, sizeof(again)) != 0;
+	ok &= memcmp(bulk, bulk + SM3_DRBG_MAX_REQUEST, 64) != 0;
+	for (i = 0; i < 1000; i++)
+	{
+		get_drbg_u32_in_mod_n(&k);
+		ok &= !u32_eq_zero(&k) && !u32_ge(&k, &SM2_N);
+	}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+	/* A forked child must not repeat the parent's output, buffered or not */
+	{
+		int fds[2];
+		pid_t pid;
+
+		sm3_drbg_random(out, 1);
+		ok &= pipe(fds) == 0;
+		pid = fork();
+		if (pid == 0)
+		{
+			sm3_drbg_random(out, 32);
+			_exit(write(fds[1], out, 32) == 32 ? 0 : 1);
+		}
+		sm3_drbg_random(out, 32);
+		ok &= pid > 0 && read(fds[0], again, 32) == 32;
+		ok &= memcmp(out, again, 32) != 0;
+		waitpid(pid, NULL, 0);
+		close(fds[0]);
+		close(fds[1]);
+	}
+#endif
+	free(bulk);
+
+	if (ok)
+	{
+		printf("[SUCCESS] SM3 Hash_DRBG test correct.\n");
+	}
+	else
+	{
+		printf("[ERROR] SM3 Hash_DRBG test failed.\n");
+	}
+}
+
 int sm2_demo(unsigned char *message, size_t len) //demo for sign and verify
 {
 	unsigned char IDA[17] = "1234567812345678";
@@ -951,6 +1367,12 @@ int main()
 {
 	// sm2_single_test();
 	sm2_self_check();
+	sm2_id_ctx_self_check();
+	sm2_sign_ctx_self_check();
+	sm2_joint_mul_self_check();
+	sm2_verify_batch_self_check();
+	sm2_pubkey_table_self_check();
+	sm3_drbg_self_check();
 #ifdef TEST_WITH_GMSSL
 	// test_sm2_do_sign_gmssl();
 	sm2_check_use_gmssl();
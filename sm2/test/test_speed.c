@@ -14,6 +14,7 @@
 
 #include "../include/sm2.h"
 #include "../include/utils.h"
+#include "../include/fieldOp.h"
 
 /* Benchmark configuration */
 #define MIN_BENCH_TIME  2.0    /* Minimum seconds to run each benchmark */
@@ -156,6 +157,172 @@ static void bench_sm2_keygen(void)
 #endif
 }
 
+/* ============================================================
+ * Batch Verify Benchmark
+ * ============================================================ */
+
+#define BATCH_VERIFY_N 256
+
+static void bench_sm2_verify_batch(void)
+{
+    printf("\n========== SM2 Batch Verify Benchmark (%d signatures, 16 keys) ==========\n", BATCH_VERIFY_N);
+
+    static uint8_t dgsts[BATCH_VERIFY_N * MSG_LEN];
+    static SM2SIG sigs[BATCH_VERIFY_N];
+    static PubKey pubs[BATCH_VERIFY_N];
+    PrivKey privkeys[16];
+    PubKey pubkeys[16];
+    uint8_t valid[(BATCH_VERIFY_N + 7) / 8];
+
+    random_fill(dgsts, sizeof(dgsts));
+    for (int i = 0; i < 16; i++) {
+        sm2_keypair(&pubkeys[i], &privkeys[i]);
+    }
+    for (int i = 0; i < BATCH_VERIFY_N; i++) {
+        sm2_sign_dgst(&sigs[i], dgsts + i * MSG_LEN, &privkeys[i % 16]);
+        pubs[i] = pubkeys[i % 16];
+    }
+
+    /* One by one */
+    {
+        uint64_t iterations = 0;
+        double start = get_time_sec();
+        double elapsed;
+
+        do {
+            for (int i = 0; i < BATCH_VERIFY_N; i++) {
+                sm2_verify_dgst(&sigs[i], dgsts + i * MSG_LEN, &pubs[i]);
+            }
+            iterations += BATCH_VERIFY_N;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        print_speed("sm2_verify_dgst loop (YCrypt)", iterations / elapsed);
+    }
+
+    /* Batch */
+    {
+        uint64_t iterations = 0;
+        double start = get_time_sec();
+        double elapsed;
+
+        do {
+            sm2_verify_dgst_batch(sigs, dgsts, pubs, BATCH_VERIFY_N, valid);
+            iterations += BATCH_VERIFY_N;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        print_speed("sm2_verify_dgst_batch (YCrypt)", iterations / elapsed);
+    }
+}
+
+/* ============================================================
+ * Public Key Table Verify Benchmark
+ * ============================================================ */
+
+static void bench_sm2_verify_table(void)
+{
+    printf("\n========== SM2 Public Key Table Verify Benchmark ==========\n");
+
+    static const int ws[] = { 4, 6, 8 };
+    uint8_t dgsts[16 * MSG_LEN];
+    PrivKey privkeys[16];
+    PubKey pubkeys[16];
+    SM2SIG sigs[16];
+    SM2_PUBKEY_TABLE tab;
+    SM2_PUBKEY_CACHE cache;
+    char name[64];
+
+    random_fill(dgsts, sizeof(dgsts));
+    for (int i = 0; i < 16; i++) {
+        sm2_keypair(&pubkeys[i], &privkeys[i]);
+        sm2_sign_dgst(&sigs[i], dgsts + i * MSG_LEN, &privkeys[i]);
+    }
+
+    for (size_t j = 0; j < sizeof(ws) / sizeof(ws[0]); j++) {
+        double start = get_time_sec();
+        sm2_pubkey_table_init(&tab, &pubkeys[0], ws[j]);
+        double build = get_time_sec() - start;
+
+        uint64_t iterations = 0;
+        double elapsed;
+        start = get_time_sec();
+        do {
+            sm2_verify_dgst_table(&sigs[0], dgsts, &tab);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        snprintf(name, sizeof(name), "sm2_verify_dgst_table w=%d (YCrypt)", ws[j]);
+        print_speed(name, iterations / elapsed);
+        printf("    table build: %.2f ms\n", build * 1e3);
+        sm2_pubkey_table_clean(&tab);
+    }
+
+    /* 16 keys in turn through a cache that holds all of them */
+    {
+        uint64_t iterations = 0;
+        double start, elapsed;
+
+        sm2_pubkey_cache_init(&cache, 16, 6);
+        for (int i = 0; i < 16; i++) {
+            sm2_verify_dgst_cached(&cache, &sigs[i], dgsts + i * MSG_LEN, &pubkeys[i]);
+        }
+        start = get_time_sec();
+        do {
+            for (int i = 0; i < 16; i++) {
+                sm2_verify_dgst_cached(&cache, &sigs[i], dgsts + i * MSG_LEN, &pubkeys[i]);
+            }
+            iterations += 16;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        print_speed("sm2_verify_dgst_cached 16 keys (YCrypt)", iterations / elapsed);
+        sm2_pubkey_cache_clean(&cache);
+    }
+}
+
+/* ============================================================
+ * Nonce Benchmark
+ * ============================================================ */
+
+static void bench_sm2_nonce(void)
+{
+    printf("\n========== SM2 Nonce Generation Benchmark ==========\n");
+
+    u32 k;
+
+    /* Benchmark OS randomness, one system call per 8 bytes */
+    {
+        uint64_t iterations = 0;
+        double start = get_time_sec();
+        double elapsed;
+
+        do {
+            get_random_u32_in_mod_n(&k);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        print_speed("get_random_u32_in_mod_n (OS)", iterations / elapsed);
+    }
+
+    /* Benchmark the per-thread SM3 Hash_DRBG */
+    {
+        uint64_t iterations = 0;
+        double start = get_time_sec();
+        double elapsed;
+
+        do {
+            get_drbg_u32_in_mod_n(&k);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        print_speed("get_drbg_u32_in_mod_n (SM3 DRBG)", iterations / elapsed);
+    }
+}
+
 /* ============================================================
  * Sign Benchmark
  * ============================================================ */
@@ -374,6 +541,54 @@ static void bench_sm2_sign_msg(void)
         double ops_per_sec = iterations / elapsed;
         print_speed("sm2_verify (msg, YCrypt)", ops_per_sec);
     }
+
+    /* Same with ZA computed once */
+    {
+        SM2_ID_CTX ctx;
+        uint64_t iterations = 0;
+        double start, elapsed;
+
+        sm2_id_ctx_init(&ctx, id, strlen((char*)id), &pubkey);
+        start = get_time_sec();
+        do {
+            sm2_sign_id_ctx(&sig, message, sizeof(message), &ctx, &privkey);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+        print_speed("sm2_sign_id_ctx (msg, YCrypt)", iterations / elapsed);
+
+        SM2_SIGN_CTX sctx;
+        sm2_sign_ctx_init(&sctx, id, strlen((char*)id), &pubkey, &privkey);
+        iterations = 0;
+        start = get_time_sec();
+        do {
+            sm2_sign_ctx(&sig, message, sizeof(message), &sctx);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+        print_speed("sm2_sign_ctx (msg, YCrypt)", iterations / elapsed);
+        sm2_sign_ctx_clean(&sctx);
+
+        iterations = 0;
+        start = get_time_sec();
+        do {
+            sm2_id_ctx_digest(&ctx, message, 32, message + 32);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+        print_speed("sm2_id_ctx_digest (32 B, YCrypt)", iterations / elapsed);
+
+        iterations = 0;
+        start = get_time_sec();
+        do {
+            uint8_t ZA[32];
+            sm2_get_id_digest(ZA, id, strlen((char*)id), &pubkey);
+            sm2_get_message_digest(message + 32, ZA, message, 32);
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+        print_speed("ZA + digest (32 B, YCrypt)", iterations / elapsed);
+    }
 }
 
 /* ============================================================
@@ -394,8 +609,11 @@ int main(void)
 #endif
 
     bench_sm2_keygen();
+    bench_sm2_nonce();
     bench_sm2_sign();
     bench_sm2_verify();
+    bench_sm2_verify_batch();
+    bench_sm2_verify_table();
     bench_sm2_sign_msg();
 
     printf("\n============================================\n");
@@ -0,0 +1,48 @@
+#ifndef SM3_IMPL_H
+#define SM3_IMPL_H
+
+/*
+ * SM3 compression backends.
+ * Internal to the sm3 module, the public API is in include/sm_interface.h
+ */
+#include "include/sm_interface.h"
+#include "include/ycrypt_cpu.h"
+
+/* nblocks consecutive blocks of one message */
+typedef void (*sm3_compress_fn)(u4 digest[8], const u1 *block, size_t nblocks);
+
+/*
+ * nblocks consecutive blocks of every lane. The chaining values are kept
+ * transposed: word i of lane d is state[i * lanes + d], lane d reads its
+ * blocks from data[d].
+ */
+typedef void (*sm3_mb_compress_fn)(uint32_t *state, const u1 *const *data, size_t nblocks);
+
+typedef struct {
+  const char *name;
+  sm3_compress_fn compress;
+  /* Multi-buffer kernel over mb_lanes independent messages */
+  sm3_mb_compress_fn mb_compress;
+  size_t mb_lanes;
+} SM3_BACKEND;
+
+/* Backend picked for this CPU, selected on first use */
+const SM3_BACKEND *sm3_backend(void);
+
+/* sm3_mb_submit for a message hashed on from state, after prefix_blocks blocks */
+SM3_MB_JOB *sm3_mb_submit_midstate(SM3_MB_MGR *mgr, SM3_MB_JOB *job, const uint32_t state[8], size_t prefix_blocks);
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+/* Scalar rounds, message expansion in SSE registers */
+void sm3_ssse3_compress(u4 digest[8], const u1 *block, size_t nblocks);
+/* AVX2 with 8 lanes, AVX-512 with 16 lanes */
+void sm3_avx2_mb_compress(uint32_t *state, const u1 *const *data, size_t nblocks);
+void sm3_avx512_mb_compress(uint32_t *state, const u1 *const *data, size_t nblocks);
+#endif
+
+#ifdef YCRYPT_HAVE_ARM_CE
+/* ARMv8.2 SM3 instructions, single stream */
+void sm3_armv8_compress(u4 digest[8], const u1 *block, size_t nblocks);
+#endif
+
+#endif
@@ -1,6 +1,6 @@
 #include "include/sm3.h"
-
-#ifndef AVX_SM3
+#include "include/sm3_impl.h"
+#include <stdatomic.h>
 
 #define ROTL32(X,n)  (((X)<<(n%32)) | ((X)>>(32-(n%32))))
 
@@ -60,7 +60,6 @@ static uint32_t Ti[64] =
 	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
 	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
 };
-#endif // end not define AVX_SM3
 
 void sm3_init(SM3_CTX *ctx)
 {
@@ -144,8 +143,7 @@ void sm3_final(SM3_CTX *ctx, u1 digest[SM3_DIGEST_LENGTH])
 	}
 }
 
-#ifndef AVX_SM3
-void sm3_compress(u4 digest[8], const u1* block, size_t nblocks)
+static void sm3_compress_portable(u4 digest[8], const u1* block, size_t nblocks)
 {
 	size_t i = 0, j = 0; 
 	uint32_t k;
@@ -203,7 +201,104 @@ void sm3_compress(u4 digest[8], const u1* block, size_t nblocks)
 		digest[7] = H = digest[7] ^ H;
 	}
 }
-#endif // end not define AVX_SM3
+
+/*
+ * Backends. Without a SIMD multi-buffer kernel, jobs run one lane at a
+ * time through the single-stream compression.
+ */
+static void sm3_portable_mb_compress(uint32_t *state, const u1 *const *data, size_t nblocks)
+{
+	sm3_compress(state, data[0], nblocks);
+}
+
+static const SM3_BACKEND sm3_backend_portable = { "portable", sm3_compress_portable, sm3_portable_mb_compress, 1 };
+#ifdef YCRYPT_HAVE_X86_SIMD
+static const SM3_BACKEND sm3_backend_ssse3 = { "ssse3", sm3_ssse3_compress, sm3_portable_mb_compress, 1 };
+static const SM3_BACKEND sm3_backend_avx2 = { "avx2", sm3_ssse3_compress, sm3_avx2_mb_compress, 8 };
+static const SM3_BACKEND sm3_backend_avx512 = { "avx512", sm3_ssse3_compress, sm3_avx512_mb_compress, 16 };
+#endif
+#ifdef YCRYPT_HAVE_ARM_CE
+static const SM3_BACKEND sm3_backend_armv8 = { "armv8-ce", sm3_armv8_compress, sm3_portable_mb_compress, 1 };
+#endif
+
+/* Best backend of the requested kind usable on this CPU, NULL if none */
+static const SM3_BACKEND *sm3_backend_select(SM3_IMPL impl)
+{
+#ifdef YCRYPT_HAVE_X86_SIMD
+	unsigned int f = ycrypt_cpu_features();
+
+	if ((impl == SM3_IMPL_AUTO || impl == SM3_IMPL_AVX512) && (f & YCRYPT_CPU_AVX512))
+	{
+		return &sm3_backend_avx512;
+	}
+	if ((impl == SM3_IMPL_AUTO || impl == SM3_IMPL_AVX2) && (f & YCRYPT_CPU_AVX2))
+	{
+		return &sm3_backend_avx2;
+	}
+	if ((impl == SM3_IMPL_AUTO || impl == SM3_IMPL_SSSE3) && (f & YCRYPT_CPU_SSSE3))
+	{
+		return &sm3_backend_ssse3;
+	}
+#endif
+
+#ifdef YCRYPT_HAVE_ARM_CE
+	if ((impl == SM3_IMPL_AUTO || impl == SM3_IMPL_ARMV8) && (ycrypt_cpu_features() & YCRYPT_CPU_ARM_SM3))
+	{
+		return &sm3_backend_armv8;
+	}
+#endif
+
+	if (impl == SM3_IMPL_AUTO || impl == SM3_IMPL_PORTABLE)
+	{
+		return &sm3_backend_portable;
+	}
+
+	return NULL;
+}
+
+/*
+ * Selected on first use, possibly by several threads at once (tree
+ * workers, per-thread DRBGs): each stores the same pointer and the
+ * atomic store/load makes the race defined.
+ */
+static _Atomic(const SM3_BACKEND *) sm3_backend_current = NULL;
+
+const SM3_BACKEND *sm3_backend(void)
+{
+	const SM3_BACKEND *backend = atomic_load_explicit(&sm3_backend_current, memory_order_acquire);
+
+	if (backend == NULL)
+	{
+		backend = sm3_backend_select(SM3_IMPL_AUTO);
+		atomic_store_explicit(&sm3_backend_current, backend, memory_order_release);
+	}
+
+	return backend;
+}
+
+/* For tests and benchmarks, see sm_interface.h */
+int sm3_set_impl(SM3_IMPL impl)
+{
+	const SM3_BACKEND *backend = sm3_backend_select(impl);
+
+	if (backend == NULL)
+	{
+		return 0;
+	}
+	atomic_store_explicit(&sm3_backend_current, backend, memory_order_release);
+
+	return 1;
+}
+
+const char *sm3_get_impl_name(void)
+{
+	return sm3_backend()->name;
+}
+
+void sm3_compress(u4 digest[8], const u1* block, size_t nblocks)
+{
+	sm3_backend()->compress(digest, block, nblocks);
+}
 
 size_t sm3(const u1 *data, size_t datalen, u1 dgst[SM3_DIGEST_LENGTH])
 {
@@ -217,32 +312,148 @@ size_t sm3(const u1 *data, size_t datalen, u1 dgst[SM3_DIGEST_LENGTH])
 	return SM3_DIGEST_LENGTH;
 }
 
+#define SM3_STATE_MAGIC    "SM3S"
+#define SM3_STATE_VERSION  1
+
+void sm3_export(const SM3_CTX *ctx, u1 state[SM3_STATE_SIZE])
+{
+	uint64_t nblocks = (uint64_t)ctx->nblocks;
+	int i;
+
+	memcpy(state, SM3_STATE_MAGIC, 4);
+	state[4] = SM3_STATE_VERSION;
+	state[5] = (u1)ctx->num;
+	state[6] = 0;
+	state[7] = 0;
+	for (i = 0; i < 8; i++)
+	{
+		state[8 + 4 * i] = (u1)(ctx->digest[i] >> 24);
+		state[9 + 4 * i] = (u1)(ctx->digest[i] >> 16);
+		state[10 + 4 * i] = (u1)(ctx->digest[i] >> 8);
+		state[11 + 4 * i] = (u1)ctx->digest[i];
+	}
+	for (i = 0; i < 8; i++)
+	{
+		state[40 + i] = (u1)(nblocks >> (56 - 8 * i));
+	}
+	memcpy(state + 48, ctx->block, ctx->num);
+	memset(state + 48 + ctx->num, 0, SM3_BLOCK_SIZE - ctx->num);
+}
+
+int sm3_import(SM3_CTX *ctx, const u1 state[SM3_STATE_SIZE])
+{
+	uint64_t nblocks = 0;
+	size_t num = state[5], j;
+	u1 pad = 0;
+	int i;
+
+	if (memcmp(state, SM3_STATE_MAGIC, 4) != 0 || state[4] != SM3_STATE_VERSION ||
+		num >= SM3_BLOCK_SIZE || state[6] != 0 || state[7] != 0)
+	{
+		return 0;
+	}
+	for (i = 0; i < 8; i++)
+	{
+		nblocks = (nblocks << 8) | state[40 + i];
+	}
+	/* The bit length must fit the 64-bit length field, and nblocks a size_t */
+	if (nblocks >> 55 || nblocks > (uint64_t)SIZE_MAX)
+	{
+		return 0;
+	}
+	for (j = num; j < SM3_BLOCK_SIZE; j++)
+	{
+		pad |= state[48 + j];
+	}
+	if (pad)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < 8; i++)
+	{
+		ctx->digest[i] = ((uint32_t)state[8 + 4 * i] << 24) | ((uint32_t)state[9 + 4 * i] << 16) |
+			((uint32_t)state[10 + 4 * i] << 8) | state[11 + 4 * i];
+	}
+	ctx->nblocks = (size_t)nblocks;
+	memcpy(ctx->block, state + 48, num);
+	ctx->num = num;
+	return 1;
+}
+
 
 #define IPAD	0x36
 #define OPAD	0x5C
-void sm3_hmac_init(SM3_HMAC_CTX *ctx, const u1 *key, size_t keylen)
+
+/* Continue a hash whose first block is already compressed into digest */
+static void sm3_init_midstate(SM3_CTX *ctx, const uint32_t digest[8])
 {
+	memcpy(ctx->digest, digest, sizeof(ctx->digest));
+	ctx->nblocks = 1;
+	ctx->num = 0;
+}
+
+void sm3_hmac_key_init(SM3_HMAC_KEY *hkey, const u1 *key, size_t keylen)
+{
+	u1 block[SM3_BLOCK_SIZE];
+	SM3_CTX ctx;
 	uint32_t i = 0;
 
 	if (keylen <= SM3_BLOCK_SIZE)
 	{
-		memcpy(ctx->key, key, keylen);
-		memset(ctx->key + keylen, 0, SM3_BLOCK_SIZE - keylen);
+		memcpy(block, key, keylen);
+		memset(block + keylen, 0, SM3_BLOCK_SIZE - keylen);
 	}
 	else
 	{
-		sm3_init(&ctx->sm3_ctx);
-		sm3_update(&ctx->sm3_ctx, key, keylen);
-		sm3_final(&ctx->sm3_ctx, ctx->key);
-		memset(ctx->key + SM3_DIGEST_LENGTH, 0, SM3_BLOCK_SIZE - SM3_DIGEST_LENGTH);
+		sm3(key, keylen, block);
+		memset(block + SM3_DIGEST_LENGTH, 0, SM3_BLOCK_SIZE - SM3_DIGEST_LENGTH);
+	}
+
+	for (i = 0; i < SM3_BLOCK_SIZE; i++)
+	{
+		block[i] ^= IPAD;
 	}
+	sm3_init(&ctx);
+	sm3_compress(ctx.digest, block, 1);
+	memcpy(hkey->ipad_digest, ctx.digest, sizeof(hkey->ipad_digest));
+
 	for (i = 0; i < SM3_BLOCK_SIZE; i++)
 	{
-		ctx->key[i] ^= IPAD;
+		block[i] ^= (IPAD ^ OPAD);
 	}
+	sm3_init(&ctx);
+	sm3_compress(ctx.digest, block, 1);
+	memcpy(hkey->opad_digest, ctx.digest, sizeof(hkey->opad_digest));
 
-	sm3_init(&ctx->sm3_ctx);
-	sm3_update(&ctx->sm3_ctx, ctx->key, SM3_BLOCK_SIZE);
+	memset(block, 0, sizeof(block));
+	memset(&ctx, 0, sizeof(ctx));
+}
+
+void sm3_hmac_key_clean(SM3_HMAC_KEY *hkey)
+{
+	memset(hkey, 0, sizeof(SM3_HMAC_KEY));
+}
+
+void sm3_hmac_init_key(SM3_HMAC_CTX *ctx, const SM3_HMAC_KEY *hkey)
+{
+	memcpy(ctx->ipad_digest, hkey->ipad_digest, sizeof(ctx->ipad_digest));
+	memcpy(ctx->opad_digest, hkey->opad_digest, sizeof(ctx->opad_digest));
+	sm3_hmac_reset(ctx);
+}
+
+void sm3_hmac_reset(SM3_HMAC_CTX *ctx)
+{
+	sm3_init_midstate(&ctx->sm3_ctx, ctx->ipad_digest);
+}
+
+void sm3_hmac_init(SM3_HMAC_CTX *ctx, const u1 *key, size_t keylen)
+{
+	SM3_HMAC_KEY hkey;
+
+	sm3_hmac_key_init(&hkey, key, keylen);
+	sm3_hmac_init_key(ctx, &hkey);
+	sm3_hmac_key_clean(&hkey);
 }
 
 void sm3_hmac_update(SM3_HMAC_CTX *ctx, const u1 *data, size_t data_len)
@@ -252,17 +463,31 @@ void sm3_hmac_update(SM3_HMAC_CTX *ctx, const u1 *data, size_t data_len)
 
 void sm3_hmac_final(SM3_HMAC_CTX *ctx, u1 mac[SM3_HMAC_SIZE])
 {
-	uint32_t i = 0;
+	u1 inner[SM3_DIGEST_LENGTH];
 
-	for (i = 0; i < SM3_BLOCK_SIZE; i++)
-	{
-		ctx->key[i] ^= (IPAD ^ OPAD);
-	}
-	sm3_final(&ctx->sm3_ctx, mac);
-	sm3_init(&ctx->sm3_ctx);
-	sm3_update(&ctx->sm3_ctx, ctx->key, SM3_BLOCK_SIZE);
-	sm3_update(&ctx->sm3_ctx, mac, SM3_DIGEST_LENGTH);
+	/* The outer hash is a single block after the cached opad one */
+	sm3_final(&ctx->sm3_ctx, inner);
+	sm3_init_midstate(&ctx->sm3_ctx, ctx->opad_digest);
+	sm3_update(&ctx->sm3_ctx, inner, SM3_DIGEST_LENGTH);
 	sm3_final(&ctx->sm3_ctx, mac);
+	memset(inner, 0, sizeof(inner));
+}
+
+size_t sm3_hmac_with_key(const SM3_HMAC_KEY *hkey, const u1 *data, size_t data_len, u1 mac[SM3_HMAC_SIZE])
+{
+	SM3_CTX ctx;
+	u1 inner[SM3_DIGEST_LENGTH];
+
+	sm3_init_midstate(&ctx, hkey->ipad_digest);
+	sm3_update(&ctx, data, data_len);
+	sm3_final(&ctx, inner);
+	sm3_init_midstate(&ctx, hkey->opad_digest);
+	sm3_update(&ctx, inner, SM3_DIGEST_LENGTH);
+	sm3_final(&ctx, mac);
+
+	memset(inner, 0, sizeof(inner));
+	memset(&ctx, 0, sizeof(ctx));
+	return SM3_HMAC_SIZE;
 }
 
 size_t sm3_hmac(const u1 *data, size_t data_len, const u1 *key, size_t key_len, u1 mac[SM3_HMAC_SIZE])
@@ -0,0 +1,107 @@
+/**
+ * SM3 compression with the ARMv8.2 SM3 instructions (AArch64)
+ *
+ * The chaining value lives in two vectors, A..D and E..H with A and E in
+ * the top lane. SM3SS1 computes SS1, SM3TT1A/B and SM3TT2A/B run one round
+ * each on their half, taking W'[j] and W[j] from a lane of a message
+ * vector. SM3PARTW1/SM3PARTW2 expand four schedule words at a time.
+ */
+
+#include "include/sm3_impl.h"
+
+#ifdef YCRYPT_HAVE_ARM_CE
+
+#include <arm_neon.h>
+
+#define SM3_CE_TARGET __attribute__((target("arch=armv8.2-a+sm4")))
+
+/*
+ * Round j with W[j] and W'[j] in lane i of w and wp. Only the top lane of
+ * t is used, it holds T_j rotated left by j; t_next gets T_j+1.
+ */
+#define SM3_CE_ROUND(ab, w, wp, t, t_next, i)                                  \
+	do {                                                                       \
+		uint32x4_t ss1 = vsm3ss1q_u32(abcd, t, efgh);                          \
+		t_next = vsriq_n_u32(vshlq_n_u32(t, 1), t, 31);                        \
+		abcd = vsm3tt1##ab##q_u32(abcd, ss1, wp, i);                           \
+		efgh = vsm3tt2##ab##q_u32(efgh, ss1, w, i);                            \
+	} while (0)
+
+/* Rounds j..j+3, W0 = W[j..j+3] and W1 = W[j+4..j+7] */
+#define SM3_CE_QROUND(ab, W0, W1)                                              \
+	do {                                                                       \
+		uint32x4_t wp = veorq_u32(W0, W1);                                     \
+		SM3_CE_ROUND(ab, W0, wp, t0, t1, 0);                                   \
+		SM3_CE_ROUND(ab, W0, wp, t1, t0, 1);                                   \
+		SM3_CE_ROUND(ab, W0, wp, t0, t1, 2);                                   \
+		SM3_CE_ROUND(ab, W0, wp, t1, t0, 3);                                   \
+	} while (0)
+
+/* Same, W0..W3 hold W[j..j+15] and W[j+16..j+19] goes to W4 alongside */
+#define SM3_CE_QROUND_EXPAND(ab, W0, W1, W2, W3, W4)                           \
+	do {                                                                       \
+		uint32x4_t w3 = vextq_u32(W0, W1, 3);                                  \
+		uint32x4_t w10 = vextq_u32(W2, W3, 2);                                 \
+		W4 = vsm3partw1q_u32(vextq_u32(W1, W2, 3), W0, W3);                    \
+		SM3_CE_QROUND(ab, W0, W1);                                             \
+		W4 = vsm3partw2q_u32(W4, w10, w3);                                     \
+	} while (0)
+
+/* A..D (or E..H) from digest order into the lane order of the instructions */
+SM3_CE_TARGET
+static inline uint32x4_t sm3_ce_reverse(uint32x4_t x)
+{
+	x = vrev64q_u32(x);
+
+	return vextq_u32(x, x, 2);
+}
+
+SM3_CE_TARGET
+void sm3_armv8_compress(u4 digest[8], const u1 *block, size_t nblocks)
+{
+	const uint32x4_t t_lo = vsetq_lane_u32(0x79CC4519, vdupq_n_u32(0), 3);
+	/* T_16 = 0x7A879D8A rotated left by 16 */
+	const uint32x4_t t_hi = vsetq_lane_u32(0x9D8A7A87, vdupq_n_u32(0), 3);
+	uint32x4_t abcd = sm3_ce_reverse(vld1q_u32(digest));
+	uint32x4_t efgh = sm3_ce_reverse(vld1q_u32(digest + 4));
+	uint32x4_t W0, W1, W2, W3, W4, t0, t1;
+
+	while (nblocks--)
+	{
+		const uint32x4_t abcd_in = abcd, efgh_in = efgh;
+
+		W0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block)));
+		W1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block + 16)));
+		W2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block + 32)));
+		W3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block + 48)));
+		block += SM3_BLOCK_SIZE;
+
+		t0 = t_lo;
+		SM3_CE_QROUND_EXPAND(a, W0, W1, W2, W3, W4);
+		SM3_CE_QROUND_EXPAND(a, W1, W2, W3, W4, W0);
+		SM3_CE_QROUND_EXPAND(a, W2, W3, W4, W0, W1);
+		SM3_CE_QROUND_EXPAND(a, W3, W4, W0, W1, W2);
+
+		t0 = t_hi;
+		SM3_CE_QROUND_EXPAND(b, W4, W0, W1, W2, W3);
+		SM3_CE_QROUND_EXPAND(b, W0, W1, W2, W3, W4);
+		SM3_CE_QROUND_EXPAND(b, W1, W2, W3, W4, W0);
+		SM3_CE_QROUND_EXPAND(b, W2, W3, W4, W0, W1);
+		SM3_CE_QROUND_EXPAND(b, W3, W4, W0, W1, W2);
+		SM3_CE_QROUND_EXPAND(b, W4, W0, W1, W2, W3);
+		SM3_CE_QROUND_EXPAND(b, W0, W1, W2, W3, W4);
+		SM3_CE_QROUND_EXPAND(b, W1, W2, W3, W4, W0);
+		SM3_CE_QROUND_EXPAND(b, W2, W3, W4, W0, W1);
+		SM3_CE_QROUND(b, W3, W4);
+		SM3_CE_QROUND(b, W4, W0);
+		SM3_CE_QROUND(b, W0, W1);
+
+		abcd = veorq_u32(abcd, abcd_in);
+		efgh = veorq_u32(efgh, efgh_in);
+	}
+
+	vst1q_u32(digest, sm3_ce_reverse(abcd));
+	vst1q_u32(digest + 4, sm3_ce_reverse(efgh));
+}
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * SM3 Hash_DRBG, NIST SP 800-90A 10.1.1 (also GM/T 0105) with SM3
+ *
+ * V and C are 440-bit big-endian integers. Hash_df derives them from the
+ * seed material, and each request hashes V, V+1, ... and then updates V.
+ * Those hashes are independent one-block messages, so the blocks of a
+ * request are computed across the multi-buffer lanes. Entropy comes from
+ * the caller; sm2/drbg.c runs one instance per thread on top of this.
+ */
+
+#include "include/sm3.h"
+#include "include/sm3_impl.h"
+
+typedef struct
+{
+	const u1 *data;
+	size_t len;
+} DRBG_INPUT;
+
+/* Hash_df: leftmost seedlen bits of SM3(counter || BE32(440) || input), counter = 1, 2 */
+static void drbg_hash_df(u1 out[SM3_DRBG_SEED_LEN], const DRBG_INPUT *in, size_t nin)
+{
+	u1 head[5] = { 1, 0, 0, SM3_DRBG_SEED_LEN * 8 >> 8, SM3_DRBG_SEED_LEN * 8 & 0xFF };
+	u1 dgst[SM3_DIGEST_LENGTH];
+	SM3_CTX ctx;
+	size_t pos, i;
+
+	for (pos = 0; pos < SM3_DRBG_SEED_LEN; pos += SM3_DIGEST_LENGTH, head[0]++)
+	{
+		sm3_init(&ctx);
+		sm3_update(&ctx, head, sizeof(head));
+		for (i = 0; i < nin; i++)
+		{
+			if (in[i].len)
+			{
+				sm3_update(&ctx, in[i].data, in[i].len);
+			}
+		}
+		sm3_final(&ctx, dgst);
+		memcpy(out + pos, dgst, SM3_DRBG_SEED_LEN - pos < SM3_DIGEST_LENGTH ? SM3_DRBG_SEED_LEN - pos : SM3_DIGEST_LENGTH);
+	}
+
+	memset(dgst, 0, sizeof(dgst));
+	memset(&ctx, 0, sizeof(SM3_CTX));
+}
+
+/* SM3(prefix || V || data) */
+static void drbg_hash_v(u1 out[SM3_DIGEST_LENGTH], u1 prefix, const u1 V[SM3_DRBG_SEED_LEN], const u1 *data, size_t len)
+{
+	SM3_CTX ctx;
+
+	sm3_init(&ctx);
+	sm3_update(&ctx, &prefix, 1);
+	sm3_update(&ctx, V, SM3_DRBG_SEED_LEN);
+	if (len)
+	{
+		sm3_update(&ctx, data, len);
+	}
+	sm3_final(&ctx, out);
+
+	memset(&ctx, 0, sizeof(SM3_CTX));
+}
+
+/* V = (V + x) mod 2^440, x big-endian of xlen <= seedlen bytes */
+static void drbg_add(u1 V[SM3_DRBG_SEED_LEN], const u1 *x, size_t xlen)
+{
+	unsigned int carry = 0;
+	size_t i;
+
+	for (i = 1; i <= SM3_DRBG_SEED_LEN; i++)
+	{
+		carry += V[SM3_DRBG_SEED_LEN - i];
+		if (i <= xlen)
+		{
+			carry += x[xlen - i];
+		}
+		V[SM3_DRBG_SEED_LEN - i] = (u1)carry;
+		carry >>= 8;
+	}
+}
+
+/* Hashgen: SM3(V) || SM3(V + 1) || ..., the blocks are independent and go through the multi-buffer lanes */
+static void drbg_hashgen(const u1 V[SM3_DRBG_SEED_LEN], u1 *out, size_t len)
+{
+	u1 data[SM3_MB_MAX_LANES][SM3_DRBG_SEED_LEN];
+	SM3_MB_JOB jobs[SM3_MB_MAX_LANES];
+	size_t lanes = sm3_backend()->mb_lanes;
+	const u1 one = 0x01;
+	size_t nb, i, n;
+
+	memcpy(data[0], V, SM3_DRBG_SEED_LEN);
+	while (len)
+	{
+		nb = (len + SM3_DIGEST_LENGTH - 1) / SM3_DIGEST_LENGTH;
+		nb = nb < lanes ? nb : lanes;
+		for (i = 0; i < nb; i++)
+		{
+			if (i)
+			{
+				memcpy(data[i], data[i - 1], SM3_DRBG_SEED_LEN);
+				drbg_add(data[i], &one, 1);
+			}
+			jobs[i].data = data[i];
+			jobs[i].len = SM3_DRBG_SEED_LEN;
+		}
+		if (nb == 1)
+		{
+			sm3(data[0], SM3_DRBG_SEED_LEN, jobs[0].digest);
+		}
+		else
+		{
+			sm3_mb(jobs, nb);
+		}
+
+		for (i = 0; i < nb; i++)
+		{
+			n = len < SM3_DIGEST_LENGTH ? len : SM3_DIGEST_LENGTH;
+			memcpy(out, jobs[i].digest, n);
+			out += n;
+			len -= n;
+		}
+		memcpy(data[0], data[nb - 1], SM3_DRBG_SEED_LEN);
+		drbg_add(data[0], &one, 1);
+	}
+
+	memset(data, 0, sizeof(data));
+	memset(jobs, 0, sizeof(jobs));
+}
+
+/* C = Hash_df(0x00 || V) */
+static void drbg_derive_c(SM3_DRBG *drbg)
+{
+	const u1 zero = 0x00;
+	DRBG_INPUT in[2] = { { &zero, 1 }, { drbg->V, SM3_DRBG_SEED_LEN } };
+
+	drbg_hash_df(drbg->C, in, 2);
+	drbg->reseed_counter = 1;
+}
+
+void sm3_drbg_instantiate(SM3_DRBG *drbg, const u1 *entropy, size_t entropy_len,
+	const u1 *nonce, size_t nonce_len, const u1 *pers, size_t pers_len)
+{
+	DRBG_INPUT in[3] = { { entropy, entropy_len }, { nonce, nonce_len }, { pers, pers_len } };
+
+	drbg_hash_df(drbg->V, in, 3);
+	drbg_derive_c(drbg);
+}
+
+void sm3_drbg_reseed(SM3_DRBG *drbg, const u1 *entropy, size_t entropy_len,
+	const u1 *add, size_t add_len)
+{
+	const u1 one = 0x01;
+	u1 V[SM3_DRBG_SEED_LEN];
+	DRBG_INPUT in[4] = { { &one, 1 }, { V, SM3_DRBG_SEED_LEN }, { entropy, entropy_len }, { add, add_len } };
+
+	memcpy(V, drbg->V, SM3_DRBG_SEED_LEN);
+	drbg_hash_df(drbg->V, in, 4);
+	drbg_derive_c(drbg);
+
+	memset(V, 0, sizeof(V));
+}
+
+int sm3_drbg_generate(SM3_DRBG *drbg, u1 *out, size_t len, const u1 *add, size_t add_len)
+{
+	u1 H[SM3_DIGEST_LENGTH], counter[8];
+	int i;
+
+	if (drbg->reseed_counter > SM3_DRBG_RESEED_INTERVAL || len > SM3_DRBG_MAX_REQUEST)
+	{
+		return 0;
+	}
+
+	if (add_len)
+	{
+		drbg_hash_v(H, 0x02, drbg->V, add, add_len);
+		drbg_add(drbg->V, H, SM3_DIGEST_LENGTH);
+	}
+
+	drbg_hashgen(drbg->V, out, len);
+
+	/* V = V + Hash(0x03 || V) + C + reseed_counter */
+	drbg_hash_v(H, 0x03, drbg->V, NULL, 0);
+	for (i = 0; i < 8; i++)
+	{
+		counter[i] = (u1)(drbg->reseed_counter >> (56 - 8 * i));
+	}
+	drbg_add(drbg->V, H, SM3_DIGEST_LENGTH);
+	drbg_add(drbg->V, drbg->C, SM3_DRBG_SEED_LEN);
+	drbg_add(drbg->V, counter, sizeof(counter));
+	drbg->reseed_counter++;
+
+	memset(H, 0, sizeof(H));
+	return 1;
+}
+
+void sm3_drbg_clean(SM3_DRBG *drbg)
+{
+	memset(drbg, 0, sizeof(SM3_DRBG));
+}
+
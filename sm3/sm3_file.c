@@ -0,0 +1,175 @@
+/**
+ * SM3 over file descriptors and paths
+ *
+ * Regular files are mapped a window at a time and the mapping is handed
+ * to sm3_update, so whole blocks go to sm3_compress straight from the
+ * page cache, without a copy into a user buffer. MADV_SEQUENTIAL lets
+ * the kernel read ahead and drop pages behind us; a window is unmapped
+ * before the next one, so the footprint stays at one window whatever the
+ * file size. Pipes, sockets and anything mmap refuses go through read()
+ * with a large buffer.
+ */
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include "include/sm3.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#define sm3_read(fd, buf, len)  _read((fd), (buf), (unsigned int)(len))
+#define sm3_open(path)          _open((path), _O_RDONLY | _O_BINARY)
+#define sm3_close               _close
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SM3_HAVE_MMAP 1
+#define sm3_read                read
+#define sm3_open(path)          open((path), O_RDONLY | O_CLOEXEC)
+#define sm3_close               close
+#endif
+
+/* Mapping window, a multiple of the page size and of SM3_BLOCK_SIZE */
+#define SM3_MAP_WINDOW  ((size_t)64 << 20)
+/* Buffer of the read() fallback */
+#define SM3_READ_BUFFER ((size_t)1 << 20)
+
+#ifdef SM3_HAVE_MMAP
+/*
+ * Hash a regular file from the current offset to its end through mmap.
+ * @return 1 done, 0 error, -1 not mappable (nothing consumed)
+ */
+static int sm3_update_mmap(SM3_CTX *ctx, int fd)
+{
+	struct stat st;
+	off_t pos, start, end, page;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		return -1;
+	}
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos < 0)
+	{
+		return -1;
+	}
+	end = st.st_size;
+	start = pos;
+	page = (off_t)sysconf(_SC_PAGESIZE);
+
+	while (pos < end)
+	{
+		/* Mappings start on a page boundary, skip the head of the first */
+		off_t base = pos - pos % page;
+		size_t skip = (size_t)(pos - base);
+		size_t len = (size_t)(end - base) < SM3_MAP_WINDOW ? (size_t)(end - base) : SM3_MAP_WINDOW;
+		u1 *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, base);
+
+		if (map == MAP_FAILED)
+		{
+			/* Only the first window may still fall back to read() */
+			return pos == start ? -1 : 0;
+		}
+		posix_madvise(map, len, POSIX_MADV_SEQUENTIAL);
+		sm3_update(ctx, map + skip, len - skip);
+		munmap(map, len);
+		pos = base + (off_t)len;
+	}
+
+	/* Leave the offset where read() would have */
+	return start >= end || lseek(fd, end, SEEK_SET) == end;
+}
+#endif
+
+static int sm3_update_read(SM3_CTX *ctx, int fd)
+{
+	u1 *buf = (u1 *)malloc(SM3_READ_BUFFER);
+	int ok = 1;
+
+	if (buf == NULL)
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		/* Fill the whole buffer so sm3_update gets whole blocks */
+		size_t filled = 0;
+		int eof = 0;
+
+		while (filled < SM3_READ_BUFFER)
+		{
+			long n = (long)sm3_read(fd, buf + filled, SM3_READ_BUFFER - filled);
+
+			if (n < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (n <= 0)
+			{
+				ok = n == 0;
+				eof = 1;
+				break;
+			}
+			filled += (size_t)n;
+		}
+		sm3_update(ctx, buf, filled);
+		if (eof)
+		{
+			break;
+		}
+	}
+
+	memset(buf, 0, SM3_READ_BUFFER);
+	free(buf);
+	return ok;
+}
+
+int sm3_update_fd(SM3_CTX *ctx, int fd)
+{
+#ifdef SM3_HAVE_MMAP
+	int ret = sm3_update_mmap(ctx, fd);
+
+	if (ret >= 0)
+	{
+		return ret;
+	}
+#endif
+
+	return sm3_update_read(ctx, fd);
+}
+
+int sm3_fd(int fd, u1 digest[SM3_DIGEST_LENGTH])
+{
+	SM3_CTX ctx;
+	int ok;
+
+	sm3_init(&ctx);
+	ok = sm3_update_fd(&ctx, fd);
+	if (ok)
+	{
+		sm3_final(&ctx, digest);
+	}
+
+	memset(&ctx, 0, sizeof(SM3_CTX));
+	return ok;
+}
+
+int sm3_file(const char *path, u1 digest[SM3_DIGEST_LENGTH])
+{
+	int fd = sm3_open(path);
+	int ok;
+
+	if (fd < 0)
+	{
+		return 0;
+	}
+	ok = sm3_fd(fd, digest);
+	sm3_close(fd);
+
+	return ok;
+}
@@ -0,0 +1,88 @@
+/**
+ * SM3 key derivation function, GM/T 0003.4 5.4.3
+ *
+ *   K = SM3(Z || ct_1) || SM3(Z || ct_2) || ...   ct_i = BE32(i), i >= 1
+ *
+ * Z is absorbed once and every block continues from that state with
+ * its counter, so a block costs one or two compressions however long Z
+ * is. Whole blocks are written straight into the caller's buffer, only
+ * a block split across two squeeze calls is kept in the context. The
+ * counter is 32 bits: at most 2^32 - 1 blocks come out of one Z.
+ */
+
+#include "include/sm3.h"
+
+#define SM3_KDF_MAX_BLOCKS 0xFFFFFFFFULL
+
+static void sm3_kdf_block(const SM3_KDF_CTX *kctx, uint32_t ct, u1 out[SM3_DIGEST_LENGTH])
+{
+	SM3_CTX ctx = kctx->z_ctx;
+	u1 counter[4];
+
+	counter[0] = (u1)(ct >> 24);
+	counter[1] = (u1)(ct >> 16);
+	counter[2] = (u1)(ct >> 8);
+	counter[3] = (u1)ct;
+	sm3_update(&ctx, counter, sizeof(counter));
+	sm3_final(&ctx, out);
+
+	memset(&ctx, 0, sizeof(SM3_CTX));
+}
+
+void sm3_kdf_init(SM3_KDF_CTX *ctx, const u1 *z, size_t zlen)
+{
+	sm3_init(&ctx->z_ctx);
+	sm3_update(&ctx->z_ctx, z, zlen);
+	ctx->blocks = 0;
+	ctx->used = SM3_DIGEST_LENGTH;
+}
+
+int sm3_kdf_squeeze(SM3_KDF_CTX *ctx, u1 *out, size_t len)
+{
+	uint64_t left = (SM3_KDF_MAX_BLOCKS - ctx->blocks) * SM3_DIGEST_LENGTH + (SM3_DIGEST_LENGTH - ctx->used);
+	size_t n;
+
+	/* All or nothing, a short key is worse than none */
+	if ((uint64_t)len > left)
+	{
+		return 0;
+	}
+
+	n = SM3_DIGEST_LENGTH - ctx->used < len ? SM3_DIGEST_LENGTH - ctx->used : len;
+	memcpy(out, ctx->block + ctx->used, n);
+	ctx->used += n;
+	out += n;
+	len -= n;
+
+	while (len >= SM3_DIGEST_LENGTH)
+	{
+		sm3_kdf_block(ctx, (uint32_t)++ctx->blocks, out);
+		out += SM3_DIGEST_LENGTH;
+		len -= SM3_DIGEST_LENGTH;
+	}
+	if (len)
+	{
+		sm3_kdf_block(ctx, (uint32_t)++ctx->blocks, ctx->block);
+		memcpy(out, ctx->block, len);
+		ctx->used = len;
+	}
+
+	return 1;
+}
+
+void sm3_kdf_clean(SM3_KDF_CTX *ctx)
+{
+	memset(ctx, 0, sizeof(SM3_KDF_CTX));
+}
+
+int sm3_kdf(const u1 *z, size_t zlen, u1 *out, size_t len)
+{
+	SM3_KDF_CTX ctx;
+	int ok;
+
+	sm3_kdf_init(&ctx, z, zlen);
+	ok = sm3_kdf_squeeze(&ctx, out, len);
+	sm3_kdf_clean(&ctx);
+
+	return ok;
+}
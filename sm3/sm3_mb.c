@@ -0,0 +1,311 @@
+/**
+ * SM3 multi-buffer job manager
+ *
+ * Every SIMD lane of the backend kernel hashes its own message. A lane
+ * first compresses the whole blocks straight from the caller's buffer,
+ * then the padded tail prepared in the lane. The kernel runs until the
+ * lane closest to the end of its segment gets there, so short and long
+ * messages can share a pass and a finished lane is refilled right away.
+ */
+
+#include "include/sm3.h"
+#include "include/sm3_impl.h"
+
+static const uint32_t sm3_iv[8] =
+{
+	0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
+	0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E,
+};
+
+/* The lane starts from iv, prefix_blocks blocks already compressed into it */
+static void mb_assign(SM3_MB_MGR *mgr, size_t d, SM3_MB_JOB *job, const uint32_t iv[8], size_t prefix_blocks)
+{
+	SM3_MB_LANE *lane = &mgr->lane[d];
+	size_t full = job->len / SM3_BLOCK_SIZE;
+	size_t rem = job->len % SM3_BLOCK_SIZE;
+	uint64_t bits = ((uint64_t)job->len + (uint64_t)prefix_blocks * SM3_BLOCK_SIZE) << 3;
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+	{
+		mgr->state[i * mgr->lanes + d] = iv[i];
+	}
+
+	/* Padding: 0x80, zeros, 64-bit big-endian bit length */
+	lane->tail_blocks = rem + 9 <= SM3_BLOCK_SIZE ? 1 : 2;
+	memset(lane->tail, 0, sizeof(lane->tail));
+	if (rem)
+	{
+		memcpy(lane->tail, job->data + full * SM3_BLOCK_SIZE, rem);
+	}
+	lane->tail[rem] = 0x80;
+	for (i = 0; i < 8; i++)
+	{
+		lane->tail[lane->tail_blocks * SM3_BLOCK_SIZE - 1 - i] = (u1)(bits >> (8 * i));
+	}
+
+	lane->job = job;
+	lane->done = 0;
+	lane->in_tail = full == 0;
+	lane->data = full ? job->data : lane->tail;
+	lane->nblocks = full ? full : lane->tail_blocks;
+}
+
+/* The lane reached the end of its segment: move on to the tail or finish */
+static void mb_segment_end(SM3_MB_MGR *mgr, size_t d)
+{
+	SM3_MB_LANE *lane = &mgr->lane[d];
+	size_t i;
+
+	if (!lane->in_tail)
+	{
+		lane->in_tail = 1;
+		lane->data = lane->tail;
+		lane->nblocks = lane->tail_blocks;
+		return;
+	}
+
+	for (i = 0; i < 8; i++)
+	{
+		uint32_t w = mgr->state[i * mgr->lanes + d];
+
+		lane->job->digest[4 * i] = (u1)(w >> 24);
+		lane->job->digest[4 * i + 1] = (u1)(w >> 16);
+		lane->job->digest[4 * i + 2] = (u1)(w >> 8);
+		lane->job->digest[4 * i + 3] = (u1)w;
+	}
+	lane->done = 1;
+}
+
+/*
+ * One kernel pass over the running lanes, as many blocks as the shortest
+ * segment has left. Idle lanes read a running lane's data, their state
+ * is discarded.
+ */
+static void mb_run(SM3_MB_MGR *mgr)
+{
+	const SM3_BACKEND *backend = (const SM3_BACKEND *)mgr->backend;
+	const u1 *data[SM3_MB_MAX_LANES];
+	const u1 *any = NULL;
+	size_t n = 0, d;
+
+	for (d = 0; d < mgr->lanes; d++)
+	{
+		SM3_MB_LANE *lane = &mgr->lane[d];
+
+		if (lane->job && !lane->done && (any == NULL || lane->nblocks < n))
+		{
+			n = lane->nblocks;
+			any = lane->data;
+		}
+	}
+	if (any == NULL)
+	{
+		return;
+	}
+
+	for (d = 0; d < mgr->lanes; d++)
+	{
+		SM3_MB_LANE *lane = &mgr->lane[d];
+
+		data[d] = (lane->job && !lane->done) ? lane->data : any;
+	}
+
+	backend->mb_compress(mgr->state, data, n);
+
+	for (d = 0; d < mgr->lanes; d++)
+	{
+		SM3_MB_LANE *lane = &mgr->lane[d];
+
+		if (lane->job == NULL || lane->done)
+		{
+			continue;
+		}
+		lane->data += n * SM3_BLOCK_SIZE;
+		lane->nblocks -= n;
+		if (lane->nblocks == 0)
+		{
+			mb_segment_end(mgr, d);
+		}
+	}
+}
+
+/*
+ * Return a completed job and free its lane. Without flush, NULL as soon
+ * as a lane is free; with flush, compress until a job completes.
+ */
+static SM3_MB_JOB *mb_complete(SM3_MB_MGR *mgr, int flush)
+{
+	for (;;)
+	{
+		int free_lane = 0, running = 0;
+		size_t d;
+
+		for (d = 0; d < mgr->lanes; d++)
+		{
+			SM3_MB_LANE *lane = &mgr->lane[d];
+
+			if (lane->job && lane->done)
+			{
+				SM3_MB_JOB *job = lane->job;
+
+				lane->job = NULL;
+				memset(lane->tail, 0, sizeof(lane->tail));
+				return job;
+			}
+			free_lane |= lane->job == NULL;
+			running |= lane->job != NULL;
+		}
+
+		if ((!flush && free_lane) || !running)
+		{
+			return NULL;
+		}
+		mb_run(mgr);
+	}
+}
+
+void sm3_mb_init(SM3_MB_MGR *mgr)
+{
+	const SM3_BACKEND *backend = sm3_backend();
+
+	memset(mgr, 0, sizeof(SM3_MB_MGR));
+	mgr->backend = backend;
+	mgr->lanes = backend->mb_lanes;
+}
+
+SM3_MB_JOB *sm3_mb_submit_midstate(SM3_MB_MGR *mgr, SM3_MB_JOB *job, const uint32_t state[8], size_t prefix_blocks)
+{
+	size_t d;
+
+	/* A submit never returns with every lane taken, so one is free */
+	for (d = 0; d < mgr->lanes; d++)
+	{
+		if (mgr->lane[d].job == NULL)
+		{
+			mb_assign(mgr, d, job, state, prefix_blocks);
+			break;
+		}
+	}
+
+	return mb_complete(mgr, 0);
+}
+
+SM3_MB_JOB *sm3_mb_submit(SM3_MB_MGR *mgr, SM3_MB_JOB *job)
+{
+	return sm3_mb_submit_midstate(mgr, job, sm3_iv, 0);
+}
+
+SM3_MB_JOB *sm3_mb_flush(SM3_MB_MGR *mgr)
+{
+	return mb_complete(mgr, 1);
+}
+
+void sm3_mb(SM3_MB_JOB *jobs, size_t njobs)
+{
+	SM3_MB_MGR mgr;
+	size_t j;
+
+	sm3_mb_init(&mgr);
+	for (j = 0; j < njobs; j++)
+	{
+		sm3_mb_submit(&mgr, &jobs[j]);
+	}
+	while (sm3_mb_flush(&mgr) != NULL)
+	{
+	}
+
+	memset(&mgr, 0, sizeof(mgr));
+}
+
+/*
+ * Batch HMAC-SM3. Messages go through the manager in groups: the inner
+ * hashes of a group resume from the cached ipad states, then the outer
+ * hashes (one block each) from the opad states, all in parallel lanes.
+ */
+#define SM3_HMAC_GROUP 64
+
+static void hmac_group(const SM3_HMAC_KEY *const *keys, const u1 *const *msgs, const size_t *lens,
+	size_t n, u1 macs[][SM3_HMAC_SIZE])
+{
+	SM3_MB_JOB jobs[SM3_HMAC_GROUP];
+	u1 inner[SM3_HMAC_GROUP][SM3_DIGEST_LENGTH];
+	SM3_MB_MGR mgr;
+	size_t i;
+
+	sm3_mb_init(&mgr);
+	for (i = 0; i < n; i++)
+	{
+		jobs[i].data = msgs[i];
+		jobs[i].len = lens[i];
+		sm3_mb_submit_midstate(&mgr, &jobs[i], keys[i]->ipad_digest, 1);
+	}
+	while (sm3_mb_flush(&mgr) != NULL)
+	{
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		memcpy(inner[i], jobs[i].digest, SM3_DIGEST_LENGTH);
+		jobs[i].data = inner[i];
+		jobs[i].len = SM3_DIGEST_LENGTH;
+		sm3_mb_submit_midstate(&mgr, &jobs[i], keys[i]->opad_digest, 1);
+	}
+	while (sm3_mb_flush(&mgr) != NULL)
+	{
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		memcpy(macs[i], jobs[i].digest, SM3_HMAC_SIZE);
+	}
+
+	memset(inner, 0, sizeof(inner));
+	memset(jobs, 0, n * sizeof(SM3_MB_JOB));
+	memset(&mgr, 0, sizeof(mgr));
+}
+
+void sm3_hmac_batch(const SM3_HMAC_KEY *const *keys, const u1 *const *msgs, const size_t *lens,
+	size_t n, u1 *macs)
+{
+	size_t i, m;
+
+	for (i = 0; i < n; i += m)
+	{
+		m = n - i < SM3_HMAC_GROUP ? n - i : SM3_HMAC_GROUP;
+		hmac_group(keys + i, msgs + i, lens + i, m, (u1 (*)[SM3_HMAC_SIZE])(macs + i * SM3_HMAC_SIZE));
+	}
+}
+
+int sm3_hmac_verify_batch(const SM3_HMAC_KEY *const *keys, const u1 *const *msgs, const size_t *lens,
+	const u1 *tags, size_t n, u1 *valid)
+{
+	u1 macs[SM3_HMAC_GROUP][SM3_HMAC_SIZE];
+	uint32_t all = 1;
+	size_t i, j, m, k;
+
+	memset(valid, 0, (n + 7) / 8);
+	for (i = 0; i < n; i += m)
+	{
+		m = n - i < SM3_HMAC_GROUP ? n - i : SM3_HMAC_GROUP;
+		hmac_group(keys + i, msgs + i, lens + i, m, macs);
+
+		/* No branch or early exit on the tag bytes */
+		for (j = 0; j < m; j++)
+		{
+			const u1 *tag = tags + (i + j) * SM3_HMAC_SIZE;
+			uint32_t diff = 0, ok;
+
+			for (k = 0; k < SM3_HMAC_SIZE; k++)
+			{
+				diff |= macs[j][k] ^ tag[k];
+			}
+			ok = (diff - 1) >> 31;
+			valid[(i + j) / 8] |= (u1)(ok << ((i + j) % 8));
+			all &= ok;
+		}
+	}
+
+	memset(macs, 0, sizeof(macs));
+	return (int)all;
+}
@@ -0,0 +1,226 @@
+/**
+ * SM3 tree mode, version 1
+ *
+ * A plain SM3 chain cannot be split across cores, so the input is cut
+ * into fixed-size chunks whose hashes (the leaves) are computed by a
+ * pool of worker threads, and a root hash is taken over the leaves:
+ *
+ *   leaf_i = SM3(LEAF || chunk_i)
+ *   root   = SM3(ROOT || leaf_0 || leaf_1 || ... || leaf_n-1)
+ *
+ *   LEAF   = 0x00 || version || 62 zero bytes
+ *   ROOT   = 0x01 || version || BE64(chunk_size) || BE64(len) || 46 zero bytes
+ *
+ * n = ceil(len / chunk_size), an empty input has one empty chunk. The
+ * prefixes are whole SM3 blocks: the state after LEAF is computed once
+ * and each leaf continues from it straight on its chunk. The leading
+ * byte separates leaves from the root and ROOT binds the parameters, so
+ * a digest only matches for the same version, chunk size and length.
+ */
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#define _POSIX_C_SOURCE 200809L
+#define SM3_TREE_PTHREAD 1
+#endif
+
+#include "include/sm3.h"
+
+#ifdef SM3_TREE_PTHREAD
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* Upper bound for the worker count, whatever the caller asks for */
+#define SM3_TREE_MAX_THREADS 256
+
+typedef struct {
+	const u1 *data;
+	size_t len;
+	size_t chunk_size;
+	size_t nchunks;
+	SM3_CTX leaf_ctx;               /* state after the LEAF block */
+	u1 *leaves;                     /* nchunks * SM3_DIGEST_LENGTH */
+#ifdef SM3_TREE_PTHREAD
+	atomic_size_t next;             /* next chunk to hash */
+#else
+	size_t next;
+#endif
+} SM3_TREE_JOB;
+
+static void sm3_tree_leaf(const SM3_TREE_JOB *job, size_t i)
+{
+	size_t off = i * job->chunk_size;
+	size_t clen = job->len - off < job->chunk_size ? job->len - off : job->chunk_size;
+	SM3_CTX ctx = job->leaf_ctx;
+
+	if (clen)
+	{
+		sm3_update(&ctx, job->data + off, clen);
+	}
+	sm3_final(&ctx, job->leaves + i * SM3_DIGEST_LENGTH);
+}
+
+/* Takes chunks until none is left, run by every worker and the caller */
+static void *sm3_tree_worker(void *arg)
+{
+	SM3_TREE_JOB *job = (SM3_TREE_JOB *)arg;
+
+	for (;;)
+	{
+#ifdef SM3_TREE_PTHREAD
+		size_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+#else
+		size_t i = job->next++;
+#endif
+
+		if (i >= job->nchunks)
+		{
+			break;
+		}
+		sm3_tree_leaf(job, i);
+	}
+
+	return NULL;
+}
+
+static void put_be64(u1 *p, uint64_t v)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		p[i] = (u1)(v >> (56 - 8 * i));
+	}
+}
+
+int sm3_tree(const u1 *data, size_t len, size_t chunk_size, unsigned int threads, u1 digest[SM3_DIGEST_LENGTH])
+{
+	u1 prefix[SM3_BLOCK_SIZE];
+	SM3_TREE_JOB job;
+	SM3_CTX ctx;
+
+	if (chunk_size == 0 || chunk_size % SM3_BLOCK_SIZE != 0)
+	{
+		return 0;
+	}
+
+	job.data = data;
+	job.len = len;
+	job.chunk_size = chunk_size;
+	job.nchunks = len ? (len - 1) / chunk_size + 1 : 1;
+	job.leaves = (u1 *)malloc(job.nchunks * SM3_DIGEST_LENGTH);
+	if (job.leaves == NULL)
+	{
+		return 0;
+	}
+#ifdef SM3_TREE_PTHREAD
+	atomic_init(&job.next, 0);
+#else
+	job.next = 0;
+#endif
+
+	memset(prefix, 0, sizeof(prefix));
+	prefix[1] = SM3_TREE_VERSION;
+	sm3_init(&job.leaf_ctx);
+	sm3_update(&job.leaf_ctx, prefix, SM3_BLOCK_SIZE);
+
+#ifdef SM3_TREE_PTHREAD
+	{
+		pthread_t tid[SM3_TREE_MAX_THREADS];
+		size_t nthreads = threads ? threads : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+		size_t started = 0, t;
+
+		if (nthreads > job.nchunks)
+		{
+			nthreads = job.nchunks;
+		}
+		if (nthreads > SM3_TREE_MAX_THREADS)
+		{
+			nthreads = SM3_TREE_MAX_THREADS;
+		}
+		/* The caller is a worker too; a thread that fails to start leaves its share to the others */
+		while (started + 1 < nthreads && pthread_create(&tid[started], NULL, sm3_tree_worker, &job) == 0)
+		{
+			started++;
+		}
+		sm3_tree_worker(&job);
+		for (t = 0; t < started; t++)
+		{
+			pthread_join(tid[t], NULL);
+		}
+	}
+#else
+	(void)threads;
+	sm3_tree_worker(&job);
+#endif
+
+	memset(prefix, 0, sizeof(prefix));
+	prefix[0] = 0x01;
+	prefix[1] = SM3_TREE_VERSION;
+	put_be64(prefix + 2, (uint64_t)chunk_size);
+	put_be64(prefix + 10, (uint64_t)len);
+	sm3_init(&ctx);
+	sm3_update(&ctx, prefix, SM3_BLOCK_SIZE);
+	sm3_update(&ctx, job.leaves, job.nchunks * SM3_DIGEST_LENGTH);
+	sm3_final(&ctx, digest);
+
+	free(job.leaves);
+	memset(&job, 0, sizeof(job));
+	memset(&ctx, 0, sizeof(ctx));
+	return 1;
+}
+
+#ifdef SM3_TREE_PTHREAD
+int sm3_tree_file(const char *path, size_t chunk_size, unsigned int threads, u1 digest[SM3_DIGEST_LENGTH])
+{
+	struct stat st;
+	u1 *map = NULL;
+	size_t len;
+	int fd, ok = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > SIZE_MAX)
+	{
+		close(fd);
+		return 0;
+	}
+
+	len = (size_t)st.st_size;
+	if (len)
+	{
+		map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return 0;
+	}
+
+	/* Every worker reads its chunks front to back */
+	if (len)
+	{
+		posix_madvise(map, len, POSIX_MADV_SEQUENTIAL);
+	}
+	ok = sm3_tree(map, len, chunk_size, threads, digest);
+	if (len)
+	{
+		munmap(map, len);
+	}
+
+	return ok;
+}
+#else
+int sm3_tree_file(const char *path, size_t chunk_size, unsigned int threads, u1 digest[SM3_DIGEST_LENGTH])
+{
+	(void)path; (void)chunk_size; (void)threads; (void)digest;
+	return 0;
+}
+#endif
@@ -0,0 +1,357 @@
+/**
+ * SM3 compression with SSSE3 / AVX2 / AVX-512 (x86-64)
+ *
+ * Single stream: the message schedule is expanded four words at a time in
+ * SSE registers, one group ahead of the scalar rounds that consume it.
+ *
+ * Multi-buffer: each 32-bit element of a vector belongs to a different
+ * message, so the 64 rounds run unchanged on 8 (AVX2) or 16 (AVX-512)
+ * messages at once. Message blocks are loaded row by row and transposed
+ * 8x8 in registers.
+ */
+
+#include "include/sm3_impl.h"
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+#define SM3_SSSE3_TARGET  __attribute__((target("ssse3")))
+#define SM3_AVX2_TARGET   __attribute__((target("avx2")))
+#define SM3_AVX512_TARGET __attribute__((target("avx2,avx512f")))
+
+/* T_j rotated left by j, as in the scalar Ti table */
+static inline uint32_t sm3_t(int j)
+{
+	uint32_t t = j < 16 ? 0x79CC4519 : 0x7A879D8A;
+	int n = j % 32;
+
+	return n ? (t << n) | (t >> (32 - n)) : t;
+}
+
+/* ============================================================
+ * SSSE3, single stream
+ * ============================================================ */
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define ROL128(x, n) _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+#define XOR128(a, b) _mm_xor_si128((a), (b))
+#define P1_128(x) XOR128(XOR128((x), ROL128((x), 15)), ROL128((x), 23))
+
+/*
+ * X0..X3 hold W[j..j+15]; X0 becomes W[j+16..j+19]. The last lane needs
+ * W[j+16] in place of W[j+13], it is added afterwards as P1 is linear.
+ */
+#define SM3_SSE_EXPAND(X0, X1, X2, X3)                                         \
+	do {                                                                       \
+		__m128i w3 = _mm_srli_si128(X3, 4);                                    \
+		__m128i w6 = _mm_alignr_epi8(X3, X2, 8);                               \
+		__m128i w9 = _mm_alignr_epi8(X2, X1, 12);                              \
+		__m128i w13 = _mm_alignr_epi8(X1, X0, 12);                             \
+		__m128i x = XOR128(XOR128(X0, w9), ROL128(w3, 15));                    \
+		x = XOR128(XOR128(P1_128(x), ROL128(w13, 7)), w6);                     \
+		w3 = ROL128(_mm_slli_si128(x, 12), 15);                                \
+		X0 = XOR128(x, P1_128(w3));                                            \
+	} while (0)
+
+#define FF0(x, y, z) ((x) ^ (y) ^ (z))
+#define FF1(x, y, z) (((x) & (y)) | (((x) | (y)) & (z)))
+#define GG1(x, y, z) ((((y) ^ (z)) & (x)) ^ (z))
+#define P0(x) ((x) ^ ROTL((x), 9) ^ ROTL((x), 17))
+
+#define SM3_SSE_ROUND(A, B, C, D, E, F, G, H, j, FF, GG)                       \
+	do {                                                                       \
+		uint32_t a12 = ROTL(A, 12);                                            \
+		uint32_t ss1 = ROTL(a12 + E + sm3_t(j), 7);                            \
+		D = FF(A, B, C) + D + (ss1 ^ a12) + wp[(j) & 3];                       \
+		H = GG(E, F, G) + H + ss1 + w[(j) & 3];                                \
+		H = P0(H);                                                             \
+		B = ROTL(B, 9);                                                        \
+		F = ROTL(F, 19);                                                       \
+	} while (0)
+
+/* Rounds j..j+3, expanding W[j+16..j+19] alongside */
+#define SM3_SSE_STEP(j, X0, X1, X2, X3, FF, GG)                                \
+	do {                                                                       \
+		_mm_store_si128((__m128i *)w, X0);                                     \
+		_mm_store_si128((__m128i *)wp, XOR128(X0, X1));                        \
+		if ((j) < 52)                                                          \
+		{                                                                      \
+			SM3_SSE_EXPAND(X0, X1, X2, X3);                                    \
+		}                                                                      \
+		SM3_SSE_ROUND(A, B, C, D, E, F, G, H, (j), FF, GG);                    \
+		SM3_SSE_ROUND(D, A, B, C, H, E, F, G, (j) + 1, FF, GG);                \
+		SM3_SSE_ROUND(C, D, A, B, G, H, E, F, (j) + 2, FF, GG);                \
+		SM3_SSE_ROUND(B, C, D, A, F, G, H, E, (j) + 3, FF, GG);                \
+	} while (0)
+
+#define SM3_SSE_STEP16(j, FF, GG)                                              \
+	do {                                                                       \
+		SM3_SSE_STEP((j), X0, X1, X2, X3, FF, GG);                             \
+		SM3_SSE_STEP((j) + 4, X1, X2, X3, X0, FF, GG);                         \
+		SM3_SSE_STEP((j) + 8, X2, X3, X0, X1, FF, GG);                         \
+		SM3_SSE_STEP((j) + 12, X3, X0, X1, X2, FF, GG);                        \
+	} while (0)
+
+SM3_SSSE3_TARGET
+void sm3_ssse3_compress(u4 digest[8], const u1 *block, size_t nblocks)
+{
+	const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+	uint32_t w[4] __attribute__((aligned(16)));
+	uint32_t wp[4] __attribute__((aligned(16)));
+	uint32_t A, B, C, D, E, F, G, H;
+	__m128i X0, X1, X2, X3;
+
+	A = digest[0]; B = digest[1]; C = digest[2]; D = digest[3];
+	E = digest[4]; F = digest[5]; G = digest[6]; H = digest[7];
+
+	while (nblocks--)
+	{
+		X0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)block), bswap);
+		X1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 16)), bswap);
+		X2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 32)), bswap);
+		X3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 48)), bswap);
+		block += SM3_BLOCK_SIZE;
+
+		SM3_SSE_STEP16(0, FF0, FF0);
+		SM3_SSE_STEP16(16, FF1, GG1);
+		SM3_SSE_STEP16(32, FF1, GG1);
+		SM3_SSE_STEP16(48, FF1, GG1);
+
+		digest[0] = A = digest[0] ^ A;
+		digest[1] = B = digest[1] ^ B;
+		digest[2] = C = digest[2] ^ C;
+		digest[3] = D = digest[3] ^ D;
+		digest[4] = E = digest[4] ^ E;
+		digest[5] = F = digest[5] ^ F;
+		digest[6] = G = digest[6] ^ G;
+		digest[7] = H = digest[7] ^ H;
+	}
+}
+
+/*
+ * Words 8*half .. 8*half+7 of one block of the 8 lanes data[0..7] + off,
+ * byte-swapped and transposed: w[j] holds word j of every lane
+ */
+SM3_AVX2_TARGET
+static inline void sm3_avx2_load8(__m256i w[8], const u1 *const *data, size_t off)
+{
+	const __m256i bswap = _mm256_broadcastsi128_si256(
+		_mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+	__m256i r[8], t[8], u[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		r[i] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data[i] + off)), bswap);
+	}
+	for (i = 0; i < 8; i += 2)
+	{
+		t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+		t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+	}
+	for (i = 0; i < 8; i += 4)
+	{
+		u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+		u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+		u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+		u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+	}
+	for (i = 0; i < 4; i++)
+	{
+		w[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+		w[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+	}
+}
+
+/* ============================================================
+ * AVX2, 8 lanes
+ * ============================================================ */
+
+#define ROL256(x, n) _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define XOR256(a, b) _mm256_xor_si256((a), (b))
+#define ADD256(a, b) _mm256_add_epi32((a), (b))
+
+#define P0_256(x) XOR256(XOR256((x), ROL256((x), 9)), ROL256((x), 17))
+#define P1_256(x) XOR256(XOR256((x), ROL256((x), 15)), ROL256((x), 23))
+
+#define FF0_256(x, y, z) XOR256(XOR256((x), (y)), (z))
+#define FF1_256(x, y, z) _mm256_or_si256(_mm256_and_si256((x), (y)), \
+	_mm256_and_si256(_mm256_or_si256((x), (y)), (z)))
+#define GG1_256(x, y, z) _mm256_or_si256(_mm256_and_si256((x), (y)), _mm256_andnot_si256((x), (z)))
+
+/* One round, D and H take the new A and E values, see sm3.c */
+#define SM3_AVX2_ROUND(A, B, C, D, E, F, G, H, j, FF, GG)                      \
+	do {                                                                       \
+		__m256i a12 = ROL256(A, 12);                                           \
+		__m256i ss1 = ADD256(ADD256(a12, E), _mm256_set1_epi32((int)sm3_t(j))); \
+		ss1 = ROL256(ss1, 7);                                                  \
+		D = ADD256(ADD256(FF(A, B, C), D), ADD256(XOR256(ss1, a12), XOR256(W[j], W[(j) + 4]))); \
+		H = ADD256(ADD256(GG(E, F, G), H), ADD256(ss1, W[j]));                 \
+		H = P0_256(H);                                                         \
+		B = ROL256(B, 9);                                                      \
+		F = ROL256(F, 19);                                                     \
+	} while (0)
+
+#define SM3_AVX2_ROUNDS4(j, FF, GG)                                            \
+	do {                                                                       \
+		SM3_AVX2_ROUND(A, B, C, D, E, F, G, H, (j), FF, GG);                   \
+		SM3_AVX2_ROUND(D, A, B, C, H, E, F, G, (j) + 1, FF, GG);               \
+		SM3_AVX2_ROUND(C, D, A, B, G, H, E, F, (j) + 2, FF, GG);               \
+		SM3_AVX2_ROUND(B, C, D, A, F, G, H, E, (j) + 3, FF, GG);               \
+	} while (0)
+
+SM3_AVX2_TARGET
+void sm3_avx2_mb_compress(uint32_t *state, const u1 *const *data, size_t nblocks)
+{
+	__m256i A, B, C, D, E, F, G, H;
+	__m256i W[68];
+	size_t off;
+	int j;
+
+	A = _mm256_loadu_si256((const __m256i *)(state + 0 * 8));
+	B = _mm256_loadu_si256((const __m256i *)(state + 1 * 8));
+	C = _mm256_loadu_si256((const __m256i *)(state + 2 * 8));
+	D = _mm256_loadu_si256((const __m256i *)(state + 3 * 8));
+	E = _mm256_loadu_si256((const __m256i *)(state + 4 * 8));
+	F = _mm256_loadu_si256((const __m256i *)(state + 5 * 8));
+	G = _mm256_loadu_si256((const __m256i *)(state + 6 * 8));
+	H = _mm256_loadu_si256((const __m256i *)(state + 7 * 8));
+
+	for (off = 0; off < nblocks * SM3_BLOCK_SIZE; off += SM3_BLOCK_SIZE)
+	{
+		__m256i A0 = A, B0 = B, C0 = C, D0 = D, E0 = E, F0 = F, G0 = G, H0 = H;
+
+		sm3_avx2_load8(W, data, off);
+		sm3_avx2_load8(W + 8, data, off + 32);
+		for (j = 16; j < 68; j++)
+		{
+			__m256i x = XOR256(XOR256(W[j - 16], W[j - 9]), ROL256(W[j - 3], 15));
+
+			W[j] = XOR256(XOR256(P1_256(x), ROL256(W[j - 13], 7)), W[j - 6]);
+		}
+
+		for (j = 0; j < 16; j += 4)
+		{
+			SM3_AVX2_ROUNDS4(j, FF0_256, FF0_256);
+		}
+		for (j = 16; j < 64; j += 4)
+		{
+			SM3_AVX2_ROUNDS4(j, FF1_256, GG1_256);
+		}
+
+		A = XOR256(A, A0); B = XOR256(B, B0); C = XOR256(C, C0); D = XOR256(D, D0);
+		E = XOR256(E, E0); F = XOR256(F, F0); G = XOR256(G, G0); H = XOR256(H, H0);
+	}
+
+	_mm256_storeu_si256((__m256i *)(state + 0 * 8), A);
+	_mm256_storeu_si256((__m256i *)(state + 1 * 8), B);
+	_mm256_storeu_si256((__m256i *)(state + 2 * 8), C);
+	_mm256_storeu_si256((__m256i *)(state + 3 * 8), D);
+	_mm256_storeu_si256((__m256i *)(state + 4 * 8), E);
+	_mm256_storeu_si256((__m256i *)(state + 5 * 8), F);
+	_mm256_storeu_si256((__m256i *)(state + 6 * 8), G);
+	_mm256_storeu_si256((__m256i *)(state + 7 * 8), H);
+}
+
+/* ============================================================
+ * AVX-512, 16 lanes
+ * ============================================================ */
+
+#define ROL512(x, n) _mm512_rol_epi32((x), (n))
+#define XOR512(a, b) _mm512_xor_si512((a), (b))
+#define ADD512(a, b) _mm512_add_epi32((a), (b))
+
+#define P0_512(x) _mm512_ternarylogic_epi32((x), ROL512((x), 9), ROL512((x), 17), 0x96)
+#define P1_512(x) _mm512_ternarylogic_epi32((x), ROL512((x), 15), ROL512((x), 23), 0x96)
+
+/* x ^ y ^ z, majority, and x ? y : z */
+#define FF0_512(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0x96)
+#define FF1_512(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0xE8)
+#define GG1_512(x, y, z) _mm512_ternarylogic_epi32((x), (y), (z), 0xCA)
+
+#define SM3_AVX512_ROUND(A, B, C, D, E, F, G, H, j, FF, GG)                    \
+	do {                                                                       \
+		__m512i a12 = ROL512(A, 12);                                           \
+		__m512i ss1 = ADD512(ADD512(a12, E), _mm512_set1_epi32((int)sm3_t(j))); \
+		ss1 = ROL512(ss1, 7);                                                  \
+		D = ADD512(ADD512(FF(A, B, C), D), ADD512(XOR512(ss1, a12), XOR512(W[j], W[(j) + 4]))); \
+		H = ADD512(ADD512(GG(E, F, G), H), ADD512(ss1, W[j]));                 \
+		H = P0_512(H);                                                         \
+		B = ROL512(B, 9);                                                      \
+		F = ROL512(F, 19);                                                     \
+	} while (0)
+
+#define SM3_AVX512_ROUNDS4(j, FF, GG)                                          \
+	do {                                                                       \
+		SM3_AVX512_ROUND(A, B, C, D, E, F, G, H, (j), FF, GG);                 \
+		SM3_AVX512_ROUND(D, A, B, C, H, E, F, G, (j) + 1, FF, GG);             \
+		SM3_AVX512_ROUND(C, D, A, B, G, H, E, F, (j) + 2, FF, GG);             \
+		SM3_AVX512_ROUND(B, C, D, A, F, G, H, E, (j) + 3, FF, GG);             \
+	} while (0)
+
+SM3_AVX512_TARGET
+void sm3_avx512_mb_compress(uint32_t *state, const u1 *const *data, size_t nblocks)
+{
+	__m512i A, B, C, D, E, F, G, H;
+	__m512i W[68];
+	size_t off;
+	int j;
+
+	A = _mm512_loadu_si512(state + 0 * 16);
+	B = _mm512_loadu_si512(state + 1 * 16);
+	C = _mm512_loadu_si512(state + 2 * 16);
+	D = _mm512_loadu_si512(state + 3 * 16);
+	E = _mm512_loadu_si512(state + 4 * 16);
+	F = _mm512_loadu_si512(state + 5 * 16);
+	G = _mm512_loadu_si512(state + 6 * 16);
+	H = _mm512_loadu_si512(state + 7 * 16);
+
+	for (off = 0; off < nblocks * SM3_BLOCK_SIZE; off += SM3_BLOCK_SIZE)
+	{
+		__m512i A0 = A, B0 = B, C0 = C, D0 = D, E0 = E, F0 = F, G0 = G, H0 = H;
+		__m256i lo[8], hi[8];
+		int half;
+
+		/* Lanes 0-7 in the low and lanes 8-15 in the high 256 bits */
+		for (half = 0; half < 2; half++)
+		{
+			sm3_avx2_load8(lo, data, off + 32 * half);
+			sm3_avx2_load8(hi, data + 8, off + 32 * half);
+			for (j = 0; j < 8; j++)
+			{
+				W[8 * half + j] = _mm512_inserti64x4(_mm512_castsi256_si512(lo[j]), hi[j], 1);
+			}
+		}
+		for (j = 16; j < 68; j++)
+		{
+			__m512i x = _mm512_ternarylogic_epi32(W[j - 16], W[j - 9], ROL512(W[j - 3], 15), 0x96);
+
+			W[j] = _mm512_ternarylogic_epi32(P1_512(x), ROL512(W[j - 13], 7), W[j - 6], 0x96);
+		}
+
+		for (j = 0; j < 16; j += 4)
+		{
+			SM3_AVX512_ROUNDS4(j, FF0_512, FF0_512);
+		}
+		for (j = 16; j < 64; j += 4)
+		{
+			SM3_AVX512_ROUNDS4(j, FF1_512, GG1_512);
+		}
+
+		A = XOR512(A, A0); B = XOR512(B, B0); C = XOR512(C, C0); D = XOR512(D, D0);
+		E = XOR512(E, E0); F = XOR512(F, F0); G = XOR512(G, G0); H = XOR512(H, H0);
+	}
+
+	_mm512_storeu_si512(state + 0 * 16, A);
+	_mm512_storeu_si512(state + 1 * 16, B);
+	_mm512_storeu_si512(state + 2 * 16, C);
+	_mm512_storeu_si512(state + 3 * 16, D);
+	_mm512_storeu_si512(state + 4 * 16, E);
+	_mm512_storeu_si512(state + 5 * 16, F);
+	_mm512_storeu_si512(state + 6 * 16, G);
+	_mm512_storeu_si512(state + 7 * 16, H);
+}
+
+#endif /* YCRYPT_HAVE_X86_SIMD */
@@ -2,6 +2,8 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "../include/sm3.h"
 #include "../include/utils.h"
 
@@ -233,6 +235,711 @@ void sm3_hmac_self_check() {
     }
 }
 
+void sm3_hmac_key_self_check()
+{
+	puts("======== Test SM3-HMAC with a cached key against sm3_hmac ========");
+
+	uint8_t key[150], msg[300], expect[32], mac[32];
+	SM3_HMAC_KEY hkey;
+	SM3_HMAC_CTX ctx;
+	size_t key_len, i;
+	int ok = 1;
+
+	for (i = 0; i < sizeof(key); i++)
+	{
+		key[i] = (uint8_t)rand();
+	}
+	for (i = 0; i < sizeof(msg); i++)
+	{
+		msg[i] = (uint8_t)rand();
+	}
+
+	/* Key lengths around the block size, where the key gets hashed */
+	for (key_len = 0; key_len < sizeof(key) && ok; key_len += 7)
+	{
+		sm3_hmac_key_init(&hkey, key, key_len);
+		sm3_hmac_init_key(&ctx, &hkey);
+		for (i = 0; i < sizeof(msg); i += 37)
+		{
+			sm3_hmac(msg, i, key, key_len, expect);
+
+			sm3_hmac_with_key(&hkey, msg, i, mac);
+			ok &= memcmp(mac, expect, 32) == 0;
+
+			/* One context reused for every message */
+			sm3_hmac_reset(&ctx);
+			sm3_hmac_update(&ctx, msg, i / 2);
+			sm3_hmac_update(&ctx, msg + i / 2, i - i / 2);
+			sm3_hmac_final(&ctx, mac);
+			ok &= memcmp(mac, expect, 32) == 0;
+		}
+	}
+	sm3_hmac_key_clean(&hkey);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3-HMAC cached key test pass!");
+	}
+	else
+	{
+		puts("[ERROR] SM3-HMAC cached key mismatch");
+	}
+}
+
+void sm3_export_self_check()
+{
+	puts("======== Test SM3 state export and import ========");
+
+	uint8_t msg[300], expect[32], dgst[32], state[SM3_STATE_SIZE], bad[SM3_STATE_SIZE];
+	SM3_CTX ctx, resumed;
+	size_t len, cut;
+	int ok = 1;
+
+	for (len = 0; len < sizeof(msg); len++)
+	{
+		msg[len] = (uint8_t)rand();
+	}
+
+	/* Checkpoint at every offset, resume in a context that never saw the head */
+	for (len = 0; len < sizeof(msg) && ok; len += 29)
+	{
+		sm3(msg, len, expect);
+		for (cut = 0; cut <= len; cut++)
+		{
+			sm3_init(&ctx);
+			sm3_update(&ctx, msg, cut);
+			sm3_export(&ctx, state);
+
+			memset(&resumed, 0xA5, sizeof(resumed));
+			ok &= sm3_import(&resumed, state);
+			sm3_update(&resumed, msg + cut, len - cut);
+			sm3_final(&resumed, dgst);
+			ok &= memcmp(dgst, expect, 32) == 0;
+		}
+	}
+
+	/* The layout is fixed: 100 bytes leave one block compressed and 36 buffered */
+	sm3_init(&ctx);
+	sm3_update(&ctx, msg, 100);
+	sm3_export(&ctx, state);
+	ok &= memcmp(state, "SM3S\x01\x24\x00\x00", 8) == 0;
+	ok &= state[8] == (uint8_t)(ctx.digest[0] >> 24) && state[39] == (uint8_t)ctx.digest[7];
+	ok &= memcmp(state + 40, "\0\0\0\0\0\0\0\x01", 8) == 0;
+	ok &= memcmp(state + 48, msg + 64, 36) == 0 && state[SM3_STATE_SIZE - 1] == 0;
+
+	/* Malformed states are refused and leave the context alone */
+	resumed = ctx;
+	memcpy(bad, state, sizeof(bad));
+	bad[0] ^= 1;
+	ok &= sm3_import(&resumed, bad) == 0;
+	memcpy(bad, state, sizeof(bad));
+	bad[4] = 2;
+	ok &= sm3_import(&resumed, bad) == 0;
+	memcpy(bad, state, sizeof(bad));
+	bad[5] = SM3_BLOCK_SIZE;
+	ok &= sm3_import(&resumed, bad) == 0;
+	memcpy(bad, state, sizeof(bad));
+	bad[40] = 0x80;
+	ok &= sm3_import(&resumed, bad) == 0;
+	memcpy(bad, state, sizeof(bad));
+	bad[SM3_STATE_SIZE - 1] = 1;
+	ok &= sm3_import(&resumed, bad) == 0;
+	ok &= memcmp(&resumed, &ctx, sizeof(ctx)) == 0;
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 state export test pass!");
+	}
+	else
+	{
+		puts("[ERROR] SM3 state export mismatch");
+	}
+}
+
+void sm3_kdf_self_check()
+{
+	puts("======== Test SM3 KDF ========");
+
+	/* Z = 00 01 .. 45, 40 bytes of output; cross-checked with OpenSSL's SM3 */
+	static const uint8_t kat[40] = {
+		0xCD, 0x72, 0x42, 0x31, 0x5C, 0xDD, 0x35, 0xB5, 0x54, 0xCA, 0x64, 0xCE, 0xD7, 0x88, 0x25, 0xA0,
+		0xE2, 0xD8, 0x90, 0x5D, 0xD4, 0x4F, 0xE1, 0xDC, 0x1F, 0x2A, 0x7A, 0x46, 0xC8, 0x3E, 0x45, 0x9F,
+		0xB4, 0x97, 0xA2, 0x8D, 0xFF, 0xEA, 0xAF, 0x7C,
+	};
+	enum { KDF_OUT = 5000 };
+	uint8_t z[200], zc[204], *expect = malloc(KDF_OUT), *out = malloc(KDF_OUT);
+	SM3_KDF_CTX ctx;
+	size_t zlen, i, pos, step;
+	int ok = 1;
+
+	for (i = 0; i < sizeof(z); i++)
+	{
+		z[i] = (uint8_t)i;
+	}
+	ok &= sm3_kdf(z, 70, out, sizeof(kat)) == 1;
+	ok &= memcmp(out, kat, sizeof(kat)) == 0;
+
+	/* Against SM3(Z || ct) block by block, squeezed in uneven pieces */
+	for (zlen = 0; zlen < sizeof(z) && ok; zlen += 23)
+	{
+		memcpy(zc, z, zlen);
+		for (i = 0; i * 32 < KDF_OUT; i++)
+		{
+			uint8_t block[32];
+
+			zc[zlen] = 0;
+			zc[zlen + 1] = (uint8_t)((i + 1) >> 16);
+			zc[zlen + 2] = (uint8_t)((i + 1) >> 8);
+			zc[zlen + 3] = (uint8_t)(i + 1);
+			sm3(zc, zlen + 4, block);
+			memcpy(expect + 32 * i, block, KDF_OUT - 32 * i < 32 ? KDF_OUT - 32 * i : 32);
+		}
+
+		ok &= sm3_kdf(z, zlen, out, KDF_OUT) == 1;
+		ok &= memcmp(out, expect, KDF_OUT) == 0;
+
+		memset(out, 0, KDF_OUT);
+		sm3_kdf_init(&ctx, z, zlen);
+		for (pos = 0, step = 0; pos < KDF_OUT; pos += step)
+		{
+			step = (step * 7 + 5) % 97;
+			step = step < KDF_OUT - pos ? step : KDF_OUT - pos;
+			ok &= sm3_kdf_squeeze(&ctx, out + pos, step);
+		}
+		ok &= memcmp(out, expect, KDF_OUT) == 0;
+	}
+
+	/* The counter ends at 2^32 - 1, a request past it gives nothing */
+	sm3_kdf_init(&ctx, z, 70);
+	ctx.blocks = 0xFFFFFFFEULL;
+	memset(out, 0, 64);
+	ok &= sm3_kdf_squeeze(&ctx, out, 33) == 0;
+	ok &= out[0] == 0 && ctx.blocks == 0xFFFFFFFEULL;
+	ok &= sm3_kdf_squeeze(&ctx, out, 20) == 1;
+	ok &= sm3_kdf_squeeze(&ctx, out + 20, 12) == 1;
+	ok &= sm3_kdf_squeeze(&ctx, out + 32, 1) == 0;
+	ok &= sm3_kdf_squeeze(&ctx, out + 32, 0) == 1;
+	memcpy(zc, z, 70);
+	memcpy(zc + 70, "\xFF\xFF\xFF\xFF", 4);
+	sm3(zc, 74, expect);
+	ok &= memcmp(out, expect, 32) == 0;
+	sm3_kdf_clean(&ctx);
+
+	free(expect);
+	free(out);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 KDF test pass!");
+	}
+	else
+	{
+		puts("[ERROR] SM3 KDF mismatch");
+	}
+}
+
+void sm3_drbg_self_check()
+{
+	puts("======== Test SM3 Hash_DRBG ========");
+
+	/*
+	 * Entropy 00..1F, nonce 20..2F, no personalization: the second request
+	 * with additional input "abc", then one after a reseed with 30..4F.
+	 * From an independent SP 800-90A Hash_DRBG model over OpenSSL's SM3.
+	 */
+	static const uint8_t kat_add[40] = {
+		0xF0, 0x0C, 0x12, 0xE5, 0xC3, 0x3E, 0x76, 0xE0, 0xDA, 0xAD, 0x0B, 0x50, 0xB7, 0xCF, 0xC6, 0x9B,
+		0xD7, 0xE6, 0xB6, 0x11, 0x2C, 0x78, 0xBB, 0x27, 0x19, 0x3D, 0x2F, 0x21, 0x15, 0xC8, 0xAA, 0x8E,
+		0x82, 0xD3, 0x00, 0x49, 0xAB, 0xAE, 0x9A, 0xF2,
+	};
+	static const uint8_t kat_reseed[64] = {
+		0x78, 0xA3, 0x21, 0xB4, 0xD8, 0x81, 0x05, 0x65, 0xD0, 0xAE, 0x7F, 0x2A, 0x41, 0xBE, 0x3E, 0x11,
+		0xE5, 0x21, 0xCE, 0x09, 0xA4, 0x32, 0xA1, 0x75, 0x76, 0xA5, 0xD9, 0xA4, 0x7F, 0xF7, 0x1C, 0x5F,
+		0x13, 0x82, 0x8A, 0x9E, 0x8F, 0xCF, 0x1F, 0x6E, 0x30, 0xEA, 0xE9, 0x9C, 0xE3, 0x4E, 0xD6, 0xF8,
+		0x40, 0x79, 0x09, 0xC7, 0x09, 0x17, 0x9F, 0xC5, 0xB1, 0x0F, 0x22, 0x38, 0xD0, 0x7E, 0x85, 0xCD,
+	};
+	const SM3_IMPL impls[] = { SM3_IMPL_PORTABLE, SM3_IMPL_AVX2, SM3_IMPL_AVX512 };
+	uint8_t seed[80], out[64], *big = malloc(SM3_DRBG_MAX_REQUEST + 1), *ref = malloc(1000);
+	SM3_DRBG drbg, copy;
+	size_t i, j, k;
+	int ok = 1;
+
+	for (i = 0; i < sizeof(seed); i++)
+	{
+		seed[i] = (uint8_t)i;
+	}
+
+	for (k = 0; k < sizeof(impls) / sizeof(impls[0]) && ok; k++)
+	{
+		if (!sm3_set_impl(impls[k]))
+		{
+			continue;
+		}
+
+		sm3_drbg_instantiate(&drbg, seed, 32, seed + 32, 16, NULL, 0);
+		ok &= sm3_drbg_generate(&drbg, out, 64, NULL, 0);
+		ok &= sm3_drbg_generate(&drbg, out, 40, (const uint8_t *)"abc", 3);
+		ok &= memcmp(out, kat_add, sizeof(kat_add)) == 0;
+		sm3_drbg_reseed(&drbg, seed + 48, 32, NULL, 0);
+		ok &= sm3_drbg_generate(&drbg, out, 64, NULL, 0);
+		ok &= memcmp(out, kat_reseed, sizeof(kat_reseed)) == 0;
+
+		/* Hashgen over many lanes is V, V+1, ... hashed one by one */
+		copy = drbg;
+		ok &= sm3_drbg_generate(&drbg, big, 1000, NULL, 0);
+		for (i = 0; i < 1000; i += 32)
+		{
+			uint8_t dgst[32];
+
+			sm3(copy.V, SM3_DRBG_SEED_LEN, dgst);
+			memcpy(ref + i, dgst, 1000 - i < 32 ? 1000 - i : 32);
+			/* V + 1, carried through the big-endian bytes */
+			for (j = SM3_DRBG_SEED_LEN; j-- > 0 && ++copy.V[j] == 0;)
+			{
+			}
+		}
+		ok &= memcmp(big, ref, 1000) == 0;
+
+		/* Refused requests write nothing */
+		memset(out, 0, sizeof(out));
+		ok &= sm3_drbg_generate(&drbg, big, SM3_DRBG_MAX_REQUEST + 1, NULL, 0) == 0;
+		drbg.reseed_counter = SM3_DRBG_RESEED_INTERVAL + 1;
+		ok &= sm3_drbg_generate(&drbg, out, 32, NULL, 0) == 0;
+		ok &= out[0] == 0 && out[31] == 0;
+		sm3_drbg_clean(&drbg);
+
+		if (!ok)
+		{
+			printf("[ERROR] SM3 Hash_DRBG mismatch with the %s backend\n", sm3_get_impl_name());
+		}
+	}
+	sm3_set_impl(SM3_IMPL_AUTO);
+	free(big);
+	free(ref);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 Hash_DRBG test pass!");
+	}
+}
+
+void sm3_impl_self_check()
+{
+	puts("======== Test SM3 implementations against the portable one ========");
+	printf("[+] Selected backend: %s\n", sm3_get_impl_name());
+
+	const SM3_IMPL impls[] = { SM3_IMPL_SSSE3, SM3_IMPL_AVX2, SM3_IMPL_AVX512, SM3_IMPL_ARMV8 };
+	enum { IMPL_TESTS = 200, IMPL_MAX_LEN = 3000 };
+	uint8_t *msg = malloc(IMPL_MAX_LEN);
+	uint8_t expect[32], dgst[32];
+	size_t i, k;
+	int ok = 1;
+
+	for (int t = 0; t < IMPL_TESTS && ok; t++)
+	{
+		size_t len = (size_t)(rand() % IMPL_MAX_LEN);
+
+		for (i = 0; i < len; i++)
+		{
+			msg[i] = (uint8_t)rand();
+		}
+
+		sm3_set_impl(SM3_IMPL_PORTABLE);
+		sm3(msg, len, expect);
+
+		for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++)
+		{
+			if (!sm3_set_impl(impls[k]))
+			{
+				continue;
+			}
+			sm3(msg, len, dgst);
+			if (memcmp(dgst, expect, 32) != 0)
+			{
+				printf("[ERROR] SM3 mismatch with the %s backend, len=%zu\n", sm3_get_impl_name(), len);
+				ok = 0;
+			}
+		}
+	}
+	sm3_set_impl(SM3_IMPL_AUTO);
+	free(msg);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 implementation test pass!");
+	}
+}
+
+void sm3_mb_self_check()
+{
+	puts("======== Test SM3 multi-buffer against single-buffer SM3 ========");
+
+	const SM3_IMPL impls[] = { SM3_IMPL_PORTABLE, SM3_IMPL_AVX2, SM3_IMPL_AVX512 };
+	enum { MB_JOBS = 100, MB_MAX_LEN = 700 };
+	SM3_MB_JOB jobs[MB_JOBS];
+	SM3_MB_MGR mgr;
+	int returned[MB_JOBS];
+	uint8_t *msg = malloc(MB_JOBS * MB_MAX_LEN);
+	uint8_t expect[MB_JOBS][32];
+	size_t i, j, k;
+	int ok = 1;
+
+	for (i = 0; i < MB_JOBS * MB_MAX_LEN; i++)
+	{
+		msg[i] = (uint8_t)rand();
+	}
+
+	for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++)
+	{
+		if (!sm3_set_impl(impls[k]))
+		{
+			continue;
+		}
+
+		for (int t = 0; t < 20 && ok; t++)
+		{
+			size_t njobs = (size_t)(rand() % MB_JOBS) + 1;
+			SM3_MB_JOB *done;
+
+			for (j = 0; j < njobs; j++)
+			{
+				/* Mostly short messages, padding edges included */
+				jobs[j].data = msg + j * MB_MAX_LEN;
+				jobs[j].len = (rand() & 1) ? (size_t)(rand() % 130) : (size_t)(rand() % MB_MAX_LEN);
+				jobs[j].user_data = &returned[j];
+				returned[j] = 0;
+				sm3(jobs[j].data, jobs[j].len, expect[j]);
+			}
+
+			/* Job manager, jobs come back in any order */
+			sm3_mb_init(&mgr);
+			for (j = 0; j < njobs; j++)
+			{
+				if ((done = sm3_mb_submit(&mgr, &jobs[j])) != NULL)
+				{
+					(*(int *)done->user_data)++;
+				}
+			}
+			while ((done = sm3_mb_flush(&mgr)) != NULL)
+			{
+				(*(int *)done->user_data)++;
+			}
+			for (j = 0; j < njobs; j++)
+			{
+				ok &= returned[j] == 1;
+				ok &= memcmp(jobs[j].digest, expect[j], 32) == 0;
+			}
+
+			/* Batch call */
+			for (j = 0; j < njobs; j++)
+			{
+				memset(jobs[j].digest, 0, 32);
+			}
+			sm3_mb(jobs, njobs);
+			for (j = 0; j < njobs; j++)
+			{
+				ok &= memcmp(jobs[j].digest, expect[j], 32) == 0;
+			}
+		}
+
+		if (!ok)
+		{
+			printf("[ERROR] SM3 multi-buffer mismatch with the %s backend\n", sm3_get_impl_name());
+			break;
+		}
+	}
+	sm3_set_impl(SM3_IMPL_AUTO);
+	free(msg);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 multi-buffer test pass!");
+	}
+}
+
+void sm3_hmac_batch_self_check()
+{
+	puts("======== Test batch SM3-HMAC against sm3_hmac_with_key ========");
+
+	const SM3_IMPL impls[] = { SM3_IMPL_PORTABLE, SM3_IMPL_AVX2, SM3_IMPL_AVX512 };
+	enum { BATCH = 150, BATCH_MAX_LEN = 300 };
+	SM3_HMAC_KEY hkeys[3];
+	const SM3_HMAC_KEY *keys[BATCH];
+	const uint8_t *msgs[BATCH];
+	size_t lens[BATCH];
+	uint8_t *msg = malloc(BATCH * BATCH_MAX_LEN);
+	uint8_t expect[BATCH * 32], macs[BATCH * 32], valid[(BATCH + 7) / 8];
+	uint8_t key[80];
+	size_t i, k;
+	int ok = 1;
+
+	for (i = 0; i < BATCH * BATCH_MAX_LEN; i++)
+	{
+		msg[i] = (uint8_t)rand();
+	}
+	for (k = 0; k < 3; k++)
+	{
+		for (i = 0; i < sizeof(key); i++)
+		{
+			key[i] = (uint8_t)rand();
+		}
+		sm3_hmac_key_init(&hkeys[k], key, 16 + 30 * k);
+	}
+	for (i = 0; i < BATCH; i++)
+	{
+		keys[i] = &hkeys[rand() % 3];
+		msgs[i] = msg + i * BATCH_MAX_LEN;
+		lens[i] = i < 10 ? i : (size_t)rand() % BATCH_MAX_LEN;
+		sm3_hmac_with_key(keys[i], msgs[i], lens[i], expect + 32 * i);
+	}
+
+	for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++)
+	{
+		if (!sm3_set_impl(impls[k]))
+		{
+			continue;
+		}
+
+		memset(macs, 0, sizeof(macs));
+		sm3_hmac_batch(keys, msgs, lens, BATCH, macs);
+		ok &= memcmp(macs, expect, sizeof(expect)) == 0;
+
+		ok &= sm3_hmac_verify_batch(keys, msgs, lens, expect, BATCH, valid) == 1;
+		for (i = 0; i < BATCH; i++)
+		{
+			ok &= (valid[i / 8] >> (i % 8)) & 1;
+		}
+		/* Bits past the last message stay clear */
+		ok &= (valid[BATCH / 8] >> (BATCH % 8)) == 0;
+
+		/* Forge every seventh tag, in a different byte each time */
+		memcpy(macs, expect, sizeof(expect));
+		for (i = 0; i < BATCH; i += 7)
+		{
+			macs[32 * i + i % 32] ^= 0x01;
+		}
+		ok &= sm3_hmac_verify_batch(keys, msgs, lens, macs, BATCH, valid) == 0;
+		for (i = 0; i < BATCH; i++)
+		{
+			ok &= ((valid[i / 8] >> (i % 8)) & 1) == (i % 7 != 0);
+		}
+
+		if (!ok)
+		{
+			printf("[ERROR] Batch SM3-HMAC mismatch with the %s backend\n", sm3_get_impl_name());
+			break;
+		}
+	}
+	sm3_set_impl(SM3_IMPL_AUTO);
+	free(msg);
+
+	if (ok)
+	{
+		puts("[SUCCESS] Batch SM3-HMAC test pass!");
+	}
+}
+
+static int sm3_file_check(const char *path, const uint8_t *msg, size_t len, off_t offset)
+{
+	uint8_t expect[32], dgst[32];
+	int fd = open(path, O_RDONLY);
+	int ok;
+
+	sm3(msg + offset, len - offset, expect);
+	ok = fd >= 0 && lseek(fd, offset, SEEK_SET) == offset && sm3_fd(fd, dgst) == 1 &&
+		memcmp(dgst, expect, 32) == 0 && lseek(fd, 0, SEEK_CUR) == (off_t)len;
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	if (offset == 0)
+	{
+		ok &= sm3_file(path, dgst) == 1 && memcmp(dgst, expect, 32) == 0;
+	}
+
+	return ok;
+}
+
+void sm3_file_self_check()
+{
+	puts("======== Test SM3 over files and pipes ========");
+
+	/* Past two mapping windows, mostly a hole in the file */
+	const size_t big = ((size_t)128 << 20) + 4096 + 77;
+	const size_t lens[] = { 0, 1, 63, 64, 65, 1000, 4096, 4097 };
+	const off_t spots[] = { 0, ((off_t)64 << 20) - 40, ((off_t)128 << 20) + 4000 };
+	char path[] = "/tmp/ycrypt_sm3_XXXXXX";
+	uint8_t *msg = calloc(big, 1);
+	uint8_t expect[32], dgst[32];
+	int pfd[2];
+	size_t i, j;
+	int fd, ok = 1;
+
+	fd = mkstemp(path);
+	if (fd < 0 || msg == NULL)
+	{
+		puts("[ERROR] SM3 file test setup failed");
+		free(msg);
+		return;
+	}
+
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]) && ok; i++)
+	{
+		for (j = 0; j < lens[i]; j++)
+		{
+			msg[j] = (uint8_t)rand();
+		}
+		ok &= ftruncate(fd, 0) == 0 && pwrite(fd, msg, lens[i], 0) == (ssize_t)lens[i];
+		ok &= sm3_file_check(path, msg, lens[i], 0);
+		if (lens[i] > 10)
+		{
+			ok &= sm3_file_check(path, msg, lens[i], 10);
+		}
+	}
+
+	memset(msg, 0, big);
+	ok &= ftruncate(fd, 0) == 0 && ftruncate(fd, (off_t)big) == 0;
+	for (i = 0; i < sizeof(spots) / sizeof(spots[0]); i++)
+	{
+		for (j = 0; j < 100; j++)
+		{
+			msg[spots[i] + j] = (uint8_t)rand();
+		}
+		ok &= pwrite(fd, msg + spots[i], 100, spots[i]) == 100;
+	}
+	ok &= sm3_file_check(path, msg, big, 0);
+	ok &= sm3_file_check(path, msg, big, 100);
+	if (!ok)
+	{
+		puts("[ERROR] SM3 of a file mismatch");
+	}
+
+	/* Not mappable: read() fallback */
+	if (pipe(pfd) == 0)
+	{
+		ok &= write(pfd[1], msg + spots[1], 5000) == 5000;
+		close(pfd[1]);
+		sm3(msg + spots[1], 5000, expect);
+		if (sm3_fd(pfd[0], dgst) != 1 || memcmp(dgst, expect, 32) != 0)
+		{
+			puts("[ERROR] SM3 of a pipe mismatch");
+			ok = 0;
+		}
+		close(pfd[0]);
+	}
+
+	close(fd);
+	unlink(path);
+	if (sm3_file(path, dgst) != 0)
+	{
+		puts("[ERROR] SM3 of a missing file succeeded");
+		ok = 0;
+	}
+	free(msg);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 file test pass!");
+	}
+}
+
+/* Tree mode v1 straight from its definition, one leaf after another */
+static void sm3_tree_reference(const uint8_t *msg, size_t len, size_t chunk, uint8_t digest[32])
+{
+	uint8_t leaf_prefix[64] = { 0x00, SM3_TREE_VERSION };
+	uint8_t root_prefix[64] = { 0x01, SM3_TREE_VERSION };
+	uint8_t leaf[32];
+	SM3_CTX root, ctx;
+	size_t off = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		root_prefix[2 + i] = (uint8_t)((uint64_t)chunk >> (56 - 8 * i));
+		root_prefix[10 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+	}
+	sm3_init(&root);
+	sm3_update(&root, root_prefix, 64);
+	do
+	{
+		size_t clen = len - off < chunk ? len - off : chunk;
+
+		sm3_init(&ctx);
+		sm3_update(&ctx, leaf_prefix, 64);
+		sm3_update(&ctx, msg + off, clen);
+		sm3_final(&ctx, leaf);
+		sm3_update(&root, leaf, 32);
+		off += chunk;
+	} while (off < len);
+	sm3_final(&root, digest);
+}
+
+void sm3_tree_self_check()
+{
+	puts("======== Test SM3 tree mode ========");
+
+	/* sm3_tree("abc", chunk 64), pins the v1 format */
+	const uint8_t abc_expect[32] = {
+		0x6F, 0x96, 0x56, 0x8D, 0x3E, 0x06, 0xAD, 0xF5, 0x85, 0x53, 0xB1, 0xF6, 0xDC, 0xBD, 0x00, 0x6C,
+		0xE9, 0xDE, 0xD9, 0x59, 0x0D, 0x3C, 0x34, 0x72, 0x6E, 0xAA, 0xA0, 0x44, 0x2E, 0x7F, 0xE1, 0x1E
+	};
+	const size_t chunk = 4096;
+	const size_t lens[] = { 0, 1, 64, chunk - 1, chunk, chunk + 1, 5 * chunk + 100, 37 * chunk };
+	const unsigned int threads[] = { 1, 3, 0 };
+	uint8_t *msg = malloc(37 * chunk);
+	uint8_t expect[32], dgst[32];
+	char path[] = "/tmp/ycrypt_sm3_tree_XXXXXX";
+	size_t i, t;
+	int fd, ok = 1;
+
+	for (i = 0; i < 37 * chunk; i++)
+	{
+		msg[i] = (uint8_t)rand();
+	}
+
+	ok &= sm3_tree((const uint8_t *)"abc", 3, 64, 1, dgst) == 1 && memcmp(dgst, abc_expect, 32) == 0;
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+	{
+		sm3_tree_reference(msg, lens[i], chunk, expect);
+		for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+		{
+			ok &= sm3_tree(msg, lens[i], chunk, threads[t], dgst) == 1 && memcmp(dgst, expect, 32) == 0;
+		}
+	}
+	if (!ok)
+	{
+		puts("[ERROR] SM3 tree mode mismatch");
+	}
+
+	/* Parameters are bound into the root */
+	sm3_tree(msg, 5 * chunk, chunk, 0, expect);
+	sm3_tree(msg, 5 * chunk, 2 * chunk, 0, dgst);
+	ok &= memcmp(dgst, expect, 32) != 0;
+	sm3(msg, 5 * chunk, dgst);
+	ok &= memcmp(dgst, expect, 32) != 0;
+	ok &= sm3_tree(msg, 100, 0, 1, dgst) == 0 && sm3_tree(msg, 100, 100, 1, dgst) == 0;
+
+	fd = mkstemp(path);
+	if (fd >= 0)
+	{
+		ok &= write(fd, msg, 37 * chunk) == (ssize_t)(37 * chunk);
+		close(fd);
+		sm3_tree(msg, 37 * chunk, chunk, 0, expect);
+		ok &= sm3_tree_file(path, chunk, 0, dgst) == 1 && memcmp(dgst, expect, 32) == 0;
+		unlink(path);
+	}
+	free(msg);
+
+	if (ok)
+	{
+		puts("[SUCCESS] SM3 tree mode test pass!");
+	}
+	else
+	{
+		puts("[ERROR] SM3 tree mode test failed");
+	}
+}
+
 #ifdef TEST_WITH_OPENSSL
 /* ============================================================
  * OpenSSL Cross Verification Tests
@@ -390,7 +1097,16 @@ int main()
 {
 	sm3_self_check();
 	sm3_hmac_self_check();
+	sm3_hmac_key_self_check();
+	sm3_export_self_check();
+	sm3_kdf_self_check();
+	sm3_drbg_self_check();
 	sm3_gmssl_test_case();
+	sm3_impl_self_check();
+	sm3_mb_self_check();
+	sm3_hmac_batch_self_check();
+	sm3_file_self_check();
+	sm3_tree_self_check();
 
 #ifdef TEST_WITH_OPENSSL
 	test_sm3_vs_openssl();
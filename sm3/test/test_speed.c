@@ -1,4 +1,5 @@
 #include <time.h>
+#include <unistd.h>
 #include "../include/sm3.h"
 
 #define LARGE_BUFFER_SIZE (100 * 1024 * 1024UL) // 100 MB
@@ -65,9 +66,346 @@ void sm3_hmac_benchmark() {
     printf("SM3-HMAC speed: %.03f MB/sec\n\n", speed);
 }
 
+void sm3_hmac_key_benchmark()
+{
+	puts("======== Bench SM3-HMAC, 64-byte messages with one key ========");
+
+	const size_t n = 1 << 20;
+	u1 key[] = "an API key of a few bytes";
+	u1 msg[64] = { 0 };
+	u1 mac[32] = { 0 };
+	SM3_HMAC_KEY hkey;
+	clock_t start = 0, end = 0;
+	double diff = 0;
+	size_t i;
+
+	start = clock();
+	for (i = 0; i < n; i++)
+	{
+		msg[0] = (u1)i;
+		sm3_hmac(msg, sizeof(msg), key, sizeof(key) - 1, mac);
+	}
+	end = clock();
+	diff = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("sm3_hmac:          %10.0f MAC/sec\n", n / diff);
+
+	start = clock();
+	sm3_hmac_key_init(&hkey, key, sizeof(key) - 1);
+	for (i = 0; i < n; i++)
+	{
+		msg[0] = (u1)i;
+		sm3_hmac_with_key(&hkey, msg, sizeof(msg), mac);
+	}
+	end = clock();
+	diff = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("sm3_hmac_with_key: %10.0f MAC/sec\n\n", n / diff);
+	sm3_hmac_key_clean(&hkey);
+}
+
+void sm3_hmac_batch_benchmark()
+{
+	puts("======== Bench batch SM3-HMAC verify, 100-byte messages, 4 keys ========");
+
+	const SM3_IMPL impls[] = { SM3_IMPL_AVX512, SM3_IMPL_AVX2, SM3_IMPL_PORTABLE };
+	const size_t n = 1 << 16, len = 100;
+	SM3_HMAC_KEY hkeys[4];
+	const SM3_HMAC_KEY **keys = (const SM3_HMAC_KEY**)malloc(n * sizeof(*keys));
+	const u1 **msgs = (const u1**)malloc(n * sizeof(*msgs));
+	size_t *lens = (size_t*)malloc(n * sizeof(*lens));
+	u1 *g_in = (u1*)malloc(n * len);
+	u1 *tags = (u1*)malloc(n * SM3_HMAC_SIZE);
+	u1 *valid = (u1*)malloc((n + 7) / 8);
+	u1 key[16] = { 0 };
+	clock_t start = 0, end = 0;
+	double diff = 0;
+	size_t i, k;
+
+	for (k = 0; k < 4; k++)
+	{
+		key[0] = (u1)k;
+		sm3_hmac_key_init(&hkeys[k], key, sizeof(key));
+	}
+	for (i = 0; i < n * len; i++)
+	{
+		g_in[i] = i & 0xFF;
+	}
+	for (i = 0; i < n; i++)
+	{
+		keys[i] = &hkeys[i % 4];
+		msgs[i] = g_in + i * len;
+		lens[i] = len;
+		sm3_hmac_with_key(keys[i], msgs[i], len, tags + i * SM3_HMAC_SIZE);
+	}
+
+	start = clock();
+	for (i = 0; i < n; i++)
+	{
+		u1 mac[SM3_HMAC_SIZE];
+
+		sm3_hmac_with_key(keys[i], msgs[i], len, mac);
+		valid[0] = memcmp(mac, tags + i * SM3_HMAC_SIZE, SM3_HMAC_SIZE) == 0;
+	}
+	end = clock();
+	diff = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("sm3_hmac_with_key one by one:     %10.0f verify/sec\n", n / diff);
+
+	for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++)
+	{
+		if (!sm3_set_impl(impls[k]))
+		{
+			continue;
+		}
+
+		start = clock();
+		sm3_hmac_verify_batch(keys, msgs, lens, tags, n, valid);
+		end = clock();
+		diff = (double)(end - start) / CLOCKS_PER_SEC;
+		printf("sm3_hmac_verify_batch (%-8s): %10.0f verify/sec\n", sm3_get_impl_name(), n / diff);
+	}
+	sm3_set_impl(SM3_IMPL_AUTO);
+
+	free(keys);
+	free(msgs);
+	free(lens);
+	free(g_in);
+	free(tags);
+	free(valid);
+	puts("");
+}
+
+void sm3_kdf_benchmark()
+{
+	puts("======== Bench SM3 KDF, 65-byte Z (SM2 x2 || y2), 4 KB output ========");
+
+	const size_t n = 1 << 12, len = 4096;
+	u1 z[65] = { 0x04 };
+	u1 *out = (u1*)malloc(len);
+	clock_t start = 0, end = 0;
+	double diff = 0;
+	size_t i;
+
+	start = clock();
+	for (i = 0; i < n; i++)
+	{
+		z[1] = (u1)i;
+		sm3_kdf(z, sizeof(z), out, len);
+	}
+	end = clock();
+	diff = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("sm3_kdf: %10.2f MB/sec\n\n", (double)n * len / diff / 1024 / 1024);
+
+	free(out);
+}
+
+void sm3_impl_benchmark()
+{
+	puts("======== Bench SM3 single-stream implementations ========");
+
+	const SM3_IMPL impls[] = { SM3_IMPL_PORTABLE, SM3_IMPL_SSSE3, SM3_IMPL_ARMV8 };
+	const size_t len = 64 * 1024 * 1024;
+	uint8_t *g_in = (uint8_t*)malloc(len);
+	uint8_t digest[32] = { 0 };
+	clock_t start = 0, end = 0;
+	double diff = 0;
+	size_t i, k;
+
+	for (i = 0; i < len; i++)
+	{
+		g_in[i] = i & 0xFF;
+	}
+
+	for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++)
+	{
+		if (!sm3_set_impl(impls[k]))
+		{
+			continue;
+		}
+
+		start = clock();
+		for (i = 0; i < 4; i++)
+		{
+			sm3(g_in, len, digest);
+		}
+		end = clock();
+		diff = (double)(end - start) / CLOCKS_PER_SEC;
+		printf("SM3 (%-8s) speed: %.03f MB/sec\n", sm3_get_impl_name(), 4.0 * len / 1024 / 1024 / diff);
+	}
+	sm3_set_impl(SM3_IMPL_AUTO);
+
+	free(g_in);
+	puts("");
+}
+
+void sm3_mb_benchmark()
+{
+	puts("======== Bench SM3 multi-buffer ========");
+
+	const SM3_IMPL impls[] = { SM3_IMPL_AVX512, SM3_IMPL_AVX2, SM3_IMPL_PORTABLE };
+	const size_t sizes[] = { 64, 256, 1024 };
+	const size_t njobs = 1 << 16;
+	SM3_MB_JOB *jobs = (SM3_MB_JOB*)malloc(njobs * sizeof(SM3_MB_JOB));
+	uint8_t *g_in = (uint8_t*)malloc(njobs * 1024);
+	uint8_t digest[32] = { 0 };
+	clock_t start = 0, end = 0;
+	double diff = 0;
+	size_t i, s, k;
+
+	for (i = 0; i < njobs * 1024; i++)
+	{
+		g_in[i] = i & 0xFF;
+	}
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		size_t len = sizes[s];
+
+		for (i = 0; i < njobs; i++)
+		{
+			jobs[i].data = g_in + i * len;
+			jobs[i].len = len;
+		}
+
+		start = clock();
+		for (i = 0; i < njobs; i++)
+		{
+			sm3(jobs[i].data, len, digest);
+		}
+		end = clock();
+		diff = (double)(end - start) / CLOCKS_PER_SEC;
+		printf("%4zu-byte messages, sm3 one by one:   %10.0f msg/sec, %8.3f MB/sec\n",
+			len, njobs / diff, njobs * len / diff / 1024 / 1024);
+
+		for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++)
+		{
+			if (!sm3_set_impl(impls[k]))
+			{
+				continue;
+			}
+
+			start = clock();
+			sm3_mb(jobs, njobs);
+			end = clock();
+			diff = (double)(end - start) / CLOCKS_PER_SEC;
+			printf("%4zu-byte messages, sm3_mb (%-8s): %10.0f msg/sec, %8.3f MB/sec\n",
+				len, sm3_get_impl_name(), njobs / diff, njobs * len / diff / 1024 / 1024);
+		}
+		sm3_set_impl(SM3_IMPL_AUTO);
+	}
+
+	free(jobs);
+	free(g_in);
+	puts("");
+}
+
+void sm3_file_benchmark()
+{
+	puts("======== Bench SM3 over a file ========");
+
+	const size_t len = 256 * 1024 * 1024;
+	const size_t chunk = 64 * 1024;
+	char path[] = "/tmp/ycrypt_sm3_bench_XXXXXX";
+	uint8_t *g_in = (uint8_t*)malloc(chunk);
+	uint8_t digest[32] = { 0 };
+	SM3_CTX ctx;
+	clock_t start = 0, end = 0;
+	double diff = 0;
+	size_t i;
+	FILE *f;
+	int fd = mkstemp(path);
+
+	for (i = 0; i < chunk; i++)
+	{
+		g_in[i] = i & 0xFF;
+	}
+	for (i = 0; i < len; i += chunk)
+	{
+		if (fd < 0 || write(fd, g_in, chunk) != (ssize_t)chunk)
+		{
+			puts("cannot write the benchmark file");
+			goto out;
+		}
+	}
+
+	/* Warm the page cache, both runs then hash from memory */
+	sm3_file(path, digest);
+
+	start = clock();
+	f = fopen(path, "rb");
+	sm3_init(&ctx);
+	while ((i = fread(g_in, 1, chunk, f)) > 0)
+	{
+		sm3_update(&ctx, g_in, i);
+	}
+	sm3_final(&ctx, digest);
+	fclose(f);
+	end = clock();
+	diff = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("fread + sm3_update (64KB): %.03f MB/sec\n", len / 1024.0 / 1024 / diff);
+
+	start = clock();
+	sm3_file(path, digest);
+	end = clock();
+	diff = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("sm3_file (mmap):           %.03f MB/sec\n", len / 1024.0 / 1024 / diff);
+
+out:
+	if (fd >= 0)
+	{
+		close(fd);
+		unlink(path);
+	}
+	free(g_in);
+	puts("");
+}
+
+void sm3_tree_benchmark()
+{
+	puts("======== Bench SM3 tree mode (1MB chunks) ========");
+
+	const size_t len = 256 * 1024 * 1024;
+	const unsigned int threads[] = { 1, 2, 4, 0 };
+	uint8_t *g_in = (uint8_t*)malloc(len);
+	uint8_t digest[32] = { 0 };
+	struct timespec start, end;
+	double diff = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		g_in[i] = i & 0xFF;
+	}
+
+	/* Wall clock: clock() would add up the CPU time of all threads */
+	for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		sm3_tree(g_in, len, SM3_TREE_CHUNK_DEFAULT, threads[i], digest);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		diff = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		if (threads[i])
+		{
+			printf("sm3_tree, %u thread(s): %.03f MB/sec\n", threads[i], len / 1024.0 / 1024 / diff);
+		}
+		else
+		{
+			printf("sm3_tree, all CPUs:    %.03f MB/sec\n", len / 1024.0 / 1024 / diff);
+		}
+	}
+
+	free(g_in);
+	puts("");
+}
+
 int main()
 {
 	sm3_benchmark();
 	sm3_hmac_benchmark();
+	sm3_hmac_key_benchmark();
+	sm3_hmac_batch_benchmark();
+	sm3_kdf_benchmark();
+	sm3_impl_benchmark();
+	sm3_mb_benchmark();
+	sm3_file_benchmark();
+	sm3_tree_benchmark();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef SM4_CCM_H
+#define SM4_CCM_H
+
+/*
+ * SM4 CCM mode interfaces are defined in the top-level sm_interface.h
+ * This header is provided for compatibility within the sm4 module.
+ */
+#include "include/sm_interface.h"
+
+#endif /* SM4_CCM_H */
@@ -0,0 +1,83 @@
+#ifndef SM4_IMPL_H
+#define SM4_IMPL_H
+
+/*
+ * SM4 block cipher backends.
+ * Internal to the sm4 module, the public API is in include/sm_interface.h
+ */
+#include "include/sm_interface.h"
+#include "include/ycrypt_cpu.h"
+
+/* Number of blocks the bit-sliced core processes per pass */
+#define SM4_BS_LANES 16
+
+/* nblocks independent blocks with schedule rk, in may equal out */
+typedef void (*sm4_crypt_blocks_fn)(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+
+/* One block with schedule rk, in may equal out */
+typedef void (*sm4_crypt_block_fn)(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out);
+
+/*
+ * Exactly `lanes` blocks, each with its own key schedule. Round i of the
+ * block in slot d uses rk_lanes[i * lanes + d]; the kernels keep blocks
+ * transposed in 128-bit lanes, so slot d holds block
+ * SM4_LANE_BLOCK(lanes, d) of in/out.
+ */
+typedef void (*sm4_crypt_lanes_fn)(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+
+#define SM4_LANE_BLOCK(lanes, d) ((lanes) / 4 * ((d) % 4) + (d) / 4)
+
+typedef struct {
+  const char *name;
+  sm4_crypt_blocks_fn crypt_blocks;
+  /* Constant-time sm4_encrypt/sm4_decrypt, NULL to keep the table rounds */
+  sm4_crypt_block_fn crypt_block;
+  /* Multi-key kernel for multi-buffer modes, NULL if unavailable */
+  sm4_crypt_lanes_fn crypt_lanes;
+  size_t lanes;
+} SM4_BACKEND;
+
+/* Backend picked for this CPU, selected on first use */
+const SM4_BACKEND *sm4_backend(void);
+
+/* Bit-sliced, table-free core: nblocks independent blocks, any count */
+void sm4_bs_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+void sm4_aesni_crypt_block(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out);
+/* AES-NI S-box: SSSE3 with 4, AVX2 with 8, AVX-512 + VAES with 16 blocks per pass */
+void sm4_aesni_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_aesni_avx2_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_aesni_avx512_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_aesni_crypt_lanes(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+void sm4_aesni_avx2_crypt_lanes(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+void sm4_aesni_avx512_crypt_lanes(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+
+#ifdef YCRYPT_ENABLE_GFNI
+/* GFNI S-box: AVX2 with 8, AVX-512 with 16 blocks per pass */
+void sm4_gfni_avx2_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_gfni_avx512_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_gfni_avx2_crypt_lanes(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+void sm4_gfni_avx512_crypt_lanes(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+#endif
+#endif
+
+#ifdef YCRYPT_HAVE_ARM_CE
+/* ARMv8.2 SM4E: 8 blocks per pass, 4 lanes for the multi-key kernel */
+void sm4_armv8_crypt_block(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out);
+void sm4_armv8_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const u1 *in, u1 *out, size_t nblocks);
+void sm4_armv8_crypt_lanes(const uint32_t *rk_lanes, const u1 *in, u1 *out);
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SM4_X86_H
+#define SM4_X86_H
+
+/*
+ * Pieces shared by the x86 SM4 kernels (sm4_aesni.c, sm4_gfni.c).
+ * Each register holds one state word x0..x3 of 4 blocks per 128-bit lane,
+ * as native 32-bit integers; only the S-box differs between kernels.
+ */
+#include <immintrin.h>
+
+/* Byte swap of each 32-bit word and byte rotations of each 32-bit word */
+#define BSWAP_0    0x0405060700010203ULL
+#define BSWAP_1    0x0C0D0E0F08090A0BULL
+#define ROL8_0     0x0605040702010003ULL
+#define ROL8_1     0x0E0D0C0F0A09080BULL
+#define ROL16_0    0x0504070601000302ULL
+#define ROL16_1    0x0D0C0F0E09080B0AULL
+#define ROL24_0    0x0407060500030201ULL
+#define ROL24_1    0x0C0F0E0D080B0A09ULL
+
+/* 4x4 transpose of 32-bit words within each 128-bit lane, uses t0..t3 */
+#define SM4_TRANSPOSE_4x4(r0, r1, r2, r3, unpacklo32, unpackhi32, unpacklo64, unpackhi64) \
+  do {                                                \
+    t0 = unpacklo32(r0, r1);                          \
+    t1 = unpacklo32(r2, r3);                          \
+    t2 = unpackhi32(r0, r1);                          \
+    t3 = unpackhi32(r2, r3);                          \
+    r0 = unpacklo64(t0, t1);                          \
+    r1 = unpackhi64(t0, t1);                          \
+    r2 = unpacklo64(t2, t3);                          \
+    r3 = unpackhi64(t2, t3);                          \
+  } while(0)
+
+/* L(t) = t ^ (t <<< 24) ^ ((t ^ (t <<< 8) ^ (t <<< 16)) <<< 2) */
+__attribute__((target("ssse3")))
+static inline __m128i sm4_sse_l(__m128i t)
+{
+  const __m128i rol8 = _mm_set_epi64x(ROL8_1, ROL8_0);
+  const __m128i rol16 = _mm_set_epi64x(ROL16_1, ROL16_0);
+  const __m128i rol24 = _mm_set_epi64x(ROL24_1, ROL24_0);
+  __m128i a;
+
+  a = _mm_xor_si128(t, _mm_xor_si128(_mm_shuffle_epi8(t, rol8), _mm_shuffle_epi8(t, rol16)));
+  a = _mm_xor_si128(_mm_slli_epi32(a, 2), _mm_srli_epi32(a, 30));
+
+  return _mm_xor_si128(_mm_xor_si128(t, _mm_shuffle_epi8(t, rol24)), a);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sm4_avx2_l(__m256i t)
+{
+  const __m256i rol8 = _mm256_set_epi64x(ROL8_1, ROL8_0, ROL8_1, ROL8_0);
+  const __m256i rol16 = _mm256_set_epi64x(ROL16_1, ROL16_0, ROL16_1, ROL16_0);
+  const __m256i rol24 = _mm256_set_epi64x(ROL24_1, ROL24_0, ROL24_1, ROL24_0);
+  __m256i a;
+
+  a = _mm256_xor_si256(t, _mm256_xor_si256(_mm256_shuffle_epi8(t, rol8), _mm256_shuffle_epi8(t, rol16)));
+  a = _mm256_xor_si256(_mm256_slli_epi32(a, 2), _mm256_srli_epi32(a, 30));
+
+  return _mm256_xor_si256(_mm256_xor_si256(t, _mm256_shuffle_epi8(t, rol24)), a);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i sm4_avx512_l(__m512i t)
+{
+  const __m512i rol8 = _mm512_broadcast_i32x4(_mm_set_epi64x(ROL8_1, ROL8_0));
+  const __m512i rol16 = _mm512_broadcast_i32x4(_mm_set_epi64x(ROL16_1, ROL16_0));
+  __m512i a;
+
+  /* 0x96 is the three-way XOR */
+  a = _mm512_ternarylogic_epi32(t, _mm512_shuffle_epi8(t, rol8), _mm512_shuffle_epi8(t, rol16), 0x96);
+
+  return _mm512_ternarylogic_epi32(t, _mm512_rol_epi32(t, 24), _mm512_rol_epi32(a, 2), 0x96);
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef SM4_XTS_H
+#define SM4_XTS_H
+
+/*
+ * SM4 XTS mode interfaces are defined in the top-level sm_interface.h
+ * This header is provided for compatibility within the sm4 module.
+ */
+#include "include/sm_interface.h"
+
+#endif /* SM4_XTS_H */
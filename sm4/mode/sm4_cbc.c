@@ -1,15 +1,19 @@
 #include "../include/sm4_cbc.h"
 #include "../include/sm4.h"
+#include <string.h>
 
-static inline void sm4_get_decrypt_key(const uint32_t rk_enc[32], uint32_t rk_dec[32]) {
-    for (int i = 0; i < 32; i++) {
-        rk_dec[i] = rk_enc[31 - i];
-    }
-}
+/* Blocks decrypted per call to the multi-block core */
+#define SM4_CBC_BATCH_BLOCKS 16
 
 static inline void xor_block(uint8_t *dst, const uint8_t *src1, const uint8_t *src2) {
-    ((uint64_t*)dst)[0] = ((uint64_t*)src1)[0] ^ ((uint64_t*)src2)[0];
-    ((uint64_t*)dst)[1] = ((uint64_t*)src1)[1] ^ ((uint64_t*)src2)[1];
+    uint64_t a[2], b[2];
+
+    /* memcpy keeps unaligned buffers well-defined, it compiles to plain loads */
+    memcpy(a, src1, SM4_BLOCK_SIZE);
+    memcpy(b, src2, SM4_BLOCK_SIZE);
+    a[0] ^= b[0];
+    a[1] ^= b[1];
+    memcpy(dst, a, SM4_BLOCK_SIZE);
 }
 
 void sm4_cbc_encrypt(
@@ -37,6 +41,59 @@ void sm4_cbc_encrypt(
     }
 }
 
+void sm4_cbc_decrypt_chain(
+    const uint32_t rk[32],
+    const uint8_t iv[16],
+    const uint8_t *input,
+    uint8_t *output,
+    size_t length,
+    uint8_t iv_out[16])
+{
+    uint8_t saved[SM4_CBC_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+    uint8_t chain[SM4_BLOCK_SIZE];
+
+    memcpy(chain, iv, SM4_BLOCK_SIZE);
+
+    /*
+     * Blocks are independent on decryption: each batch goes through the
+     * multi-block core (4/8/16 blocks in flight depending on the backend)
+     * straight into output, then P_i = D(C_i) ^ C_{i-1}. In-place calls
+     * keep a copy of the batch ciphertext for the chaining XOR.
+     */
+    while (length >= SM4_BLOCK_SIZE) {
+        size_t nblocks = length / SM4_BLOCK_SIZE;
+        size_t nbytes;
+        const uint8_t *ct = input;
+
+        if (nblocks > SM4_CBC_BATCH_BLOCKS) {
+            nblocks = SM4_CBC_BATCH_BLOCKS;
+        }
+        nbytes = nblocks * SM4_BLOCK_SIZE;
+
+        if ((uintptr_t)output < (uintptr_t)input + nbytes &&
+            (uintptr_t)input < (uintptr_t)output + nbytes) {
+            memcpy(saved, input, nbytes);
+            ct = saved;
+        }
+
+        sm4_decrypt_blocks(rk, ct, output, nblocks);
+        xor_block(output, output, chain);
+        for (size_t i = 1; i < nblocks; i++) {
+            xor_block(output + i * SM4_BLOCK_SIZE, output + i * SM4_BLOCK_SIZE,
+                      ct + (i - 1) * SM4_BLOCK_SIZE);
+        }
+        memcpy(chain, ct + nbytes - SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+
+        input += nbytes;
+        output += nbytes;
+        length -= nbytes;
+    }
+
+    if (iv_out) {
+        memcpy(iv_out, chain, SM4_BLOCK_SIZE);
+    }
+}
+
 void sm4_cbc_decrypt(
     const uint32_t rk[32],
     const uint8_t iv[16],
@@ -44,19 +101,147 @@ void sm4_cbc_decrypt(
     uint8_t *output,
     size_t length) 
 {
-    uint32_t rk_dec[32];
-    uint8_t temp_buf[1024];
-    const uint8_t *current_iv = iv;
+    sm4_cbc_decrypt_chain(rk, iv, input, output, length, NULL);
+}
 
-    sm4_get_decrypt_key(rk, rk_dec);
+/* ============================================================
+ * Streaming API
+ * ============================================================ */
 
-    while (length >= SM4_BLOCK_SIZE) {
-        sm4_decrypt(rk, input, temp_buf); 
-        xor_block(output, temp_buf, current_iv);
-        
-        current_iv = input;
-        input += SM4_BLOCK_SIZE;
-        output += SM4_BLOCK_SIZE;
-        length -= SM4_BLOCK_SIZE;
+/**
+ * Initialize a streaming CBC context
+ * enc: 1 to encrypt, 0 to decrypt; padding: 1 for PKCS#7, 0 for none
+ */
+void sm4_cbc_init(SM4_CBC_CTX *ctx, const uint8_t key[SM4_KEY_SIZE],
+                  const uint8_t iv[SM4_BLOCK_SIZE], int enc, int padding)
+{
+    memset(ctx, 0, sizeof(SM4_CBC_CTX));
+    sm4_key_schedule(key, ctx->rk);
+    memcpy(ctx->iv, iv, SM4_BLOCK_SIZE);
+    ctx->enc = enc;
+    ctx->padding = padding;
+}
+
+/* Whole blocks, the chaining value is carried in ctx->iv */
+static void sm4_cbc_ctx_blocks(SM4_CBC_CTX *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    if (ctx->enc) {
+        sm4_cbc_encrypt(ctx->rk, ctx->iv, in, out, len);
+        memcpy(ctx->iv, out + len - SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+    } else {
+        sm4_cbc_decrypt_chain(ctx->rk, ctx->iv, in, out, len, ctx->iv);
+    }
+}
+
+/**
+ * Process len bytes, writing *out_len bytes (a multiple of 16, at most
+ * len + 15) to out. Partial blocks are buffered; when decrypting with
+ * padding the last full block is held back for sm4_cbc_final(). Block
+ * aligned input goes straight to the multi-block core; out may equal in
+ * as long as every call is block aligned and no block is held back.
+ * @return 1 on success
+ */
+int sm4_cbc_update(SM4_CBC_CTX *ctx, const uint8_t *in, uint8_t *out,
+                   size_t len, size_t *out_len)
+{
+    int hold = !ctx->enc && ctx->padding;
+    size_t nbytes;
+
+    *out_len = 0;
+
+    /* Complete the buffered block first */
+    if (ctx->buffer_used) {
+        size_t n = SM4_BLOCK_SIZE - ctx->buffer_used;
+
+        n = n > len ? len : n;
+        memcpy(ctx->buffer + ctx->buffer_used, in, n);
+        ctx->buffer_used += n;
+        in += n;
+        len -= n;
+
+        if (ctx->buffer_used < SM4_BLOCK_SIZE || (hold && len == 0)) {
+            return 1;
+        }
+        sm4_cbc_ctx_blocks(ctx, ctx->buffer, out, SM4_BLOCK_SIZE);
+        ctx->buffer_used = 0;
+        out += SM4_BLOCK_SIZE;
+        *out_len += SM4_BLOCK_SIZE;
+    }
+
+    /* Zero-copy bulk */
+    nbytes = len - len % SM4_BLOCK_SIZE;
+    if (hold && nbytes && nbytes == len) {
+        nbytes -= SM4_BLOCK_SIZE;
     }
+    if (nbytes) {
+        sm4_cbc_ctx_blocks(ctx, in, out, nbytes);
+        *out_len += nbytes;
+    }
+
+    memcpy(ctx->buffer, in + nbytes, len - nbytes);
+    ctx->buffer_used = len - nbytes;
+
+    return 1;
+}
+
+/**
+ * Finish the stream: encryption writes the padding block, decryption
+ * checks and strips the padding. At most 16 bytes are written.
+ * @return 1 on success, 0 if the data was not block aligned without
+ *         padding or the padding is invalid
+ */
+int sm4_cbc_final(SM4_CBC_CTX *ctx, uint8_t *out, size_t *out_len)
+{
+    uint8_t block[SM4_BLOCK_SIZE];
+    unsigned int pad, bad;
+
+    *out_len = 0;
+
+    if (!ctx->padding) {
+        return ctx->buffer_used == 0;
+    }
+
+    if (ctx->enc) {
+        pad = (unsigned int)(SM4_BLOCK_SIZE - ctx->buffer_used);
+        memset(ctx->buffer + ctx->buffer_used, (int)pad, pad);
+        sm4_cbc_ctx_blocks(ctx, ctx->buffer, out, SM4_BLOCK_SIZE);
+        ctx->buffer_used = 0;
+        *out_len = SM4_BLOCK_SIZE;
+        return 1;
+    }
+
+    if (ctx->buffer_used != SM4_BLOCK_SIZE) {
+        return 0;
+    }
+    sm4_cbc_ctx_blocks(ctx, ctx->buffer, block, SM4_BLOCK_SIZE);
+    ctx->buffer_used = 0;
+
+    /* Check 1 <= pad <= 16 and the pad bytes without branching on them */
+    pad = block[SM4_BLOCK_SIZE - 1];
+    bad = (unsigned int)((pad - 1) >> 8) | (unsigned int)((SM4_BLOCK_SIZE - pad) >> 8);
+    for (unsigned int i = 0; i < SM4_BLOCK_SIZE; i++) {
+        /* 1 for the last pad bytes */
+        unsigned int in_pad = (unsigned int)(((SM4_BLOCK_SIZE - 1 - i) - pad) >> 8) & 1;
+
+        bad |= in_pad & (unsigned int)((block[i] ^ pad) != 0);
+    }
+
+    if (bad) {
+        memset(block, 0, sizeof(block));
+        return 0;
+    }
+
+    memcpy(out, block, SM4_BLOCK_SIZE - pad);
+    *out_len = SM4_BLOCK_SIZE - pad;
+    memset(block, 0, sizeof(block));
+
+    return 1;
+}
+
+/**
+ * Clear sensitive data from context
+ */
+void sm4_cbc_clean(SM4_CBC_CTX *ctx)
+{
+    memset(ctx, 0, sizeof(SM4_CBC_CTX));
 }
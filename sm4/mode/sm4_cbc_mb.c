@@ -0,0 +1,134 @@
+/**
+ * SM4-CBC multi-buffer encryption
+ *
+ * CBC encryption is serial within a stream, but independent streams can
+ * share a pass of the SIMD core. Every lane of the multi-key kernel runs
+ * one job with its own key schedule; a lane whose job is finished picks
+ * up the next one, so all lanes stay busy while jobs remain.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "../include/sm4_cbc.h"
+#include "../include/sm4_impl.h"
+
+/* Widest multi-key kernel */
+#define SM4_MB_MAX_LANES 16
+
+typedef struct {
+    const SM4_CBC_JOB *job;     /* NULL when the lane is idle */
+    const uint8_t *in;
+    uint8_t *out;
+    const uint8_t *chain;       /* IV or previous ciphertext block */
+    size_t nblocks;
+} sm4_mb_lane;
+
+static inline void xor_block(uint8_t *dst, const uint8_t *src1, const uint8_t *src2)
+{
+    uint64_t a[2], b[2];
+
+    memcpy(a, src1, SM4_BLOCK_SIZE);
+    memcpy(b, src2, SM4_BLOCK_SIZE);
+    a[0] ^= b[0];
+    a[1] ^= b[1];
+    memcpy(dst, a, SM4_BLOCK_SIZE);
+}
+
+/**
+ * Give lane d the next job with at least one block, and load its round
+ * keys into the lane's column of the key table.
+ * @return 1 if a job was assigned, 0 if none is left
+ */
+static int mb_assign(sm4_mb_lane *lane, size_t d, size_t lanes, uint32_t *rk_lanes,
+                     const SM4_CBC_JOB *jobs, size_t njobs, size_t *next)
+{
+    while (*next < njobs) {
+        const SM4_CBC_JOB *job = &jobs[(*next)++];
+
+        if (job->length < SM4_BLOCK_SIZE) {
+            continue;
+        }
+
+        lane->job = job;
+        lane->in = job->input;
+        lane->out = job->output;
+        lane->chain = job->iv;
+        lane->nblocks = job->length / SM4_BLOCK_SIZE;
+        for (size_t i = 0; i < SM4_KEY_SCHEDULE; i++) {
+            rk_lanes[i * lanes + d] = job->rk[i];
+        }
+        return 1;
+    }
+
+    lane->job = NULL;
+    return 0;
+}
+
+/**
+ * Encrypt njobs independent CBC streams. Like sm4_cbc_encrypt(), each job
+ * processes length / 16 whole blocks; output may equal input.
+ */
+void sm4_cbc_encrypt_mb(const SM4_CBC_JOB *jobs, size_t njobs)
+{
+    const SM4_BACKEND *backend = sm4_backend();
+    size_t lanes = backend->lanes;
+    uint32_t rk_lanes[SM4_KEY_SCHEDULE * SM4_MB_MAX_LANES];
+    uint8_t buf[SM4_MB_MAX_LANES * SM4_BLOCK_SIZE];
+    sm4_mb_lane lane[SM4_MB_MAX_LANES];
+    size_t next = 0, active = 0;
+
+    if (backend->crypt_lanes == NULL) {
+        /* No multi-key kernel: one stream after the other */
+        for (size_t j = 0; j < njobs; j++) {
+            sm4_cbc_encrypt(jobs[j].rk, jobs[j].iv, jobs[j].input, jobs[j].output, jobs[j].length);
+        }
+        return;
+    }
+
+    memset(rk_lanes, 0, sizeof(rk_lanes));
+    memset(buf, 0, sizeof(buf));
+    for (size_t d = 0; d < lanes; d++) {
+        active += mb_assign(&lane[d], d, lanes, rk_lanes, jobs, njobs, &next);
+    }
+
+    /* A single remaining stream gains nothing from the wide kernel */
+    while (active > 1) {
+        for (size_t d = 0; d < lanes; d++) {
+            uint8_t *blk = buf + SM4_LANE_BLOCK(lanes, d) * SM4_BLOCK_SIZE;
+
+            if (lane[d].job) {
+                xor_block(blk, lane[d].in, lane[d].chain);
+            }
+        }
+
+        backend->crypt_lanes(rk_lanes, buf, buf);
+
+        for (size_t d = 0; d < lanes; d++) {
+            const uint8_t *blk = buf + SM4_LANE_BLOCK(lanes, d) * SM4_BLOCK_SIZE;
+
+            if (lane[d].job == NULL) {
+                continue;
+            }
+
+            memcpy(lane[d].out, blk, SM4_BLOCK_SIZE);
+            lane[d].chain = lane[d].out;
+            lane[d].in += SM4_BLOCK_SIZE;
+            lane[d].out += SM4_BLOCK_SIZE;
+
+            if (--lane[d].nblocks == 0) {
+                active -= !mb_assign(&lane[d], d, lanes, rk_lanes, jobs, njobs, &next);
+            }
+        }
+    }
+
+    for (size_t d = 0; d < lanes; d++) {
+        if (lane[d].job) {
+            sm4_cbc_encrypt(lane[d].job->rk, lane[d].chain, lane[d].in, lane[d].out,
+                            lane[d].nblocks * SM4_BLOCK_SIZE);
+        }
+    }
+
+    memset(buf, 0, sizeof(buf));
+    memset(rk_lanes, 0, sizeof(rk_lanes));
+}
@@ -0,0 +1,336 @@
+/**
+ * SM4-CCM mode implementation (NIST SP 800-38C, RFC 8998)
+ *
+ * CBC-MAC is inherently serial, but each of its block encryptions is
+ * independent of the CTR keystream block for the same position. Both are
+ * encrypted in one two-block call to the multi-block core, so a record is
+ * read once and costs one cipher pass per block instead of two.
+ *
+ * The MAC state is kept as Y ^ (bytes of the block being absorbed), the
+ * pending block is encrypted together with the next keystream block.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "../include/sm4_ccm.h"
+#include "../include/sm4_impl.h"
+
+/**
+ * Encrypt the pending MAC block and the next counter block together
+ * mac = E(mac), ks = E(counter), counter++
+ */
+static void ccm_mac_ctr_step(SM4_CCM_CTX *ctx, uint8_t ks[SM4_BLOCK_SIZE])
+{
+    uint8_t blocks[2 * SM4_BLOCK_SIZE];
+
+    if (sm4_backend()->crypt_block == NULL) {
+        /* A short call costs a full pass of the bit-sliced core: use the rounds */
+        sm4_encrypt(ctx->rk, ctx->mac, ctx->mac);
+        sm4_encrypt(ctx->rk, ctx->counter, ks);
+    } else {
+        memcpy(blocks, ctx->mac, SM4_BLOCK_SIZE);
+        memcpy(blocks + SM4_BLOCK_SIZE, ctx->counter, SM4_BLOCK_SIZE);
+        sm4_encrypt_blocks(ctx->rk, blocks, blocks, 2);
+        memcpy(ctx->mac, blocks, SM4_BLOCK_SIZE);
+        memcpy(ks, blocks + SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+        memset(blocks, 0, sizeof(blocks));
+    }
+
+    /* The counter field is the last L bytes, the length limit prevents overflow */
+    for (int i = SM4_BLOCK_SIZE - 1; i > 15 - (int)ctx->L; i--) {
+        if (++ctx->counter[i] != 0) {
+            break;
+        }
+    }
+    ctx->mac_used = 0;
+}
+
+/**
+ * XOR bytes into the MAC state, encrypting every completed block
+ */
+static void ccm_mac_absorb(SM4_CCM_CTX *ctx, const uint8_t *in, size_t len)
+{
+    while (len) {
+        if (ctx->mac_used == SM4_BLOCK_SIZE) {
+            sm4_encrypt(ctx->rk, ctx->mac, ctx->mac);
+            ctx->mac_used = 0;
+        }
+        while (len && ctx->mac_used < SM4_BLOCK_SIZE) {
+            ctx->mac[ctx->mac_used++] ^= *in++;
+            len--;
+        }
+    }
+}
+
+/* ============================================================
+ * Incremental API
+ * ============================================================ */
+
+/**
+ * Initialize CCM context. Lengths of AAD and payload are part of the first
+ * MAC block and must be known in advance.
+ * nonce_len: 7..13 (12 for RFC 8998), tag_len: 4, 6, ..., 16
+ * @return 1 on success, 0 on invalid parameters
+ */
+int sm4_ccm_init(SM4_CCM_CTX *ctx, const uint8_t key[SM4_KEY_SIZE],
+                 const uint8_t *nonce, size_t nonce_len,
+                 u8 aad_len, u8 msg_len, size_t tag_len)
+{
+    uint8_t hdr[10];
+    size_t L = 15 - nonce_len;
+    size_t hdr_len;
+
+    if (nonce_len < 7 || nonce_len > 13 ||
+        tag_len < 4 || tag_len > SM4_BLOCK_SIZE || (tag_len & 1)) {
+        return 0;
+    }
+    /* Payload length must fit in L bytes */
+    if (L < 8 && (msg_len >> (8 * L)) != 0) {
+        return 0;
+    }
+
+    memset(ctx, 0, sizeof(SM4_CCM_CTX));
+    sm4_key_schedule(key, ctx->rk);
+    ctx->L = L;
+    ctx->tag_len = tag_len;
+    ctx->aad_len = aad_len;
+    ctx->msg_len = msg_len;
+
+    /* B0 = flags || N || Q, pending in the MAC state */
+    ctx->mac[0] = (uint8_t)((aad_len ? 0x40 : 0) | (((tag_len - 2) / 2) << 3) | (L - 1));
+    memcpy(ctx->mac + 1, nonce, nonce_len);
+    for (size_t i = 0; i < L; i++) {
+        ctx->mac[15 - i] = (uint8_t)(msg_len >> (8 * i));
+    }
+    ctx->mac_used = SM4_BLOCK_SIZE;
+
+    /* A0 = (L - 1) || N || 0, S0 = E(A0) masks the tag */
+    ctx->counter[0] = (uint8_t)(L - 1);
+    memcpy(ctx->counter + 1, nonce, nonce_len);
+    sm4_encrypt(ctx->rk, ctx->counter, ctx->s0);
+    ctx->counter[15] = 1;
+    ctx->buffer_used = SM4_BLOCK_SIZE;
+
+    /* AAD length encoding */
+    if (aad_len) {
+        if (aad_len < 0xFF00) {
+            hdr[0] = (uint8_t)(aad_len >> 8);
+            hdr[1] = (uint8_t)aad_len;
+            hdr_len = 2;
+        } else if ((aad_len >> 32) == 0) {
+            hdr[0] = 0xFF;
+            hdr[1] = 0xFE;
+            for (int i = 0; i < 4; i++) {
+                hdr[2 + i] = (uint8_t)(aad_len >> (24 - 8 * i));
+            }
+            hdr_len = 6;
+        } else {
+            hdr[0] = 0xFF;
+            hdr[1] = 0xFF;
+            for (int i = 0; i < 8; i++) {
+                hdr[2 + i] = (uint8_t)(aad_len >> (56 - 8 * i));
+            }
+            hdr_len = 10;
+        }
+        ccm_mac_absorb(ctx, hdr, hdr_len);
+    }
+
+    return 1;
+}
+
+/**
+ * Add additional authenticated data, aad_len bytes in total before any text
+ * @return 1 on success, 0 if more than the declared length is supplied
+ */
+int sm4_ccm_update_aad(SM4_CCM_CTX *ctx, const uint8_t *aad, size_t len)
+{
+    if (len > ctx->aad_len - ctx->aad_done) {
+        return 0;
+    }
+
+    ccm_mac_absorb(ctx, aad, len);
+    ctx->aad_done += len;
+
+    /* Zero padding of the last AAD block is implicit */
+    if (ctx->aad_done == ctx->aad_len && ctx->aad_len) {
+        ctx->mac_used = SM4_BLOCK_SIZE;
+    }
+
+    return 1;
+}
+
+static int sm4_ccm_update(SM4_CCM_CTX *ctx, const uint8_t *in, uint8_t *out,
+                          size_t len, int enc)
+{
+    size_t i = 0;
+
+    if (ctx->aad_done != ctx->aad_len || len > ctx->msg_len - ctx->msg_done) {
+        return 0;
+    }
+    ctx->msg_done += len;
+
+    while (i < len) {
+        /* Start of a block: finish the MAC block before, get keystream */
+        if (ctx->buffer_used == SM4_BLOCK_SIZE) {
+            ccm_mac_ctr_step(ctx, ctx->buffer);
+            ctx->buffer_used = 0;
+        }
+
+        /* Whole block fast path */
+        if (ctx->buffer_used == 0 && len - i >= SM4_BLOCK_SIZE) {
+            for (size_t j = 0; j < SM4_BLOCK_SIZE; j++) {
+                uint8_t c = in[i + j];
+                uint8_t p = c ^ ctx->buffer[j];
+
+                out[i + j] = p;
+                ctx->mac[j] ^= enc ? c : p;
+            }
+            ctx->mac_used = SM4_BLOCK_SIZE;
+            ctx->buffer_used = SM4_BLOCK_SIZE;
+            i += SM4_BLOCK_SIZE;
+            continue;
+        }
+
+        while (i < len && ctx->buffer_used < SM4_BLOCK_SIZE) {
+            uint8_t c = in[i];
+            uint8_t p = c ^ ctx->buffer[ctx->buffer_used];
+
+            out[i] = p;
+            ctx->mac[ctx->buffer_used++] ^= enc ? c : p;
+            ctx->mac_used = ctx->buffer_used;
+            i++;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Encrypt payload, supports streaming up to the declared length
+ * @return 1 on success, 0 on length or ordering errors
+ */
+int sm4_ccm_encrypt_update(SM4_CCM_CTX *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    return sm4_ccm_update(ctx, in, out, len, 1);
+}
+
+/**
+ * Decrypt payload, supports streaming. Output must not be used before
+ * sm4_ccm_decrypt_final() succeeds.
+ */
+int sm4_ccm_decrypt_update(SM4_CCM_CTX *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    return sm4_ccm_update(ctx, in, out, len, 0);
+}
+
+static int sm4_ccm_tag(SM4_CCM_CTX *ctx, uint8_t tag[SM4_BLOCK_SIZE])
+{
+    if (ctx->aad_done != ctx->aad_len || ctx->msg_done != ctx->msg_len) {
+        return 0;
+    }
+
+    /* A pending partial block is implicitly zero padded */
+    if (ctx->mac_used) {
+        sm4_encrypt(ctx->rk, ctx->mac, ctx->mac);
+        ctx->mac_used = 0;
+    }
+    for (int i = 0; i < (int)SM4_BLOCK_SIZE; i++) {
+        tag[i] = ctx->mac[i] ^ ctx->s0[i];
+    }
+
+    return 1;
+}
+
+/**
+ * Produce the tag_len byte authentication tag
+ * @return 1 on success, 0 if AAD or payload are incomplete
+ */
+int sm4_ccm_encrypt_final(SM4_CCM_CTX *ctx, uint8_t *tag)
+{
+    uint8_t full[SM4_BLOCK_SIZE];
+
+    if (!sm4_ccm_tag(ctx, full)) {
+        return 0;
+    }
+    memcpy(tag, full, ctx->tag_len);
+    memset(full, 0, sizeof(full));
+
+    return 1;
+}
+
+/**
+ * Check the tag_len byte authentication tag in constant time
+ * @return 1 if the tag is valid, 0 otherwise
+ */
+int sm4_ccm_decrypt_final(SM4_CCM_CTX *ctx, const uint8_t *tag)
+{
+    uint8_t full[SM4_BLOCK_SIZE];
+    uint8_t diff = 0;
+
+    if (!sm4_ccm_tag(ctx, full)) {
+        return 0;
+    }
+    for (size_t i = 0; i < ctx->tag_len; i++) {
+        diff |= full[i] ^ tag[i];
+    }
+    memset(full, 0, sizeof(full));
+
+    return diff == 0;
+}
+
+/**
+ * Clear sensitive data from context
+ */
+void sm4_ccm_clean(SM4_CCM_CTX *ctx)
+{
+    memset(ctx, 0, sizeof(SM4_CCM_CTX));
+}
+
+/* ============================================================
+ * Convenience functions for one-shot encryption/decryption
+ * ============================================================ */
+
+/**
+ * One-shot CCM encryption
+ * @return 1 on success, 0 on invalid parameters
+ */
+int sm4_ccm_encrypt(const uint8_t key[SM4_KEY_SIZE], const uint8_t *nonce, size_t nonce_len,
+                    const uint8_t *aad, size_t aad_len, const uint8_t *input, size_t len,
+                    uint8_t *output, uint8_t *tag, size_t tag_len)
+{
+    SM4_CCM_CTX ctx;
+    int ret;
+
+    ret = sm4_ccm_init(&ctx, key, nonce, nonce_len, aad_len, len, tag_len) &&
+          sm4_ccm_update_aad(&ctx, aad, aad_len) &&
+          sm4_ccm_encrypt_update(&ctx, input, output, len) &&
+          sm4_ccm_encrypt_final(&ctx, tag);
+    sm4_ccm_clean(&ctx);
+
+    return ret;
+}
+
+/**
+ * One-shot CCM decryption, output is wiped when the tag does not verify
+ * @return 1 if the tag is valid, 0 otherwise
+ */
+int sm4_ccm_decrypt(const uint8_t key[SM4_KEY_SIZE], const uint8_t *nonce, size_t nonce_len,
+                    const uint8_t *aad, size_t aad_len, const uint8_t *input, size_t len,
+                    uint8_t *output, const uint8_t *tag, size_t tag_len)
+{
+    SM4_CCM_CTX ctx;
+    int ret;
+
+    ret = sm4_ccm_init(&ctx, key, nonce, nonce_len, aad_len, len, tag_len) &&
+          sm4_ccm_update_aad(&ctx, aad, aad_len) &&
+          sm4_ccm_decrypt_update(&ctx, input, output, len) &&
+          sm4_ccm_decrypt_final(&ctx, tag);
+    sm4_ccm_clean(&ctx);
+
+    if (!ret) {
+        memset(output, 0, len);
+    }
+
+    return ret;
+}
@@ -1,37 +1,177 @@
 /**
  * SM4-CTR mode implementation
+ *
+ * Keystream is generated for a batch of counter blocks at a time: the
+ * counters are laid out with 64-bit adds (AVX2 builds two blocks per
+ * register), the whole batch goes through the multi-block core, and the
+ * input is XORed in 32-byte words. Counters are either the full 128-bit
+ * block or, for sm4_ctr32_init(), only its low 32 bits as in GCM.
  */
 
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
 #include "../include/sm4_ctr.h"
+#include "../include/sm4_impl.h"
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+#include <immintrin.h>
+
+#define SM4_CTR_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+/* Counter blocks encrypted per call to the multi-block core */
+#define SM4_CTR_BATCH_BLOCKS 16
+
+static uint64_t load_u64_be(const uint8_t *p)
+{
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+           ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+           ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+           ((uint64_t)p[6] << 8)  | ((uint64_t)p[7]);
+}
+
+static void store_u64_be(uint8_t *p, uint64_t v)
+{
+    p[0] = (uint8_t)(v >> 56);
+    p[1] = (uint8_t)(v >> 48);
+    p[2] = (uint8_t)(v >> 40);
+    p[3] = (uint8_t)(v >> 32);
+    p[4] = (uint8_t)(v >> 24);
+    p[5] = (uint8_t)(v >> 16);
+    p[6] = (uint8_t)(v >> 8);
+    p[7] = (uint8_t)v;
+}
 
 /**
- * Increment 128-bit counter (big-endian)
- * Standard CTR mode increments the entire 128-bit block
+ * Counter block + n, big-endian, as two 64-bit words
+ * ctr32 keeps the upper 96 bits and wraps the low 32 bits
  */
-static void ctr_inc(uint8_t counter[SM4_BLOCK_SIZE])
+static inline void ctr_add(uint64_t *hi, uint64_t *lo, uint64_t n, int ctr32)
 {
-    for (int i = SM4_BLOCK_SIZE - 1; i >= 0; i--) {
-        if (++counter[i] != 0) {
-            break;
-        }
+    if (ctr32) {
+        *lo = (*lo & 0xFFFFFFFF00000000ULL) | (uint32_t)(*lo + n);
+    } else {
+        *lo += n;
+        *hi += *lo < n;
     }
 }
 
 /**
- * XOR two buffers: dst = a ^ b
+ * XOR two buffers: dst = a ^ b, in 32-byte steps of 64-bit words
  */
-static void xor_block(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t len)
+static void xor_bytes(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t len)
 {
-    for (size_t i = 0; i < len; i++) {
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        uint64_t x[4], y[4];
+
+        memcpy(x, a + i, 32);
+        memcpy(y, b + i, 32);
+        x[0] ^= y[0];
+        x[1] ^= y[1];
+        x[2] ^= y[2];
+        x[3] ^= y[3];
+        memcpy(dst + i, x, 32);
+    }
+    for (; i < len; i++) {
         dst[i] = a[i] ^ b[i];
     }
 }
 
+#ifdef YCRYPT_HAVE_X86_SIMD
 /**
- * Initialize CTR context
+ * Write nblocks counters hi:lo + j without carry out of the low word,
+ * two blocks per 256-bit register
+ */
+SM4_CTR_AVX2_TARGET
+static void ctr_fill_avx2(uint8_t *ctrs, uint64_t hi, uint64_t lo, size_t nblocks)
+{
+    const __m256i bswap = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m256i step = _mm256_set_epi64x(0, 2, 0, 2);
+    __m256i v = _mm256_add_epi64(_mm256_set_epi64x((long long)hi, (long long)lo,
+                                                   (long long)hi, (long long)lo),
+                                 _mm256_set_epi64x(0, 1, 0, 0));
+    size_t b = 0;
+
+    for (; b + 2 <= nblocks; b += 2) {
+        _mm256_storeu_si256((__m256i *)(ctrs + b * SM4_BLOCK_SIZE), _mm256_shuffle_epi8(v, bswap));
+        v = _mm256_add_epi64(v, step);
+    }
+    if (b < nblocks) {
+        _mm_storeu_si128((__m128i *)(ctrs + b * SM4_BLOCK_SIZE),
+                         _mm256_castsi256_si128(_mm256_shuffle_epi8(v, bswap)));
+    }
+}
+
+/**
+ * dst = a ^ b, 64 bytes per iteration
+ */
+SM4_CTR_AVX2_TARGET
+static void xor_bytes_avx2(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(a + i + 32));
+
+        x0 = _mm256_xor_si256(x0, _mm256_loadu_si256((const __m256i *)(b + i)));
+        x1 = _mm256_xor_si256(x1, _mm256_loadu_si256((const __m256i *)(b + i + 32)));
+        _mm256_storeu_si256((__m256i *)(dst + i), x0);
+        _mm256_storeu_si256((__m256i *)(dst + i + 32), x1);
+    }
+    xor_bytes(dst + i, a + i, b + i, len - i);
+}
+#endif
+
+/**
+ * Lay out the next nblocks counter blocks and advance ctx->counter past them
+ */
+static void ctr_fill(SM4_CTR_CTX *ctx, uint8_t *ctrs, size_t nblocks)
+{
+    uint64_t hi = load_u64_be(ctx->counter);
+    uint64_t lo = load_u64_be(ctx->counter + 8);
+    uint64_t room = ctx->ctr32 ? 0xFFFFFFFFULL - (uint32_t)lo : ~lo;
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+    /* A batch that wraps the counter takes the word-at-a-time path */
+    if (ctx->simd && nblocks - 1 <= room) {
+        ctr_fill_avx2(ctrs, hi, lo, nblocks);
+        ctr_add(&hi, &lo, nblocks, ctx->ctr32);
+        store_u64_be(ctx->counter, hi);
+        store_u64_be(ctx->counter + 8, lo);
+        return;
+    }
+#endif
+    (void)room;
+
+    for (size_t b = 0; b < nblocks; b++) {
+        store_u64_be(ctrs + b * SM4_BLOCK_SIZE, hi);
+        store_u64_be(ctrs + b * SM4_BLOCK_SIZE + 8, lo);
+        ctr_add(&hi, &lo, 1, ctx->ctr32);
+    }
+    store_u64_be(ctx->counter, hi);
+    store_u64_be(ctx->counter + 8, lo);
+}
+
+static void ctr_xor(const SM4_CTR_CTX *ctx, uint8_t *dst, const uint8_t *a,
+                    const uint8_t *b, size_t len)
+{
+#ifdef YCRYPT_HAVE_X86_SIMD
+    if (ctx->simd) {
+        xor_bytes_avx2(dst, a, b, len);
+        return;
+    }
+#endif
+    (void)ctx;
+    xor_bytes(dst, a, b, len);
+}
+
+/**
+ * Initialize CTR context, the whole 128-bit block is the counter
  */
 void sm4_ctr_init(SM4_CTR_CTX *ctx, const uint8_t key[SM4_KEY_SIZE],
                   const uint8_t iv[SM4_BLOCK_SIZE])
@@ -39,6 +179,23 @@ void sm4_ctr_init(SM4_CTR_CTX *ctx, const uint8_t key[SM4_KEY_SIZE],
     sm4_key_schedule(key, ctx->rk);
     memcpy(ctx->counter, iv, SM4_BLOCK_SIZE);
     ctx->buffer_used = SM4_BLOCK_SIZE; /* Force buffer generation on first use */
+    ctx->ctr32 = 0;
+#ifdef YCRYPT_HAVE_X86_SIMD
+    ctx->simd = (ycrypt_cpu_features() & YCRYPT_CPU_AVX2) != 0;
+#else
+    ctx->simd = 0;
+#endif
+}
+
+/**
+ * Initialize CTR context with a 32-bit counter in the last 4 bytes of iv,
+ * the first 12 bytes stay fixed and the counter wraps modulo 2^32
+ */
+void sm4_ctr32_init(SM4_CTR_CTX *ctx, const uint8_t key[SM4_KEY_SIZE],
+                    const uint8_t iv[SM4_BLOCK_SIZE])
+{
+    sm4_ctr_init(ctx, key, iv);
+    ctx->ctr32 = 1;
 }
 
 /**
@@ -56,25 +213,32 @@ void sm4_ctr_update(SM4_CTR_CTX *ctx, const uint8_t *in, uint8_t *out, size_t le
         ctx->buffer_used++;
     }
 
-    /* Process full blocks */
-    while (i + SM4_BLOCK_SIZE <= len) {
-        sm4_encrypt(ctx->rk, ctx->counter, ctx->buffer);
-        ctr_inc(ctx->counter);
-        xor_block(out + i, in + i, ctx->buffer, SM4_BLOCK_SIZE);
-        i += SM4_BLOCK_SIZE;
-    }
+    /*
+     * Process the rest in batches of counter blocks. A trailing partial
+     * block joins the last batch, its keystream is kept in ctx->buffer.
+     */
+    while (i < len) {
+        uint8_t ks[SM4_CTR_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+        size_t nblocks = (len - i + SM4_BLOCK_SIZE - 1) / SM4_BLOCK_SIZE;
+        size_t nbytes;
 
-    /* Handle remaining bytes */
-    if (i < len) {
-        sm4_encrypt(ctx->rk, ctx->counter, ctx->buffer);
-        ctr_inc(ctx->counter);
-        ctx->buffer_used = 0;
+        if (nblocks > SM4_CTR_BATCH_BLOCKS) {
+            nblocks = SM4_CTR_BATCH_BLOCKS;
+        }
+        /* Counters are encrypted in place into keystream */
+        ctr_fill(ctx, ks, nblocks);
+        sm4_encrypt_blocks(ctx->rk, ks, ks, nblocks);
 
-        while (i < len) {
-            out[i] = in[i] ^ ctx->buffer[ctx->buffer_used];
-            i++;
-            ctx->buffer_used++;
+        nbytes = nblocks * SM4_BLOCK_SIZE;
+        if (nbytes > len - i) {
+            nbytes = len - i;
+            memcpy(ctx->buffer, ks + (nblocks - 1) * SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+            ctx->buffer_used = nbytes - (nblocks - 1) * SM4_BLOCK_SIZE;
         }
+        ctr_xor(ctx, out + i, in + i, ks, nbytes);
+        i += nbytes;
+
+        memset(ks, 0, sizeof(ks));
     }
 }
 
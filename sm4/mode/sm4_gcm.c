@@ -0,0 +1,667 @@
+/**
+ * SM4-GCM mode implementation (NIST SP 800-38D, RFC 8998)
+ *
+ * The CTR keystream is produced by the multi-block SM4 core in batches of
+ * counter blocks, and every batch is hashed while it is still in cache.
+ * GHASH uses PCLMULQDQ with four-block aggregated reduction when the CPU
+ * has it, otherwise the portable 4-bit table method (Shoup).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "../include/sm4_gcm.h"
+#include "../include/sm4_impl.h"
+
+/* Blocks of keystream generated and hashed per batch */
+#define SM4_GCM_BATCH_BLOCKS 16
+
+/* At most 2^32 - 2 blocks of plaintext per IV */
+#define SM4_GCM_MAX_MSG_LEN  ((((u8)1 << 32) - 2) * SM4_BLOCK_SIZE)
+
+#define GHASH_IMPL_4BIT   0
+#define GHASH_IMPL_CLMUL  1
+
+static inline u8 load_u64_be(const uint8_t *b)
+{
+    return ((u8)b[0] << 56) | ((u8)b[1] << 48) | ((u8)b[2] << 40) | ((u8)b[3] << 32) |
+           ((u8)b[4] << 24) | ((u8)b[5] << 16) | ((u8)b[6] << 8) | (u8)b[7];
+}
+
+static inline void store_u64_be(u8 v, uint8_t *b)
+{
+    for (int i = 7; i >= 0; i--) {
+        b[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/**
+ * Increment the low 32 bits of the counter block (big-endian), inc32()
+ */
+static inline void gcm_inc32(uint8_t counter[SM4_BLOCK_SIZE])
+{
+    for (int i = SM4_BLOCK_SIZE - 1; i >= 12; i--) {
+        if (++counter[i] != 0) {
+            break;
+        }
+    }
+}
+
+/* ============================================================
+ * Portable GHASH, 4-bit tables
+ * Htable[i] = i * H, elements as (hi, lo) 64-bit halves
+ * ============================================================ */
+
+#define GHASH_REDUCE1BIT(hi, lo)                                \
+    do {                                                        \
+        u8 t_ = 0xE100000000000000ULL & (0 - (lo & 1));         \
+        lo = (hi << 63) | (lo >> 1);                            \
+        hi = (hi >> 1) ^ t_;                                    \
+    } while (0)
+
+/* Reduction of the 4 bits shifted out of Z, pre-shifted to the top */
+static const u8 ghash_rem_4bit[16] = {
+    0x0000ULL << 48, 0x1C20ULL << 48, 0x3840ULL << 48, 0x2460ULL << 48,
+    0x7080ULL << 48, 0x6CA0ULL << 48, 0x48C0ULL << 48, 0x54E0ULL << 48,
+    0xE100ULL << 48, 0xFD20ULL << 48, 0xD940ULL << 48, 0xC560ULL << 48,
+    0x9180ULL << 48, 0x8DA0ULL << 48, 0xA9C0ULL << 48, 0xB5E0ULL << 48
+};
+
+static void ghash_init_4bit(u8 Htable[16][2], const uint8_t H[SM4_BLOCK_SIZE])
+{
+    u8 hi = load_u64_be(H), lo = load_u64_be(H + 8);
+
+    Htable[0][0] = 0;
+    Htable[0][1] = 0;
+    Htable[8][0] = hi;
+    Htable[8][1] = lo;
+    GHASH_REDUCE1BIT(hi, lo);
+    Htable[4][0] = hi;
+    Htable[4][1] = lo;
+    GHASH_REDUCE1BIT(hi, lo);
+    Htable[2][0] = hi;
+    Htable[2][1] = lo;
+    GHASH_REDUCE1BIT(hi, lo);
+    Htable[1][0] = hi;
+    Htable[1][1] = lo;
+
+    /* Remaining entries by linearity */
+    for (int i = 2; i < 16; i <<= 1) {
+        for (int j = 1; j < i; j++) {
+            Htable[i + j][0] = Htable[i][0] ^ Htable[j][0];
+            Htable[i + j][1] = Htable[i][1] ^ Htable[j][1];
+        }
+    }
+}
+
+/**
+ * X = X * H
+ */
+static void ghash_gmult_4bit(uint8_t X[SM4_BLOCK_SIZE], const u8 Htable[16][2])
+{
+    u8 zhi, zlo, rem;
+    int nlo, nhi, cnt = 15;
+
+    nlo = X[15] & 0xF;
+    nhi = X[15] >> 4;
+    zhi = Htable[nlo][0];
+    zlo = Htable[nlo][1];
+
+    for (;;) {
+        rem = zlo & 0xF;
+        zlo = (zhi << 60) | (zlo >> 4);
+        zhi = (zhi >> 4) ^ ghash_rem_4bit[rem];
+        zhi ^= Htable[nhi][0];
+        zlo ^= Htable[nhi][1];
+
+        if (--cnt < 0) {
+            break;
+        }
+
+        nlo = X[cnt] & 0xF;
+        nhi = X[cnt] >> 4;
+
+        rem = zlo & 0xF;
+        zlo = (zhi << 60) | (zlo >> 4);
+        zhi = (zhi >> 4) ^ ghash_rem_4bit[rem];
+        zhi ^= Htable[nlo][0];
+        zlo ^= Htable[nlo][1];
+    }
+
+    store_u64_be(zhi, X);
+    store_u64_be(zlo, X + 8);
+}
+
+static void ghash_4bit(uint8_t X[SM4_BLOCK_SIZE], const u8 Htable[16][2],
+                       const uint8_t *in, size_t len)
+{
+    while (len >= SM4_BLOCK_SIZE) {
+        for (int i = 0; i < (int)SM4_BLOCK_SIZE; i++) {
+            X[i] ^= in[i];
+        }
+        ghash_gmult_4bit(X, Htable);
+        in += SM4_BLOCK_SIZE;
+        len -= SM4_BLOCK_SIZE;
+    }
+}
+
+/* ============================================================
+ * PCLMULQDQ GHASH
+ * Elements are kept byte-reflected; Htable[0..3] hold H^1 .. H^4
+ * ============================================================ */
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+#define GHASH_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+
+GHASH_CLMUL_TARGET
+static inline __m128i ghash_bswap(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/**
+ * 256-bit carry-less product a * b = hi:lo, accumulated
+ */
+GHASH_CLMUL_TARGET
+static inline void ghash_clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                             _mm_clmulepi64_si128(a, b, 0x01)));
+}
+
+/**
+ * Reduce the reflected 256-bit product lo, mid, hi modulo
+ * x^128 + x^7 + x^2 + x + 1 (Intel white paper, shift-left-by-one variant)
+ */
+GHASH_CLMUL_TARGET
+static inline __m128i ghash_clmul_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t2, t7, t8, t9;
+
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    /* Shift hi:lo left by one bit */
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+    /* First phase */
+    t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+                       _mm_slli_epi32(lo, 25));
+    t8 = _mm_srli_si128(t7, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t7, 12));
+
+    /* Second phase */
+    t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+                       _mm_srli_epi32(lo, 7));
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+
+    return _mm_xor_si128(hi, lo);
+}
+
+GHASH_CLMUL_TARGET
+static inline __m128i ghash_clmul_mul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    ghash_clmul_acc(a, b, &lo, &mid, &hi);
+    return ghash_clmul_reduce(lo, mid, hi);
+}
+
+GHASH_CLMUL_TARGET
+static void ghash_init_clmul(u8 Htable[16][2], const uint8_t H[SM4_BLOCK_SIZE])
+{
+    __m128i h = ghash_bswap(_mm_loadu_si128((const __m128i *)H));
+    __m128i hp = h;
+
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i *)Htable[i], hp);
+        hp = ghash_clmul_mul(hp, h);
+    }
+}
+
+GHASH_CLMUL_TARGET
+static void ghash_gmult_clmul(uint8_t X[SM4_BLOCK_SIZE], const u8 Htable[16][2])
+{
+    __m128i x = ghash_bswap(_mm_loadu_si128((const __m128i *)X));
+
+    x = ghash_clmul_mul(x, _mm_loadu_si128((const __m128i *)Htable[0]));
+    _mm_storeu_si128((__m128i *)X, ghash_bswap(x));
+}
+
+GHASH_CLMUL_TARGET
+static void ghash_clmul(uint8_t X[SM4_BLOCK_SIZE], const u8 Htable[16][2],
+                        const uint8_t *in, size_t len)
+{
+    const __m128i h1 = _mm_loadu_si128((const __m128i *)Htable[0]);
+    const __m128i h2 = _mm_loadu_si128((const __m128i *)Htable[1]);
+    const __m128i h3 = _mm_loadu_si128((const __m128i *)Htable[2]);
+    const __m128i h4 = _mm_loadu_si128((const __m128i *)Htable[3]);
+    __m128i x = ghash_bswap(_mm_loadu_si128((const __m128i *)X));
+    __m128i lo, mid, hi;
+
+    /* X' = (X + C1) H^4 + C2 H^3 + C3 H^2 + C4 H, one reduction */
+    while (len >= 4 * SM4_BLOCK_SIZE) {
+        lo = mid = hi = _mm_setzero_si128();
+        x = _mm_xor_si128(x, ghash_bswap(_mm_loadu_si128((const __m128i *)in)));
+        ghash_clmul_acc(x, h4, &lo, &mid, &hi);
+        ghash_clmul_acc(ghash_bswap(_mm_loadu_si128((const __m128i *)(in + 16))), h3, &lo, &mid, &hi);
+        ghash_clmul_acc(ghash_bswap(_mm_loadu_si128((const __m128i *)(in + 32))), h2, &lo, &mid, &hi);
+        ghash_clmul_acc(ghash_bswap(_mm_loadu_si128((const __m128i *)(in + 48))), h1, &lo, &mid, &hi);
+        x = ghash_clmul_reduce(lo, mid, hi);
+        in += 4 * SM4_BLOCK_SIZE;
+        len -= 4 * SM4_BLOCK_SIZE;
+    }
+
+    while (len >= SM4_BLOCK_SIZE) {
+        x = _mm_xor_si128(x, ghash_bswap(_mm_loadu_si128((const __m128i *)in)));
+        x = ghash_clmul_mul(x, h1);
+        in += SM4_BLOCK_SIZE;
+        len -= SM4_BLOCK_SIZE;
+    }
+
+    _mm_storeu_si128((__m128i *)X, ghash_bswap(x));
+}
+
+#endif /* YCRYPT_HAVE_X86_SIMD */
+
+/* ============================================================
+ * GHASH dispatch
+ * ============================================================ */
+
+static void gcm_gmult(SM4_GCM_CTX *ctx)
+{
+#ifdef YCRYPT_HAVE_X86_SIMD
+    if (ctx->ghash_impl == GHASH_IMPL_CLMUL) {
+        ghash_gmult_clmul(ctx->X, (const u8 (*)[2])ctx->Htable);
+        return;
+    }
+#endif
+    ghash_gmult_4bit(ctx->X, (const u8 (*)[2])ctx->Htable);
+}
+
+/**
+ * Absorb whole blocks, len must be a multiple of the block size
+ */
+static void gcm_ghash(SM4_GCM_CTX *ctx, const uint8_t *in, size_t len)
+{
+#ifdef YCRYPT_HAVE_X86_SIMD
+    if (ctx->ghash_impl == GHASH_IMPL_CLMUL) {
+        ghash_clmul(ctx->X, (const u8 (*)[2])ctx->Htable, in, len);
+        return;
+    }
+#endif
+    ghash_4bit(ctx->X, (const u8 (*)[2])ctx->Htable, in, len);
+}
+
+/**
+ * Close a partial AAD block before the first byte of text
+ */
+static void gcm_finish_aad(SM4_GCM_CTX *ctx)
+{
+    if (!ctx->aad_done) {
+        if (ctx->aad_len % SM4_BLOCK_SIZE) {
+            gcm_gmult(ctx);
+        }
+        ctx->aad_done = 1;
+    }
+}
+
+/* ============================================================
+ * GHASH selection
+ * ============================================================ */
+
+static _Atomic int gcm_ghash_forced = SM4_GHASH_IMPL_AUTO;
+
+static int gcm_clmul_usable(void)
+{
+#ifdef YCRYPT_HAVE_X86_SIMD
+    unsigned int f = ycrypt_cpu_features();
+
+    return (f & YCRYPT_CPU_PCLMUL) && (f & YCRYPT_CPU_SSSE3);
+#else
+    return 0;
+#endif
+}
+
+int sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL impl)
+{
+    if (impl != SM4_GHASH_IMPL_AUTO && impl != SM4_GHASH_IMPL_PORTABLE &&
+        impl != SM4_GHASH_IMPL_CLMUL) {
+        return 0;
+    }
+    if (impl == SM4_GHASH_IMPL_CLMUL && !gcm_clmul_usable()) {
+        return 0;
+    }
+    atomic_store_explicit(&gcm_ghash_forced, (int)impl, memory_order_relaxed);
+
+    return 1;
+}
+
+/* ============================================================
+ * Streaming API
+ * ============================================================ */
+
+/**
+ * Initialize GCM context with key and IV (any non-zero length, 12 bytes recommended)
+ * @return 1 on success, 0 on invalid IV length
+ */
+int sm4_gcm_init(SM4_GCM_CTX *ctx, const uint8_t key[SM4_KEY_SIZE],
+                 const uint8_t *iv, size_t iv_len)
+{
+    uint8_t H[SM4_BLOCK_SIZE] = {0};
+
+    if (iv_len == 0) {
+        return 0;
+    }
+
+    memset(ctx, 0, sizeof(SM4_GCM_CTX));
+    sm4_key_schedule(key, ctx->rk);
+    sm4_encrypt(ctx->rk, H, H);
+
+    ctx->ghash_impl = GHASH_IMPL_4BIT;
+#ifdef YCRYPT_HAVE_X86_SIMD
+    if (atomic_load_explicit(&gcm_ghash_forced, memory_order_relaxed) != SM4_GHASH_IMPL_PORTABLE &&
+        gcm_clmul_usable()) {
+        ctx->ghash_impl = GHASH_IMPL_CLMUL;
+    }
+    if (ctx->ghash_impl == GHASH_IMPL_CLMUL) {
+        ghash_init_clmul(ctx->Htable, H);
+    } else
+#endif
+    {
+        ghash_init_4bit(ctx->Htable, H);
+    }
+
+    if (iv_len == 12) {
+        /* J0 = IV || 0^31 || 1 */
+        memcpy(ctx->J0, iv, 12);
+        ctx->J0[15] = 1;
+    } else {
+        /* J0 = GHASH(IV || 0^s || 0^64 || [len(IV)]_64) */
+        uint8_t last[SM4_BLOCK_SIZE] = {0};
+        size_t full = iv_len & ~(SM4_BLOCK_SIZE - 1);
+
+        gcm_ghash(ctx, iv, full);
+        if (iv_len > full) {
+            memcpy(last, iv + full, iv_len - full);
+            gcm_ghash(ctx, last, SM4_BLOCK_SIZE);
+            memset(last, 0, sizeof(last));
+        }
+        store_u64_be((u8)iv_len * 8, last + 8);
+        gcm_ghash(ctx, last, SM4_BLOCK_SIZE);
+        memcpy(ctx->J0, ctx->X, SM4_BLOCK_SIZE);
+        memset(ctx->X, 0, SM4_BLOCK_SIZE);
+    }
+
+    memcpy(ctx->counter, ctx->J0, SM4_BLOCK_SIZE);
+    gcm_inc32(ctx->counter);
+    ctx->buffer_used = SM4_BLOCK_SIZE;
+    memset(H, 0, sizeof(H));
+
+    return 1;
+}
+
+/**
+ * Add additional authenticated data, any number of calls before the first
+ * encrypt/decrypt update
+ * @return 1 on success, 0 if text was already processed
+ */
+int sm4_gcm_update_aad(SM4_GCM_CTX *ctx, const uint8_t *aad, size_t len)
+{
+    size_t n = (size_t)(ctx->aad_len % SM4_BLOCK_SIZE);
+    size_t full;
+
+    if (ctx->aad_done) {
+        return 0;
+    }
+    ctx->aad_len += len;
+
+    /* Complete a pending partial block */
+    if (n) {
+        while (len && n < SM4_BLOCK_SIZE) {
+            ctx->X[n++] ^= *aad++;
+            len--;
+        }
+        if (n < SM4_BLOCK_SIZE) {
+            return 1;
+        }
+        gcm_gmult(ctx);
+    }
+
+    full = len & ~(SM4_BLOCK_SIZE - 1);
+    gcm_ghash(ctx, aad, full);
+    aad += full;
+    len -= full;
+
+    for (size_t i = 0; i < len; i++) {
+        ctx->X[i] ^= aad[i];
+    }
+
+    return 1;
+}
+
+static int sm4_gcm_update(SM4_GCM_CTX *ctx, const uint8_t *in, uint8_t *out,
+                          size_t len, int enc)
+{
+    uint8_t ctrs[SM4_GCM_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+    uint8_t ks[SM4_GCM_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+    size_t i = 0;
+
+    if (len > SM4_GCM_MAX_MSG_LEN - ctx->msg_len) {
+        return 0;
+    }
+    gcm_finish_aad(ctx);
+    ctx->msg_len += len;
+
+    /* Use remaining keystream of a partial block; X collects ciphertext bytes */
+    while (i < len && ctx->buffer_used < SM4_BLOCK_SIZE) {
+        uint8_t c = enc ? (uint8_t)(in[i] ^ ctx->buffer[ctx->buffer_used]) : in[i];
+
+        out[i] = in[i] ^ ctx->buffer[ctx->buffer_used];
+        ctx->X[ctx->buffer_used++] ^= c;
+        i++;
+        if (ctx->buffer_used == SM4_BLOCK_SIZE) {
+            gcm_gmult(ctx);
+        }
+    }
+
+    /* Whole blocks: one batch of keystream, then GHASH of that batch */
+    while (len - i >= SM4_BLOCK_SIZE) {
+        size_t nblocks = (len - i) / SM4_BLOCK_SIZE;
+        size_t nbytes, j;
+
+        if (nblocks > SM4_GCM_BATCH_BLOCKS) {
+            nblocks = SM4_GCM_BATCH_BLOCKS;
+        }
+        nbytes = nblocks * SM4_BLOCK_SIZE;
+
+        for (j = 0; j < nblocks; j++) {
+            memcpy(ctrs + j * SM4_BLOCK_SIZE, ctx->counter, SM4_BLOCK_SIZE);
+            gcm_inc32(ctx->counter);
+        }
+        sm4_encrypt_blocks(ctx->rk, ctrs, ks, nblocks);
+
+        /* Hash ciphertext: the input before decrypting (in may equal out) */
+        if (!enc) {
+            gcm_ghash(ctx, in + i, nbytes);
+        }
+        for (j = 0; j < nbytes; j++) {
+            out[i + j] = in[i + j] ^ ks[j];
+        }
+        if (enc) {
+            gcm_ghash(ctx, out + i, nbytes);
+        }
+        i += nbytes;
+    }
+
+    /* Trailing partial block */
+    if (i < len) {
+        sm4_encrypt(ctx->rk, ctx->counter, ctx->buffer);
+        gcm_inc32(ctx->counter);
+        ctx->buffer_used = 0;
+
+        while (i < len) {
+            uint8_t c = enc ? (uint8_t)(in[i] ^ ctx->buffer[ctx->buffer_used]) : in[i];
+
+            out[i] = in[i] ^ ctx->buffer[ctx->buffer_used];
+            ctx->X[ctx->buffer_used++] ^= c;
+            i++;
+        }
+    }
+
+    memset(ks, 0, sizeof(ks));
+
+    return 1;
+}
+
+/**
+ * Encrypt data, supports streaming: can be called multiple times
+ * @return 1 on success, 0 if the total length exceeds the GCM limit
+ */
+int sm4_gcm_encrypt_update(SM4_GCM_CTX *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    return sm4_gcm_update(ctx, in, out, len, 1);
+}
+
+/**
+ * Decrypt data, supports streaming. Output must not be used before
+ * sm4_gcm_decrypt_final() succeeds.
+ */
+int sm4_gcm_decrypt_update(SM4_GCM_CTX *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    return sm4_gcm_update(ctx, in, out, len, 0);
+}
+
+static void sm4_gcm_tag(SM4_GCM_CTX *ctx, uint8_t tag[SM4_BLOCK_SIZE])
+{
+    uint8_t lens[SM4_BLOCK_SIZE];
+
+    gcm_finish_aad(ctx);
+    if (ctx->buffer_used < SM4_BLOCK_SIZE) {
+        gcm_gmult(ctx);
+        ctx->buffer_used = SM4_BLOCK_SIZE;
+    }
+
+    store_u64_be(ctx->aad_len * 8, lens);
+    store_u64_be(ctx->msg_len * 8, lens + 8);
+    gcm_ghash(ctx, lens, SM4_BLOCK_SIZE);
+
+    sm4_encrypt(ctx->rk, ctx->J0, tag);
+    for (int i = 0; i < (int)SM4_BLOCK_SIZE; i++) {
+        tag[i] ^= ctx->X[i];
+    }
+}
+
+/**
+ * Produce the authentication tag (tag_len 4..16 bytes)
+ * @return 1 on success, 0 on invalid tag length
+ */
+int sm4_gcm_encrypt_final(SM4_GCM_CTX *ctx, uint8_t *tag, size_t tag_len)
+{
+    uint8_t full[SM4_BLOCK_SIZE];
+
+    if (tag_len < 4 || tag_len > SM4_BLOCK_SIZE) {
+        return 0;
+    }
+
+    sm4_gcm_tag(ctx, full);
+    memcpy(tag, full, tag_len);
+    memset(full, 0, sizeof(full));
+
+    return 1;
+}
+
+/**
+ * Check the authentication tag in constant time
+ * @return 1 if the tag is valid, 0 otherwise
+ */
+int sm4_gcm_decrypt_final(SM4_GCM_CTX *ctx, const uint8_t *tag, size_t tag_len)
+{
+    uint8_t full[SM4_BLOCK_SIZE];
+    uint8_t diff = 0;
+
+    if (tag_len < 4 || tag_len > SM4_BLOCK_SIZE) {
+        return 0;
+    }
+
+    sm4_gcm_tag(ctx, full);
+    for (size_t i = 0; i < tag_len; i++) {
+        diff |= full[i] ^ tag[i];
+    }
+    memset(full, 0, sizeof(full));
+
+    return diff == 0;
+}
+
+/**
+ * Clear sensitive data from context
+ */
+void sm4_gcm_clean(SM4_GCM_CTX *ctx)
+{
+    memset(ctx, 0, sizeof(SM4_GCM_CTX));
+}
+
+/* ============================================================
+ * Convenience functions for one-shot encryption/decryption
+ * ============================================================ */
+
+/**
+ * One-shot GCM encryption
+ * @return 1 on success, 0 on invalid parameters
+ */
+int sm4_gcm_encrypt(const uint8_t key[SM4_KEY_SIZE], const uint8_t *iv, size_t iv_len,
+                    const uint8_t *aad, size_t aad_len, const uint8_t *input, size_t len,
+                    uint8_t *output, uint8_t *tag, size_t tag_len)
+{
+    SM4_GCM_CTX ctx;
+    int ret;
+
+    ret = sm4_gcm_init(&ctx, key, iv, iv_len) &&
+          sm4_gcm_update_aad(&ctx, aad, aad_len) &&
+          sm4_gcm_encrypt_update(&ctx, input, output, len) &&
+          sm4_gcm_encrypt_final(&ctx, tag, tag_len);
+    sm4_gcm_clean(&ctx);
+
+    return ret;
+}
+
+/**
+ * One-shot GCM decryption, output is wiped when the tag does not verify
+ * @return 1 if the tag is valid, 0 otherwise
+ */
+int sm4_gcm_decrypt(const uint8_t key[SM4_KEY_SIZE], const uint8_t *iv, size_t iv_len,
+                    const uint8_t *aad, size_t aad_len, const uint8_t *input, size_t len,
+                    uint8_t *output, const uint8_t *tag, size_t tag_len)
+{
+    SM4_GCM_CTX ctx;
+    int ret;
+
+    ret = sm4_gcm_init(&ctx, key, iv, iv_len) &&
+          sm4_gcm_update_aad(&ctx, aad, aad_len) &&
+          sm4_gcm_decrypt_update(&ctx, input, output, len) &&
+          sm4_gcm_decrypt_final(&ctx, tag, tag_len);
+    sm4_gcm_clean(&ctx);
+
+    if (!ret) {
+        memset(output, 0, len);
+    }
+
+    return ret;
+}
@@ -0,0 +1,269 @@
+/**
+ * SM4-XTS mode implementation (IEEE Std 1619, tweak multiplied by x in
+ * little-endian GF(2^128)), with ciphertext stealing for data units that
+ * are not a multiple of the block size.
+ *
+ * Tweaks of a batch are derived by doubling in two 64-bit words, the
+ * whitened blocks then go through the multi-block core in one call.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "../include/sm4_xts.h"
+
+/* Blocks encrypted per call to the multi-block core */
+#define SM4_XTS_BATCH_BLOCKS 16
+
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} xts_tweak;
+
+static uint64_t load_u64_le(const uint8_t *p)
+{
+    return ((uint64_t)p[0])       | ((uint64_t)p[1] << 8)  |
+           ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+           ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static void store_u64_le(uint8_t *p, uint64_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    p[4] = (uint8_t)(v >> 32);
+    p[5] = (uint8_t)(v >> 40);
+    p[6] = (uint8_t)(v >> 48);
+    p[7] = (uint8_t)(v >> 56);
+}
+
+static void tweak_load(xts_tweak *t, const uint8_t b[SM4_BLOCK_SIZE])
+{
+    t->lo = load_u64_le(b);
+    t->hi = load_u64_le(b + 8);
+}
+
+static void tweak_store(uint8_t b[SM4_BLOCK_SIZE], const xts_tweak *t)
+{
+    store_u64_le(b, t->lo);
+    store_u64_le(b + 8, t->hi);
+}
+
+/**
+ * T = T * x mod x^128 + x^7 + x^2 + x + 1
+ */
+static void tweak_double(xts_tweak *t)
+{
+    uint64_t carry = t->hi >> 63;
+
+    t->hi = (t->hi << 1) | (t->lo >> 63);
+    t->lo = (t->lo << 1) ^ (0x87 & (0 - carry));
+}
+
+static void xor_bytes(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = a[i] ^ b[i];
+    }
+}
+
+/**
+ * out_j = E(in_j ^ T_j) ^ T_j for nblocks whole blocks, T advances past them
+ * rk is the data key in encryption or decryption order
+ */
+static void xts_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE], xts_tweak *t,
+                             const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+    uint8_t tweaks[SM4_XTS_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+    uint8_t buf[SM4_XTS_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+
+    while (nblocks) {
+        size_t n = nblocks < SM4_XTS_BATCH_BLOCKS ? nblocks : SM4_XTS_BATCH_BLOCKS;
+        size_t nbytes = n * SM4_BLOCK_SIZE;
+
+        for (size_t b = 0; b < n; b++) {
+            tweak_store(tweaks + b * SM4_BLOCK_SIZE, t);
+            tweak_double(t);
+        }
+        xor_bytes(buf, in, tweaks, nbytes);
+        sm4_encrypt_blocks(rk, buf, buf, n);
+        xor_bytes(out, buf, tweaks, nbytes);
+
+        in += nbytes;
+        out += nbytes;
+        nblocks -= n;
+    }
+
+    memset(buf, 0, sizeof(buf));
+}
+
+/**
+ * Encrypt or decrypt one data unit of len >= 16 bytes starting at tweak T
+ */
+static void xts_crypt_unit(const SM4_XTS_CTX *ctx, xts_tweak *t,
+                           const uint8_t *in, uint8_t *out, size_t len, int enc)
+{
+    const uint32_t *rk = enc ? ctx->rk1 : ctx->rk1_dec;
+    size_t nblocks = len / SM4_BLOCK_SIZE;
+    size_t r = len % SM4_BLOCK_SIZE;
+    uint8_t ta[SM4_BLOCK_SIZE], tb[SM4_BLOCK_SIZE];
+    uint8_t cc[SM4_BLOCK_SIZE], pp[SM4_BLOCK_SIZE];
+
+    if (r == 0) {
+        xts_crypt_blocks(rk, t, in, out, nblocks);
+        return;
+    }
+
+    /* Ciphertext stealing: the last full block and the tail are swapped */
+    xts_crypt_blocks(rk, t, in, out, nblocks - 1);
+    in += (nblocks - 1) * SM4_BLOCK_SIZE;
+    out += (nblocks - 1) * SM4_BLOCK_SIZE;
+
+    tweak_store(ta, t);
+    tweak_double(t);
+    tweak_store(tb, t);
+
+    /* Decryption uses the tweaks of the two blocks in reverse order */
+    xor_bytes(cc, in, enc ? ta : tb, SM4_BLOCK_SIZE);
+    sm4_encrypt(rk, cc, cc);
+    xor_bytes(cc, cc, enc ? ta : tb, SM4_BLOCK_SIZE);
+
+    memcpy(pp, in + SM4_BLOCK_SIZE, r);
+    memcpy(pp + r, cc + r, SM4_BLOCK_SIZE - r);
+    memcpy(out + SM4_BLOCK_SIZE, cc, r);
+
+    xor_bytes(pp, pp, enc ? tb : ta, SM4_BLOCK_SIZE);
+    sm4_encrypt(rk, pp, pp);
+    xor_bytes(out, pp, enc ? tb : ta, SM4_BLOCK_SIZE);
+
+    memset(cc, 0, sizeof(cc));
+    memset(pp, 0, sizeof(pp));
+}
+
+/**
+ * Initialize XTS context, key is data key || tweak key
+ * @return 1 on success, 0 if both halves are equal (IEEE 1619-2018)
+ */
+int sm4_xts_init(SM4_XTS_CTX *ctx, const uint8_t key[2 * SM4_KEY_SIZE])
+{
+    uint8_t diff = 0;
+
+    for (size_t i = 0; i < SM4_KEY_SIZE; i++) {
+        diff |= key[i] ^ key[SM4_KEY_SIZE + i];
+    }
+    if (diff == 0) {
+        return 0;
+    }
+
+    sm4_key_schedule(key, ctx->rk1);
+    sm4_key_schedule(key + SM4_KEY_SIZE, ctx->rk2);
+    for (int i = 0; i < (int)SM4_KEY_SCHEDULE; i++) {
+        ctx->rk1_dec[i] = ctx->rk1[SM4_KEY_SCHEDULE - 1 - i];
+    }
+
+    return 1;
+}
+
+static int sm4_xts_crypt(const SM4_XTS_CTX *ctx, const uint8_t iv[SM4_BLOCK_SIZE],
+                         const uint8_t *in, uint8_t *out, size_t len, int enc)
+{
+    uint8_t t0[SM4_BLOCK_SIZE];
+    xts_tweak t;
+
+    if (len < SM4_BLOCK_SIZE) {
+        return 0;
+    }
+
+    sm4_encrypt(ctx->rk2, iv, t0);
+    tweak_load(&t, t0);
+    xts_crypt_unit(ctx, &t, in, out, len, enc);
+
+    return 1;
+}
+
+/**
+ * Encrypt one data unit, iv is the 128-bit tweak value (e.g. the sector
+ * number, little-endian). in and out may alias.
+ * @return 1 on success, 0 if len < 16
+ */
+int sm4_xts_encrypt(const SM4_XTS_CTX *ctx, const uint8_t iv[SM4_BLOCK_SIZE],
+                    const uint8_t *in, uint8_t *out, size_t len)
+{
+    return sm4_xts_crypt(ctx, iv, in, out, len, 1);
+}
+
+/**
+ * Decrypt one data unit
+ * @return 1 on success, 0 if len < 16
+ */
+int sm4_xts_decrypt(const SM4_XTS_CTX *ctx, const uint8_t iv[SM4_BLOCK_SIZE],
+                    const uint8_t *in, uint8_t *out, size_t len)
+{
+    return sm4_xts_crypt(ctx, iv, in, out, len, 0);
+}
+
+static int sm4_xts_crypt_sectors(const SM4_XTS_CTX *ctx, u8 sector, size_t sector_size,
+                                 const uint8_t *in, uint8_t *out, size_t nsectors, int enc)
+{
+    uint8_t t0[SM4_XTS_BATCH_BLOCKS * SM4_BLOCK_SIZE];
+    xts_tweak num = { sector, 0 };
+
+    if (sector_size < SM4_BLOCK_SIZE) {
+        return 0;
+    }
+
+    while (nsectors) {
+        size_t n = nsectors < SM4_XTS_BATCH_BLOCKS ? nsectors : SM4_XTS_BATCH_BLOCKS;
+
+        /* Initial tweaks of the next sectors in one multi-block call */
+        for (size_t s = 0; s < n; s++) {
+            tweak_store(t0 + s * SM4_BLOCK_SIZE, &num);
+            num.hi += ++num.lo == 0;
+        }
+        sm4_encrypt_blocks(ctx->rk2, t0, t0, n);
+
+        for (size_t s = 0; s < n; s++) {
+            xts_tweak t;
+
+            tweak_load(&t, t0 + s * SM4_BLOCK_SIZE);
+            xts_crypt_unit(ctx, &t, in, out, sector_size, enc);
+            in += sector_size;
+            out += sector_size;
+        }
+
+        nsectors -= n;
+    }
+
+    return 1;
+}
+
+/**
+ * Encrypt nsectors consecutive data units of sector_size bytes, the first
+ * one has tweak value sector (128-bit little-endian). in and out may alias.
+ * @return 1 on success, 0 if sector_size < 16
+ */
+int sm4_xts_encrypt_sectors(const SM4_XTS_CTX *ctx, u8 sector, size_t sector_size,
+                            const uint8_t *in, uint8_t *out, size_t nsectors)
+{
+    return sm4_xts_crypt_sectors(ctx, sector, sector_size, in, out, nsectors, 1);
+}
+
+/**
+ * Decrypt nsectors consecutive data units, see sm4_xts_encrypt_sectors()
+ */
+int sm4_xts_decrypt_sectors(const SM4_XTS_CTX *ctx, u8 sector, size_t sector_size,
+                            const uint8_t *in, uint8_t *out, size_t nsectors)
+{
+    return sm4_xts_crypt_sectors(ctx, sector, sector_size, in, out, nsectors, 0);
+}
+
+/**
+ * Clear sensitive data from context
+ */
+void sm4_xts_clean(SM4_XTS_CTX *ctx)
+{
+    memset(ctx, 0, sizeof(SM4_XTS_CTX));
+}
@@ -1,4 +1,6 @@
 #include "include/sm4.h"
+#include "include/sm4_impl.h"
+#include <stdatomic.h>
 #include <stdio.h>
 
 /* Operations */
@@ -122,11 +124,136 @@ static uint32_t sm4_t(uint32_t x)
          ROTL32(t, 18) ^ ROTL32(t, 24);
 }
 
+/*
+ * Backends. The portable one keeps the table-driven rounds above for
+ * single blocks and uses the bit-sliced core for bulk data.
+ */
+static const SM4_BACKEND sm4_backend_portable = { "portable", sm4_bs_crypt_blocks, NULL, NULL, 0 };
+#ifdef YCRYPT_HAVE_X86_SIMD
+static const SM4_BACKEND sm4_backend_aesni_avx512 = { "aesni-avx512", sm4_aesni_avx512_crypt_blocks, sm4_aesni_crypt_block, sm4_aesni_avx512_crypt_lanes, 16 };
+static const SM4_BACKEND sm4_backend_aesni_avx2 = { "aesni-avx2", sm4_aesni_avx2_crypt_blocks, sm4_aesni_crypt_block, sm4_aesni_avx2_crypt_lanes, 8 };
+static const SM4_BACKEND sm4_backend_aesni = { "aesni", sm4_aesni_crypt_blocks, sm4_aesni_crypt_block, sm4_aesni_crypt_lanes, 4 };
+#ifdef YCRYPT_ENABLE_GFNI
+static const SM4_BACKEND sm4_backend_gfni_avx512 = { "gfni-avx512", sm4_gfni_avx512_crypt_blocks, sm4_aesni_crypt_block, sm4_gfni_avx512_crypt_lanes, 16 };
+static const SM4_BACKEND sm4_backend_gfni_avx2 = { "gfni-avx2", sm4_gfni_avx2_crypt_blocks, sm4_aesni_crypt_block, sm4_gfni_avx2_crypt_lanes, 8 };
+#endif
+#endif
+#ifdef YCRYPT_HAVE_ARM_CE
+static const SM4_BACKEND sm4_backend_armv8 = { "armv8-ce", sm4_armv8_crypt_blocks, sm4_armv8_crypt_block, sm4_armv8_crypt_lanes, 4 };
+#endif
+
+/* Best backend of the requested kind usable on this CPU, NULL if none */
+static const SM4_BACKEND *sm4_backend_select(SM4_IMPL impl)
+{
+#ifdef YCRYPT_HAVE_X86_SIMD
+  unsigned int f = ycrypt_cpu_features();
+  int aesni = (f & YCRYPT_CPU_AESNI) && (f & YCRYPT_CPU_SSSE3);
+
+#ifdef YCRYPT_ENABLE_GFNI
+  /* The GFNI kernels hand tails and single blocks to AES-NI */
+  if ((impl == SM4_IMPL_AUTO || impl == SM4_IMPL_GFNI) && aesni && (f & YCRYPT_CPU_GFNI))
+  {
+    if (f & YCRYPT_CPU_AVX512)
+    {
+      return &sm4_backend_gfni_avx512;
+    }
+    if (f & YCRYPT_CPU_AVX2)
+    {
+      return &sm4_backend_gfni_avx2;
+    }
+  }
+#endif
+
+  if ((impl == SM4_IMPL_AUTO || impl == SM4_IMPL_AESNI) && aesni)
+  {
+    if ((f & YCRYPT_CPU_AVX512) && (f & YCRYPT_CPU_VAES))
+    {
+      return &sm4_backend_aesni_avx512;
+    }
+    if (f & YCRYPT_CPU_AVX2)
+    {
+      return &sm4_backend_aesni_avx2;
+    }
+    return &sm4_backend_aesni;
+  }
+#endif
+
+#ifdef YCRYPT_HAVE_ARM_CE
+  if ((impl == SM4_IMPL_AUTO || impl == SM4_IMPL_ARMV8) && (ycrypt_cpu_features() & YCRYPT_CPU_ARM_SM4))
+  {
+    return &sm4_backend_armv8;
+  }
+#endif
+
+  if (impl == SM4_IMPL_AUTO || impl == SM4_IMPL_PORTABLE)
+  {
+    return &sm4_backend_portable;
+  }
+
+  return NULL;
+}
+
+/*
+ * Selected on first use. Threads may race to select, each stores the same
+ * pointer and the atomic store/load makes the race defined.
+ */
+static _Atomic(const SM4_BACKEND *) sm4_backend_current = NULL;
+
+const SM4_BACKEND *sm4_backend(void)
+{
+  const SM4_BACKEND *backend = atomic_load_explicit(&sm4_backend_current, memory_order_acquire);
+
+  if (backend == NULL)
+  {
+    backend = sm4_backend_select(SM4_IMPL_AUTO);
+    atomic_store_explicit(&sm4_backend_current, backend, memory_order_release);
+  }
+
+  return backend;
+}
+
+/* For tests and benchmarks, see sm_interface.h */
+int sm4_set_impl(SM4_IMPL impl)
+{
+  const SM4_BACKEND *backend = sm4_backend_select(impl);
+
+  if (backend == NULL)
+  {
+    return 0;
+  }
+  atomic_store_explicit(&sm4_backend_current, backend, memory_order_release);
+
+  return 1;
+}
+
+const char *sm4_get_impl_name(void)
+{
+  return sm4_backend()->name;
+}
+
+static void sm4_reverse_key(const uint32_t rk[SM4_KEY_SCHEDULE], uint32_t rk_dec[SM4_KEY_SCHEDULE])
+{
+  int i;
+
+  /* Decryption is encryption with the round keys reversed */
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; ++i)
+  {
+    rk_dec[i] = rk[SM4_KEY_SCHEDULE - 1 - i];
+  }
+}
+
 void sm4_encrypt(const uint32_t rk[SM4_KEY_SCHEDULE],
     const uint8_t plaintext[SM4_BLOCK_SIZE], uint8_t ciphertext[SM4_BLOCK_SIZE])
 {
+  const SM4_BACKEND *backend = sm4_backend();
   uint32_t x0, x1, x2, x3;
 
+  if (backend->crypt_block)
+  {
+    backend->crypt_block(rk, plaintext, ciphertext);
+    return;
+  }
+
   x0 = load_u32_be(plaintext, 0);
   x1 = load_u32_be(plaintext, 1);
   x2 = load_u32_be(plaintext, 2);
@@ -151,8 +278,18 @@ void sm4_encrypt(const uint32_t rk[SM4_KEY_SCHEDULE],
 void sm4_decrypt(const uint32_t rk[SM4_KEY_SCHEDULE],
     const uint8_t ciphertext[SM4_BLOCK_SIZE], uint8_t plaintext[SM4_BLOCK_SIZE])
 {
+  const SM4_BACKEND *backend = sm4_backend();
   uint32_t x0, x1, x2, x3;
 
+  if (backend->crypt_block)
+  {
+    uint32_t rk_dec[SM4_KEY_SCHEDULE];
+
+    sm4_reverse_key(rk, rk_dec);
+    backend->crypt_block(rk_dec, ciphertext, plaintext);
+    return;
+  }
+
   x0 = load_u32_be(ciphertext, 0);
   x1 = load_u32_be(ciphertext, 1);
   x2 = load_u32_be(ciphertext, 2);
@@ -173,3 +310,18 @@ void sm4_decrypt(const uint32_t rk[SM4_KEY_SCHEDULE],
   store_u32_be(x0, plaintext + 12);
 }
 
+
+void sm4_encrypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  sm4_backend()->crypt_blocks(rk, in, out, nblocks);
+}
+
+void sm4_decrypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  uint32_t rk_dec[SM4_KEY_SCHEDULE];
+
+  sm4_reverse_key(rk, rk_dec);
+  sm4_backend()->crypt_blocks(rk_dec, in, out, nblocks);
+}
@@ -0,0 +1,359 @@
+/**
+ * SM4 with the AES-NI S-box (x86-64)
+ *
+ * The SM4 and AES S-boxes are both affine transforms around inversion in
+ * GF(2^8), only with different field polynomials. With a field
+ * isomorphism folded into the affine maps,
+ *
+ *   S_sm4(x) = B * S_aes(A * x + a) + b
+ *
+ * The two affine maps are evaluated with PSHUFB on the low and high
+ * nibbles and S_aes with AESENCLAST under an all-zero round key, after
+ * undoing its ShiftRows with one more PSHUFB. Four state words of 4, 8 or
+ * 16 blocks are kept transposed in SSE, AVX2 or AVX-512 registers, so the
+ * whole cipher runs without any secret-dependent memory access.
+ */
+
+#include <string.h>
+#include "include/sm4_impl.h"
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+
+#include "include/sm4_x86.h"
+
+#define SM4_AESNI_TARGET  __attribute__((target("aes,ssse3")))
+#define SM4_AVX2_TARGET   __attribute__((target("aes,avx2")))
+#define SM4_AVX512_TARGET __attribute__((target("aes,avx512f,avx512bw,vaes")))
+
+/* Nibble tables, little-endian quads: lo = entries 0..7, hi = 8..15 */
+#define PRE_LO_0   0x078B37BB820EB23EULL
+#define PRE_LO_1   0x9814A8241D912DA1ULL
+#define PRE_HI_0   0x37EB19C5F22EDC00ULL
+#define PRE_HI_1   0x3FE311CDFA26D408ULL
+#define POST_LO_0  0x2098EA521EA6D46CULL
+#define POST_LO_1  0x47FF8D3579C1B30BULL
+#define POST_HI_0  0x2DCD7D9DB050E000ULL
+#define POST_HI_1  0xED0DBD5D709020C0ULL
+
+/* Inverse of the AES ShiftRows byte permutation */
+#define INV_SR_0   0x0B0E0104070A0D00ULL
+#define INV_SR_1   0x0306090C0F020508ULL
+
+/* ------------------------------------------------------------------ */
+/* SSE: 4 blocks                                                       */
+/* ------------------------------------------------------------------ */
+
+SM4_AESNI_TARGET
+static inline __m128i sm4_aesni_sbox(__m128i x)
+{
+  const __m128i m4 = _mm_set1_epi8(0x0F);
+  const __m128i pre_lo = _mm_set_epi64x(PRE_LO_1, PRE_LO_0);
+  const __m128i pre_hi = _mm_set_epi64x(PRE_HI_1, PRE_HI_0);
+  const __m128i post_lo = _mm_set_epi64x(POST_LO_1, POST_LO_0);
+  const __m128i post_hi = _mm_set_epi64x(POST_HI_1, POST_HI_0);
+  const __m128i inv_sr = _mm_set_epi64x(INV_SR_1, INV_SR_0);
+
+  x = _mm_xor_si128(_mm_shuffle_epi8(pre_lo, _mm_and_si128(x, m4)),
+                    _mm_shuffle_epi8(pre_hi, _mm_and_si128(_mm_srli_epi32(x, 4), m4)));
+  x = _mm_shuffle_epi8(x, inv_sr);
+  x = _mm_aesenclast_si128(x, _mm_setzero_si128());
+
+  return _mm_xor_si128(_mm_shuffle_epi8(post_lo, _mm_and_si128(x, m4)),
+                       _mm_shuffle_epi8(post_hi, _mm_and_si128(_mm_srli_epi32(x, 4), m4)));
+}
+
+#define SM4_AESNI_ROUND(x0, x1, x2, x3, k)                              \
+  x0 = _mm_xor_si128(x0, sm4_sse_l(sm4_aesni_sbox(                    \
+         _mm_xor_si128(_mm_xor_si128(x1, x2), _mm_xor_si128(x3, k)))))
+
+/* Round key i: one schedule broadcast, or one key per lane */
+#define SM4_SSE_RK(rk, i, per_lane)                                     \
+  ((per_lane) ? _mm_loadu_si128((const __m128i *)((rk) + 4 * (i))) : _mm_set1_epi32((int)(rk)[i]))
+
+/* Exactly 4 blocks, with one key schedule or with per-lane round keys */
+SM4_AESNI_TARGET
+static inline void sm4_aesni_crypt4_core(const uint32_t *rk, int per_lane, const uint8_t *in, uint8_t *out)
+{
+  const __m128i bswap = _mm_set_epi64x(BSWAP_1, BSWAP_0);
+  __m128i x0, x1, x2, x3, t0, t1, t2, t3;
+  int i;
+
+  x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in +  0)), bswap);
+  x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 16)), bswap);
+  x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 32)), bswap);
+  x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 48)), bswap);
+  SM4_TRANSPOSE_4x4(x0, x1, x2, x3, _mm_unpacklo_epi32, _mm_unpackhi_epi32,
+                    _mm_unpacklo_epi64, _mm_unpackhi_epi64);
+
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; i += 4)
+  {
+    SM4_AESNI_ROUND(x0, x1, x2, x3, SM4_SSE_RK(rk, i, per_lane));
+    SM4_AESNI_ROUND(x1, x2, x3, x0, SM4_SSE_RK(rk, i + 1, per_lane));
+    SM4_AESNI_ROUND(x2, x3, x0, x1, SM4_SSE_RK(rk, i + 2, per_lane));
+    SM4_AESNI_ROUND(x3, x0, x1, x2, SM4_SSE_RK(rk, i + 3, per_lane));
+  }
+
+  /* Output is (x3, x2, x1, x0) */
+  SM4_TRANSPOSE_4x4(x3, x2, x1, x0, _mm_unpacklo_epi32, _mm_unpackhi_epi32,
+                    _mm_unpacklo_epi64, _mm_unpackhi_epi64);
+  _mm_storeu_si128((__m128i *)(out +  0), _mm_shuffle_epi8(x3, bswap));
+  _mm_storeu_si128((__m128i *)(out + 16), _mm_shuffle_epi8(x2, bswap));
+  _mm_storeu_si128((__m128i *)(out + 32), _mm_shuffle_epi8(x1, bswap));
+  _mm_storeu_si128((__m128i *)(out + 48), _mm_shuffle_epi8(x0, bswap));
+}
+
+SM4_AESNI_TARGET
+static void sm4_aesni_crypt4(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  sm4_aesni_crypt4_core(rk, 0, in, out);
+}
+
+SM4_AESNI_TARGET
+void sm4_aesni_crypt_lanes(const uint32_t *rk_lanes, const uint8_t *in, uint8_t *out)
+{
+  sm4_aesni_crypt4_core(rk_lanes, 1, in, out);
+}
+
+/* One block: every lane of xi holds word i, so no transpose is needed */
+SM4_AESNI_TARGET
+void sm4_aesni_crypt_block(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  const __m128i bswap = _mm_set_epi64x(BSWAP_1, BSWAP_0);
+  __m128i b, x0, x1, x2, x3;
+  int i;
+
+  b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), bswap);
+  x0 = _mm_shuffle_epi32(b, 0x00);
+  x1 = _mm_shuffle_epi32(b, 0x55);
+  x2 = _mm_shuffle_epi32(b, 0xAA);
+  x3 = _mm_shuffle_epi32(b, 0xFF);
+
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; i += 4)
+  {
+    SM4_AESNI_ROUND(x0, x1, x2, x3, _mm_set1_epi32((int)rk[i]));
+    SM4_AESNI_ROUND(x1, x2, x3, x0, _mm_set1_epi32((int)rk[i + 1]));
+    SM4_AESNI_ROUND(x2, x3, x0, x1, _mm_set1_epi32((int)rk[i + 2]));
+    SM4_AESNI_ROUND(x3, x0, x1, x2, _mm_set1_epi32((int)rk[i + 3]));
+  }
+
+  /* Output is (x3, x2, x1, x0) */
+  b = _mm_unpacklo_epi64(_mm_unpacklo_epi32(x3, x2), _mm_unpacklo_epi32(x1, x0));
+  _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(b, bswap));
+}
+
+SM4_AESNI_TARGET
+void sm4_aesni_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  uint8_t buf[4 * SM4_BLOCK_SIZE];
+
+  while (nblocks >= 4)
+  {
+    sm4_aesni_crypt4(rk, in, out);
+    in += 4 * SM4_BLOCK_SIZE;
+    out += 4 * SM4_BLOCK_SIZE;
+    nblocks -= 4;
+  }
+
+  if (nblocks)
+  {
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, in, nblocks * SM4_BLOCK_SIZE);
+    sm4_aesni_crypt4(rk, buf, buf);
+    memcpy(out, buf, nblocks * SM4_BLOCK_SIZE);
+    memset(buf, 0, sizeof(buf));
+  }
+}
+
+/* ------------------------------------------------------------------ */
+/* AVX2: 8 blocks, two per register                                    */
+/* ------------------------------------------------------------------ */
+
+SM4_AVX2_TARGET
+static inline __m256i sm4_avx2_sbox(__m256i x)
+{
+  const __m256i m4 = _mm256_set1_epi8(0x0F);
+  const __m256i pre_lo = _mm256_set_epi64x(PRE_LO_1, PRE_LO_0, PRE_LO_1, PRE_LO_0);
+  const __m256i pre_hi = _mm256_set_epi64x(PRE_HI_1, PRE_HI_0, PRE_HI_1, PRE_HI_0);
+  const __m256i post_lo = _mm256_set_epi64x(POST_LO_1, POST_LO_0, POST_LO_1, POST_LO_0);
+  const __m256i post_hi = _mm256_set_epi64x(POST_HI_1, POST_HI_0, POST_HI_1, POST_HI_0);
+  const __m256i inv_sr = _mm256_set_epi64x(INV_SR_1, INV_SR_0, INV_SR_1, INV_SR_0);
+  __m128i lo, hi;
+
+  x = _mm256_xor_si256(_mm256_shuffle_epi8(pre_lo, _mm256_and_si256(x, m4)),
+                       _mm256_shuffle_epi8(pre_hi, _mm256_and_si256(_mm256_srli_epi32(x, 4), m4)));
+  x = _mm256_shuffle_epi8(x, inv_sr);
+
+  /* AESENCLAST is 128-bit only without VAES */
+  lo = _mm_aesenclast_si128(_mm256_castsi256_si128(x), _mm_setzero_si128());
+  hi = _mm_aesenclast_si128(_mm256_extracti128_si256(x, 1), _mm_setzero_si128());
+  x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+  return _mm256_xor_si256(_mm256_shuffle_epi8(post_lo, _mm256_and_si256(x, m4)),
+                          _mm256_shuffle_epi8(post_hi, _mm256_and_si256(_mm256_srli_epi32(x, 4), m4)));
+}
+
+#define SM4_AVX2_ROUND(x0, x1, x2, x3, k)                               \
+  x0 = _mm256_xor_si256(x0, sm4_avx2_l(sm4_avx2_sbox(                   \
+         _mm256_xor_si256(_mm256_xor_si256(x1, x2), _mm256_xor_si256(x3, k)))))
+
+#define SM4_AVX2_RK(rk, i, per_lane)                                    \
+  ((per_lane) ? _mm256_loadu_si256((const __m256i *)((rk) + 8 * (i))) : _mm256_set1_epi32((int)(rk)[i]))
+
+/*
+ * Exactly 8 blocks. Register i holds blocks 2i and 2i + 1, the in-lane
+ * transpose gathers the even blocks in the low and the odd blocks in the
+ * high 128-bit lane. One key schedule or per-lane round keys.
+ */
+SM4_AVX2_TARGET
+static inline void sm4_avx2_crypt8_core(const uint32_t *rk, int per_lane, const uint8_t *in, uint8_t *out)
+{
+  const __m256i bswap = _mm256_set_epi64x(BSWAP_1, BSWAP_0, BSWAP_1, BSWAP_0);
+  __m256i x0, x1, x2, x3, t0, t1, t2, t3;
+  int i;
+
+  x0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in +  0)), bswap);
+  x1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 32)), bswap);
+  x2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 64)), bswap);
+  x3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 96)), bswap);
+  SM4_TRANSPOSE_4x4(x0, x1, x2, x3, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32,
+                    _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; i += 4)
+  {
+    SM4_AVX2_ROUND(x0, x1, x2, x3, SM4_AVX2_RK(rk, i, per_lane));
+    SM4_AVX2_ROUND(x1, x2, x3, x0, SM4_AVX2_RK(rk, i + 1, per_lane));
+    SM4_AVX2_ROUND(x2, x3, x0, x1, SM4_AVX2_RK(rk, i + 2, per_lane));
+    SM4_AVX2_ROUND(x3, x0, x1, x2, SM4_AVX2_RK(rk, i + 3, per_lane));
+  }
+
+  SM4_TRANSPOSE_4x4(x3, x2, x1, x0, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32,
+                    _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+  _mm256_storeu_si256((__m256i *)(out +  0), _mm256_shuffle_epi8(x3, bswap));
+  _mm256_storeu_si256((__m256i *)(out + 32), _mm256_shuffle_epi8(x2, bswap));
+  _mm256_storeu_si256((__m256i *)(out + 64), _mm256_shuffle_epi8(x1, bswap));
+  _mm256_storeu_si256((__m256i *)(out + 96), _mm256_shuffle_epi8(x0, bswap));
+}
+
+SM4_AVX2_TARGET
+static void sm4_avx2_crypt8(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  sm4_avx2_crypt8_core(rk, 0, in, out);
+}
+
+SM4_AVX2_TARGET
+void sm4_aesni_avx2_crypt_lanes(const uint32_t *rk_lanes, const uint8_t *in, uint8_t *out)
+{
+  sm4_avx2_crypt8_core(rk_lanes, 1, in, out);
+}
+
+SM4_AVX2_TARGET
+void sm4_aesni_avx2_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  while (nblocks >= 8)
+  {
+    sm4_avx2_crypt8(rk, in, out);
+    in += 8 * SM4_BLOCK_SIZE;
+    out += 8 * SM4_BLOCK_SIZE;
+    nblocks -= 8;
+  }
+
+  if (nblocks)
+  {
+    sm4_aesni_crypt_blocks(rk, in, out, nblocks);
+  }
+}
+
+/* ------------------------------------------------------------------ */
+/* AVX-512 + VAES: 16 blocks, four per register                        */
+/* ------------------------------------------------------------------ */
+
+SM4_AVX512_TARGET
+static inline __m512i sm4_avx512_sbox(__m512i x)
+{
+  const __m512i m4 = _mm512_set1_epi8(0x0F);
+  const __m512i pre_lo = _mm512_broadcast_i32x4(_mm_set_epi64x(PRE_LO_1, PRE_LO_0));
+  const __m512i pre_hi = _mm512_broadcast_i32x4(_mm_set_epi64x(PRE_HI_1, PRE_HI_0));
+  const __m512i post_lo = _mm512_broadcast_i32x4(_mm_set_epi64x(POST_LO_1, POST_LO_0));
+  const __m512i post_hi = _mm512_broadcast_i32x4(_mm_set_epi64x(POST_HI_1, POST_HI_0));
+  const __m512i inv_sr = _mm512_broadcast_i32x4(_mm_set_epi64x(INV_SR_1, INV_SR_0));
+
+  x = _mm512_xor_si512(_mm512_shuffle_epi8(pre_lo, _mm512_and_si512(x, m4)),
+                       _mm512_shuffle_epi8(pre_hi, _mm512_and_si512(_mm512_srli_epi32(x, 4), m4)));
+  x = _mm512_shuffle_epi8(x, inv_sr);
+  x = _mm512_aesenclast_epi128(x, _mm512_setzero_si512());
+
+  return _mm512_xor_si512(_mm512_shuffle_epi8(post_lo, _mm512_and_si512(x, m4)),
+                          _mm512_shuffle_epi8(post_hi, _mm512_and_si512(_mm512_srli_epi32(x, 4), m4)));
+}
+
+#define SM4_AVX512_ROUND(x0, x1, x2, x3, k)                             \
+  x0 = _mm512_xor_si512(x0, sm4_avx512_l(sm4_avx512_sbox(               \
+         _mm512_xor_si512(_mm512_ternarylogic_epi32(x1, x2, x3, 0x96), k))))
+
+#define SM4_AVX512_RK(rk, i, per_lane)                                  \
+  ((per_lane) ? _mm512_loadu_si512((const void *)((rk) + 16 * (i))) : _mm512_set1_epi32((int)(rk)[i]))
+
+/* Exactly 16 blocks. Register i holds blocks 4i .. 4i + 3 */
+SM4_AVX512_TARGET
+static inline void sm4_avx512_crypt16_core(const uint32_t *rk, int per_lane, const uint8_t *in, uint8_t *out)
+{
+  const __m512i bswap = _mm512_broadcast_i32x4(_mm_set_epi64x(BSWAP_1, BSWAP_0));
+  __m512i x0, x1, x2, x3, t0, t1, t2, t3;
+  int i;
+
+  x0 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in +   0)), bswap);
+  x1 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in +  64)), bswap);
+  x2 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in + 128)), bswap);
+  x3 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in + 192)), bswap);
+  SM4_TRANSPOSE_4x4(x0, x1, x2, x3, _mm512_unpacklo_epi32, _mm512_unpackhi_epi32,
+                    _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; i += 4)
+  {
+    SM4_AVX512_ROUND(x0, x1, x2, x3, SM4_AVX512_RK(rk, i, per_lane));
+    SM4_AVX512_ROUND(x1, x2, x3, x0, SM4_AVX512_RK(rk, i + 1, per_lane));
+    SM4_AVX512_ROUND(x2, x3, x0, x1, SM4_AVX512_RK(rk, i + 2, per_lane));
+    SM4_AVX512_ROUND(x3, x0, x1, x2, SM4_AVX512_RK(rk, i + 3, per_lane));
+  }
+
+  SM4_TRANSPOSE_4x4(x3, x2, x1, x0, _mm512_unpacklo_epi32, _mm512_unpackhi_epi32,
+                    _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+  _mm512_storeu_si512((void *)(out +   0), _mm512_shuffle_epi8(x3, bswap));
+  _mm512_storeu_si512((void *)(out +  64), _mm512_shuffle_epi8(x2, bswap));
+  _mm512_storeu_si512((void *)(out + 128), _mm512_shuffle_epi8(x1, bswap));
+  _mm512_storeu_si512((void *)(out + 192), _mm512_shuffle_epi8(x0, bswap));
+}
+
+SM4_AVX512_TARGET
+static void sm4_avx512_crypt16(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  sm4_avx512_crypt16_core(rk, 0, in, out);
+}
+
+SM4_AVX512_TARGET
+void sm4_aesni_avx512_crypt_lanes(const uint32_t *rk_lanes, const uint8_t *in, uint8_t *out)
+{
+  sm4_avx512_crypt16_core(rk_lanes, 1, in, out);
+}
+
+SM4_AVX512_TARGET
+void sm4_aesni_avx512_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  while (nblocks >= 16)
+  {
+    sm4_avx512_crypt16(rk, in, out);
+    in += 16 * SM4_BLOCK_SIZE;
+    out += 16 * SM4_BLOCK_SIZE;
+    nblocks -= 16;
+  }
+
+  if (nblocks)
+  {
+    sm4_aesni_avx2_crypt_blocks(rk, in, out, nblocks);
+  }
+}
+
+#endif /* YCRYPT_HAVE_X86_SIMD */
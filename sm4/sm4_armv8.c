@@ -0,0 +1,137 @@
+/**
+ * SM4 with the ARMv8.2 SM4 instructions (AArch64)
+ *
+ * SM4E runs four rounds on one block held as (x0, x1, x2, x3) in the four
+ * lanes of a vector, with four round keys from another. A block needs
+ * eight of them back to back, so several blocks are interleaved to hide
+ * the instruction latency. No table lookups, the S-box is in hardware.
+ */
+
+#include "include/sm4_impl.h"
+
+#ifdef YCRYPT_HAVE_ARM_CE
+
+#include <arm_neon.h>
+
+#define SM4_CE_TARGET __attribute__((target("arch=armv8.2-a+sm4")))
+
+/* Blocks per pass of the bulk loop */
+#define SM4_CE_WAYS 8
+
+SM4_CE_TARGET
+static inline uint32x4_t sm4_ce_load(const uint8_t *in)
+{
+  return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(in)));
+}
+
+/* Output is (x3, x2, x1, x0), big-endian */
+SM4_CE_TARGET
+static inline void sm4_ce_store(uint8_t *out, uint32x4_t x)
+{
+  x = vrev64q_u32(x);
+  x = vextq_u32(x, x, 2);
+  vst1q_u8(out, vrev32q_u8(vreinterpretq_u8_u32(x)));
+}
+
+/* n <= SM4_CE_WAYS blocks, the loops unroll for the constant counts */
+SM4_CE_TARGET
+static inline void sm4_ce_crypt(const uint32x4_t k[8], const uint8_t *in, uint8_t *out, size_t n)
+{
+  uint32x4_t x[SM4_CE_WAYS];
+  size_t b;
+  int i;
+
+  for (b = 0; b < n; b++)
+  {
+    x[b] = sm4_ce_load(in + b * SM4_BLOCK_SIZE);
+  }
+  for (i = 0; i < 8; i++)
+  {
+    for (b = 0; b < n; b++)
+    {
+      x[b] = vsm4eq_u32(x[b], k[i]);
+    }
+  }
+  for (b = 0; b < n; b++)
+  {
+    sm4_ce_store(out + b * SM4_BLOCK_SIZE, x[b]);
+  }
+}
+
+SM4_CE_TARGET
+void sm4_armv8_crypt_block(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  uint32x4_t x = sm4_ce_load(in);
+  int i;
+
+  for (i = 0; i < 8; i++)
+  {
+    x = vsm4eq_u32(x, vld1q_u32(rk + 4 * i));
+  }
+  sm4_ce_store(out, x);
+}
+
+SM4_CE_TARGET
+void sm4_armv8_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  uint32x4_t k[8];
+  int i;
+
+  for (i = 0; i < 8; i++)
+  {
+    k[i] = vld1q_u32(rk + 4 * i);
+  }
+
+  while (nblocks >= SM4_CE_WAYS)
+  {
+    sm4_ce_crypt(k, in, out, SM4_CE_WAYS);
+    in += SM4_CE_WAYS * SM4_BLOCK_SIZE;
+    out += SM4_CE_WAYS * SM4_BLOCK_SIZE;
+    nblocks -= SM4_CE_WAYS;
+  }
+  if (nblocks >= 4)
+  {
+    sm4_ce_crypt(k, in, out, 4);
+    in += 4 * SM4_BLOCK_SIZE;
+    out += 4 * SM4_BLOCK_SIZE;
+    nblocks -= 4;
+  }
+  while (nblocks--)
+  {
+    sm4_ce_crypt(k, in, out, 1);
+    in += SM4_BLOCK_SIZE;
+    out += SM4_BLOCK_SIZE;
+  }
+}
+
+/*
+ * 4 blocks with their own keys. Rounds 4i..4i+3 of all lanes are 16
+ * consecutive words, LD4 de-interleaves them into one key vector per block.
+ */
+SM4_CE_TARGET
+void sm4_armv8_crypt_lanes(const uint32_t *rk_lanes, const uint8_t *in, uint8_t *out)
+{
+  uint32x4_t x[4];
+  int b, i;
+
+  for (b = 0; b < 4; b++)
+  {
+    x[b] = sm4_ce_load(in + b * SM4_BLOCK_SIZE);
+  }
+  for (i = 0; i < 8; i++)
+  {
+    uint32x4x4_t k = vld4q_u32(rk_lanes + 16 * i);
+
+    x[0] = vsm4eq_u32(x[0], k.val[0]);
+    x[1] = vsm4eq_u32(x[1], k.val[1]);
+    x[2] = vsm4eq_u32(x[2], k.val[2]);
+    x[3] = vsm4eq_u32(x[3], k.val[3]);
+  }
+  for (b = 0; b < 4; b++)
+  {
+    sm4_ce_store(out + b * SM4_BLOCK_SIZE, x[b]);
+  }
+}
+
+#endif
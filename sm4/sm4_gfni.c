@@ -0,0 +1,189 @@
+/**
+ * SM4 with the GFNI S-box (x86-64)
+ *
+ * GF2P8AFFINEINVQB computes B * x^-1 + b in the AES field, so with the
+ * field isomorphism folded into the matrices the SM4 S-box is
+ *
+ *   S_sm4(x) = GF2P8AFFINEINVQB(GF2P8AFFINEQB(x, A, a), B, 0xD3)
+ *
+ * two instructions for a whole register. AVX-512 kernels process 16 and
+ * AVX2 kernels 8 blocks per pass; shorter tails and single blocks go
+ * through the AES-NI SSE kernel, which every GFNI capable CPU supports.
+ */
+
+#include "include/sm4_impl.h"
+
+#if defined(YCRYPT_HAVE_X86_SIMD) && defined(YCRYPT_ENABLE_GFNI)
+
+#include "include/sm4_x86.h"
+
+#define SM4_GFNI_AVX2_TARGET   __attribute__((target("gfni,avx2")))
+#define SM4_GFNI_AVX512_TARGET __attribute__((target("gfni,avx512f,avx512bw")))
+
+/* x -> T * A1 * x + T * 0xD3, into the AES field */
+#define GFNI_PRE_MATRIX   0x4C287DB91A22505DULL
+#define GFNI_PRE_CONST    0x3E
+/* y -> A1 * T^-1 * y^-1 + 0xD3, back from the AES field */
+#define GFNI_POST_MATRIX  0xF3AB34A974A6B589ULL
+#define GFNI_POST_CONST   0xD3
+
+/* ------------------------------------------------------------------ */
+/* GFNI + AVX2: 8 blocks                                               */
+/* ------------------------------------------------------------------ */
+
+SM4_GFNI_AVX2_TARGET
+static inline __m256i sm4_gfni_avx2_sbox(__m256i x)
+{
+  x = _mm256_gf2p8affine_epi64_epi8(x, _mm256_set1_epi64x((long long)GFNI_PRE_MATRIX), GFNI_PRE_CONST);
+  return _mm256_gf2p8affineinv_epi64_epi8(x, _mm256_set1_epi64x((long long)GFNI_POST_MATRIX), GFNI_POST_CONST);
+}
+
+#define SM4_GFNI_AVX2_ROUND(x0, x1, x2, x3, k)                          \
+  x0 = _mm256_xor_si256(x0, sm4_avx2_l(sm4_gfni_avx2_sbox(              \
+         _mm256_xor_si256(_mm256_xor_si256(x1, x2), _mm256_xor_si256(x3, k)))))
+
+#define SM4_GFNI_AVX2_RK(rk, i, per_lane)                               \
+  ((per_lane) ? _mm256_loadu_si256((const __m256i *)((rk) + 8 * (i))) : _mm256_set1_epi32((int)(rk)[i]))
+
+/* Exactly 8 blocks, same layout and key options as the AES-NI AVX2 kernel */
+SM4_GFNI_AVX2_TARGET
+static inline void sm4_gfni_avx2_crypt8_core(const uint32_t *rk, int per_lane, const uint8_t *in, uint8_t *out)
+{
+  const __m256i bswap = _mm256_set_epi64x(BSWAP_1, BSWAP_0, BSWAP_1, BSWAP_0);
+  __m256i x0, x1, x2, x3, t0, t1, t2, t3;
+  int i;
+
+  x0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in +  0)), bswap);
+  x1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 32)), bswap);
+  x2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 64)), bswap);
+  x3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 96)), bswap);
+  SM4_TRANSPOSE_4x4(x0, x1, x2, x3, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32,
+                    _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; i += 4)
+  {
+    SM4_GFNI_AVX2_ROUND(x0, x1, x2, x3, SM4_GFNI_AVX2_RK(rk, i, per_lane));
+    SM4_GFNI_AVX2_ROUND(x1, x2, x3, x0, SM4_GFNI_AVX2_RK(rk, i + 1, per_lane));
+    SM4_GFNI_AVX2_ROUND(x2, x3, x0, x1, SM4_GFNI_AVX2_RK(rk, i + 2, per_lane));
+    SM4_GFNI_AVX2_ROUND(x3, x0, x1, x2, SM4_GFNI_AVX2_RK(rk, i + 3, per_lane));
+  }
+
+  /* Output is (x3, x2, x1, x0) */
+  SM4_TRANSPOSE_4x4(x3, x2, x1, x0, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32,
+                    _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+  _mm256_storeu_si256((__m256i *)(out +  0), _mm256_shuffle_epi8(x3, bswap));
+  _mm256_storeu_si256((__m256i *)(out + 32), _mm256_shuffle_epi8(x2, bswap));
+  _mm256_storeu_si256((__m256i *)(out + 64), _mm256_shuffle_epi8(x1, bswap));
+  _mm256_storeu_si256((__m256i *)(out + 96), _mm256_shuffle_epi8(x0, bswap));
+}
+
+SM4_GFNI_AVX2_TARGET
+static void sm4_gfni_avx2_crypt8(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  sm4_gfni_avx2_crypt8_core(rk, 0, in, out);
+}
+
+SM4_GFNI_AVX2_TARGET
+void sm4_gfni_avx2_crypt_lanes(const uint32_t *rk_lanes, const uint8_t *in, uint8_t *out)
+{
+  sm4_gfni_avx2_crypt8_core(rk_lanes, 1, in, out);
+}
+
+SM4_GFNI_AVX2_TARGET
+void sm4_gfni_avx2_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  while (nblocks >= 8)
+  {
+    sm4_gfni_avx2_crypt8(rk, in, out);
+    in += 8 * SM4_BLOCK_SIZE;
+    out += 8 * SM4_BLOCK_SIZE;
+    nblocks -= 8;
+  }
+
+  if (nblocks)
+  {
+    sm4_aesni_crypt_blocks(rk, in, out, nblocks);
+  }
+}
+
+/* ------------------------------------------------------------------ */
+/* GFNI + AVX-512: 16 blocks                                           */
+/* ------------------------------------------------------------------ */
+
+SM4_GFNI_AVX512_TARGET
+static inline __m512i sm4_gfni_avx512_sbox(__m512i x)
+{
+  x = _mm512_gf2p8affine_epi64_epi8(x, _mm512_set1_epi64((long long)GFNI_PRE_MATRIX), GFNI_PRE_CONST);
+  return _mm512_gf2p8affineinv_epi64_epi8(x, _mm512_set1_epi64((long long)GFNI_POST_MATRIX), GFNI_POST_CONST);
+}
+
+#define SM4_GFNI_AVX512_ROUND(x0, x1, x2, x3, k)                        \
+  x0 = _mm512_xor_si512(x0, sm4_avx512_l(sm4_gfni_avx512_sbox(          \
+         _mm512_xor_si512(_mm512_ternarylogic_epi32(x1, x2, x3, 0x96), k))))
+
+#define SM4_GFNI_AVX512_RK(rk, i, per_lane)                             \
+  ((per_lane) ? _mm512_loadu_si512((const void *)((rk) + 16 * (i))) : _mm512_set1_epi32((int)(rk)[i]))
+
+/* Exactly 16 blocks, same layout and key options as the AES-NI AVX-512 kernel */
+SM4_GFNI_AVX512_TARGET
+static inline void sm4_gfni_avx512_crypt16_core(const uint32_t *rk, int per_lane, const uint8_t *in, uint8_t *out)
+{
+  const __m512i bswap = _mm512_broadcast_i32x4(_mm_set_epi64x(BSWAP_1, BSWAP_0));
+  __m512i x0, x1, x2, x3, t0, t1, t2, t3;
+  int i;
+
+  x0 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in +   0)), bswap);
+  x1 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in +  64)), bswap);
+  x2 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in + 128)), bswap);
+  x3 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in + 192)), bswap);
+  SM4_TRANSPOSE_4x4(x0, x1, x2, x3, _mm512_unpacklo_epi32, _mm512_unpackhi_epi32,
+                    _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+
+  for (i = 0; i < (int)SM4_KEY_SCHEDULE; i += 4)
+  {
+    SM4_GFNI_AVX512_ROUND(x0, x1, x2, x3, SM4_GFNI_AVX512_RK(rk, i, per_lane));
+    SM4_GFNI_AVX512_ROUND(x1, x2, x3, x0, SM4_GFNI_AVX512_RK(rk, i + 1, per_lane));
+    SM4_GFNI_AVX512_ROUND(x2, x3, x0, x1, SM4_GFNI_AVX512_RK(rk, i + 2, per_lane));
+    SM4_GFNI_AVX512_ROUND(x3, x0, x1, x2, SM4_GFNI_AVX512_RK(rk, i + 3, per_lane));
+  }
+
+  SM4_TRANSPOSE_4x4(x3, x2, x1, x0, _mm512_unpacklo_epi32, _mm512_unpackhi_epi32,
+                    _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+  _mm512_storeu_si512((void *)(out +   0), _mm512_shuffle_epi8(x3, bswap));
+  _mm512_storeu_si512((void *)(out +  64), _mm512_shuffle_epi8(x2, bswap));
+  _mm512_storeu_si512((void *)(out + 128), _mm512_shuffle_epi8(x1, bswap));
+  _mm512_storeu_si512((void *)(out + 192), _mm512_shuffle_epi8(x0, bswap));
+}
+
+SM4_GFNI_AVX512_TARGET
+static void sm4_gfni_avx512_crypt16(const uint32_t rk[SM4_KEY_SCHEDULE], const uint8_t *in, uint8_t *out)
+{
+  sm4_gfni_avx512_crypt16_core(rk, 0, in, out);
+}
+
+SM4_GFNI_AVX512_TARGET
+void sm4_gfni_avx512_crypt_lanes(const uint32_t *rk_lanes, const uint8_t *in, uint8_t *out)
+{
+  sm4_gfni_avx512_crypt16_core(rk_lanes, 1, in, out);
+}
+
+SM4_GFNI_AVX512_TARGET
+void sm4_gfni_avx512_crypt_blocks(const uint32_t rk[SM4_KEY_SCHEDULE],
+    const uint8_t *in, uint8_t *out, size_t nblocks)
+{
+  while (nblocks >= 16)
+  {
+    sm4_gfni_avx512_crypt16(rk, in, out);
+    in += 16 * SM4_BLOCK_SIZE;
+    out += 16 * SM4_BLOCK_SIZE;
+    nblocks -= 16;
+  }
+
+  if (nblocks)
+  {
+    sm4_gfni_avx2_crypt_blocks(rk, in, out, nblocks);
+  }
+}
+
+#endif /* YCRYPT_HAVE_X86_SIMD && YCRYPT_ENABLE_GFNI */
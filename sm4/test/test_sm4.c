@@ -13,6 +13,10 @@
 #include "../include/sm4.h"
 #include "../include/sm4_ctr.h"
 #include "../include/sm4_cbc.h"
+#include "../include/sm4_gcm.h"
+#include "../include/sm4_ccm.h"
+#include "../include/sm4_xts.h"
+#include "../include/sm4_impl.h"
 
 #define NTESTS 10000
 
@@ -203,6 +207,222 @@ static int test_sm4_ecb(void)
     return pass;
 }
 
+/* ============================================================
+ * SM4 Multi-block Tests
+ * ============================================================ */
+
+static int test_sm4_multi_block(void)
+{
+    printf("\n========== SM4 Multi-block Correctness Test ==========\n");
+
+    const size_t counts[] = {1, 2, 7, 8, 15, 16, 17, 31, 32, 33, 64, 100};
+    uint8_t key[16];
+    uint8_t pt[100 * 16], ct[100 * 16], ref[100 * 16], dec[100 * 16];
+    uint32_t rk[SM4_KEY_SCHEDULE];
+    int pass = 1;
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        size_t nblocks = counts[c];
+        char name[64];
+
+        random_bytes(key, sizeof(key));
+        random_bytes(pt, nblocks * 16);
+        sm4_key_schedule(key, rk);
+
+        for (size_t b = 0; b < nblocks; b++) {
+            sm4_encrypt(rk, pt + 16 * b, ref + 16 * b);
+        }
+        sm4_encrypt_blocks(rk, pt, ct, nblocks);
+        sm4_decrypt_blocks(rk, ct, dec, nblocks);
+
+        snprintf(name, sizeof(name), "sm4_encrypt_blocks/decrypt_blocks %zu blocks", nblocks);
+        if (memcmp(ct, ref, nblocks * 16) != 0 || memcmp(dec, pt, nblocks * 16) != 0) {
+            TEST_FAIL(name);
+            pass = 0;
+        } else {
+            TEST_PASS(name);
+        }
+    }
+
+    /* In-place */
+    memcpy(ct, pt, sizeof(pt));
+    sm4_encrypt_blocks(rk, ct, ct, 100);
+    for (size_t b = 0; b < 100; b++) {
+        sm4_encrypt(rk, pt + 16 * b, ref + 16 * b);
+    }
+    if (memcmp(ct, ref, sizeof(ref)) != 0) {
+        TEST_FAIL("sm4_encrypt_blocks in-place");
+        pass = 0;
+    } else {
+        TEST_PASS("sm4_encrypt_blocks in-place");
+    }
+
+    return pass;
+}
+
+/* ============================================================
+ * SM4 Backend Tests (every kernel usable on this CPU)
+ * ============================================================ */
+
+static int check_sm4_backend(const char *name, sm4_crypt_blocks_fn crypt_blocks,
+                             sm4_crypt_lanes_fn crypt_lanes, size_t lanes)
+{
+    const uint8_t key[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+        0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    const uint8_t expected_ciphertext[16] = {
+        0x68, 0x1E, 0xDF, 0x34, 0xD2, 0x06, 0x96, 0x5E,
+        0x86, 0xB3, 0xE9, 0x4F, 0x53, 0x6E, 0x42, 0x46
+    };
+    uint8_t pt[40 * 16], ct[40 * 16], ref[40 * 16];
+    uint32_t rk[SM4_KEY_SCHEDULE];
+    char label[64];
+    int pass = 1;
+
+    sm4_key_schedule(key, rk);
+    crypt_blocks(rk, key, ct, 1);
+    if (memcmp(ct, expected_ciphertext, 16) != 0) {
+        pass = 0;
+    }
+
+    for (size_t nblocks = 1; nblocks <= 40 && pass; nblocks++) {
+        random_bytes(pt, nblocks * 16);
+        random_bytes(ct, sizeof(ct));
+        memcpy(ref, ct, sizeof(ref));
+        sm4_bs_crypt_blocks(rk, pt, ref, nblocks);
+        crypt_blocks(rk, pt, ct, nblocks);
+        /* Blocks past nblocks must be left untouched */
+        if (memcmp(ct, ref, sizeof(ct)) != 0) {
+            pass = 0;
+        }
+    }
+
+    /* Multi-key kernel: every lane with its own key schedule */
+    if (crypt_lanes) {
+        uint32_t rk_lanes[SM4_KEY_SCHEDULE * 16], rk_d[SM4_KEY_SCHEDULE];
+        uint8_t k_d[16];
+
+        random_bytes(pt, lanes * 16);
+        for (size_t d = 0; d < lanes; d++) {
+            size_t b = SM4_LANE_BLOCK(lanes, d);
+
+            random_bytes(k_d, sizeof(k_d));
+            sm4_key_schedule(k_d, rk_d);
+            for (size_t i = 0; i < SM4_KEY_SCHEDULE; i++) {
+                rk_lanes[i * lanes + d] = rk_d[i];
+            }
+            sm4_bs_crypt_blocks(rk_d, pt + b * 16, ref + b * 16, 1);
+        }
+        crypt_lanes(rk_lanes, pt, ct);
+        if (memcmp(ct, ref, lanes * 16) != 0) {
+            pass = 0;
+        }
+    }
+
+    snprintf(label, sizeof(label), "backend %s", name);
+    if (pass) {
+        TEST_PASS(label);
+    } else {
+        TEST_FAIL(label);
+    }
+
+    return pass;
+}
+
+static int test_sm4_backends(void)
+{
+    printf("\n========== SM4 Backend Correctness Test ==========\n");
+    printf("[+] Selected backend: %s\n", sm4_backend()->name);
+
+    int pass = 1;
+
+    pass &= check_sm4_backend("bitslice", sm4_bs_crypt_blocks, NULL, 0);
+
+#ifdef YCRYPT_HAVE_X86_SIMD
+    unsigned int f = ycrypt_cpu_features();
+
+    if ((f & YCRYPT_CPU_AESNI) && (f & YCRYPT_CPU_SSSE3)) {
+        pass &= check_sm4_backend("aesni", sm4_aesni_crypt_blocks, sm4_aesni_crypt_lanes, 4);
+    }
+    if ((f & YCRYPT_CPU_AESNI) && (f & YCRYPT_CPU_AVX2)) {
+        pass &= check_sm4_backend("aesni-avx2", sm4_aesni_avx2_crypt_blocks,
+                                  sm4_aesni_avx2_crypt_lanes, 8);
+    }
+    if ((f & YCRYPT_CPU_AESNI) && (f & YCRYPT_CPU_AVX512) && (f & YCRYPT_CPU_VAES)) {
+        pass &= check_sm4_backend("aesni-avx512", sm4_aesni_avx512_crypt_blocks,
+                                  sm4_aesni_avx512_crypt_lanes, 16);
+    }
+#ifdef YCRYPT_ENABLE_GFNI
+    if ((f & YCRYPT_CPU_AESNI) && (f & YCRYPT_CPU_GFNI) && (f & YCRYPT_CPU_AVX2)) {
+        pass &= check_sm4_backend("gfni-avx2", sm4_gfni_avx2_crypt_blocks,
+                                  sm4_gfni_avx2_crypt_lanes, 8);
+    }
+    if ((f & YCRYPT_CPU_AESNI) && (f & YCRYPT_CPU_GFNI) && (f & YCRYPT_CPU_AVX512)) {
+        pass &= check_sm4_backend("gfni-avx512", sm4_gfni_avx512_crypt_blocks,
+                                  sm4_gfni_avx512_crypt_lanes, 16);
+    }
+#endif
+#endif
+
+#ifdef YCRYPT_HAVE_ARM_CE
+    if (ycrypt_cpu_features() & YCRYPT_CPU_ARM_SM4) {
+        pass &= check_sm4_backend("armv8-ce", sm4_armv8_crypt_blocks, sm4_armv8_crypt_lanes, 4);
+    }
+#endif
+
+    return pass;
+}
+
+/* Every selectable implementation behind the public entry points */
+static int test_sm4_impl_select(void)
+{
+    printf("\n========== SM4 Implementation Selection Test ==========\n");
+
+    const SM4_IMPL impls[] = { SM4_IMPL_PORTABLE, SM4_IMPL_AESNI, SM4_IMPL_GFNI, SM4_IMPL_ARMV8 };
+    uint8_t key[16], iv[16], pt[1000], ctr_ref[1000], cbc_ref[992], out[1000], blk[16];
+    uint32_t rk[SM4_KEY_SCHEDULE];
+    char label[96];
+    int pass = 1;
+
+    random_bytes(key, sizeof(key));
+    random_bytes(iv, sizeof(iv));
+    random_bytes(pt, sizeof(pt));
+    sm4_key_schedule(key, rk);
+
+    sm4_set_impl(SM4_IMPL_PORTABLE);
+    sm4_ctr_once(pt, sizeof(pt), ctr_ref, key, iv);
+    sm4_cbc_decrypt(rk, iv, pt, cbc_ref, sizeof(cbc_ref));
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        int ok = 1;
+
+        if (!sm4_set_impl(impls[i])) {
+            continue;
+        }
+
+        sm4_ctr_once(pt, sizeof(pt), out, key, iv);
+        ok &= memcmp(out, ctr_ref, sizeof(ctr_ref)) == 0;
+        sm4_cbc_decrypt(rk, iv, pt, out, sizeof(cbc_ref));
+        ok &= memcmp(out, cbc_ref, sizeof(cbc_ref)) == 0;
+        sm4_encrypt(rk, pt, blk);
+        sm4_decrypt(rk, blk, out);
+        ok &= memcmp(out, pt, 16) == 0;
+
+        snprintf(label, sizeof(label), "sm4_set_impl -> %s", sm4_get_impl_name());
+        if (ok) {
+            TEST_PASS(label);
+        } else {
+            TEST_FAIL(label);
+            pass = 0;
+        }
+    }
+
+    sm4_set_impl(SM4_IMPL_AUTO);
+
+    return pass;
+}
+
 /* ============================================================
  * SM4 CTR Tests
  * ============================================================ */
@@ -383,6 +603,77 @@ static int sm4_ctr_self_check(void)
         }
     }
 
+    /* Test: 128-bit and 32-bit counters across carries, SIMD and portable paths */
+    {
+        const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+        /* Low bytes of the initial counter: carry out of 32 and 64 bits */
+        const uint8_t starts[3][8] = {
+            { 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xF5 },
+            { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF9 },
+            { 0x12, 0x34, 0x56, 0x78, 0x00, 0x00, 0x00, 0x00 },
+        };
+        enum { WRAP_LEN = 40 * 16 + 7 };
+        uint8_t pt[WRAP_LEN], ct[WRAP_LEN], ref[WRAP_LEN];
+        uint8_t ctr_iv[16], blk[16], ks[16];
+        uint32_t rk[SM4_KEY_SCHEDULE];
+        SM4_CTR_CTX ctx;
+        int ok = 1;
+
+        sm4_key_schedule(key, rk);
+        random_bytes(pt, sizeof(pt));
+
+        for (size_t k = 0; k < 2; k++) {
+            sm4_set_impl(impls[k]);
+
+            for (int s = 0; s < 3; s++) {
+                for (int ctr32 = 0; ctr32 < 2; ctr32++) {
+                    size_t off, n;
+
+                    memset(ctr_iv, 0xFF, 8);
+                    memcpy(ctr_iv + 8, starts[s], 8);
+
+                    /* Reference: one block at a time, byte-wise increment */
+                    memcpy(blk, ctr_iv, 16);
+                    for (off = 0; off < WRAP_LEN; off += 16) {
+                        sm4_encrypt(rk, blk, ks);
+                        for (size_t j = 0; j < 16 && off + j < WRAP_LEN; j++) {
+                            ref[off + j] = pt[off + j] ^ ks[j];
+                        }
+                        for (int j = 15; j >= (ctr32 ? 12 : 0); j--) {
+                            if (++blk[j] != 0) {
+                                break;
+                            }
+                        }
+                    }
+
+                    if (ctr32) {
+                        sm4_ctr32_init(&ctx, key, ctr_iv);
+                    } else {
+                        sm4_ctr_init(&ctx, key, ctr_iv);
+                    }
+                    if (impls[k] == SM4_IMPL_PORTABLE) {
+                        ctx.simd = 0;           /* word-at-a-time counters and XOR */
+                    }
+                    for (off = 0; off < WRAP_LEN; off += n) {
+                        n = (size_t)(rand() % 100);
+                        n = n > WRAP_LEN - off ? WRAP_LEN - off : n;
+                        sm4_ctr_update(&ctx, pt + off, ct + off, n);
+                    }
+                    ok &= memcmp(ct, ref, WRAP_LEN) == 0;
+                }
+            }
+        }
+        sm4_set_impl(SM4_IMPL_AUTO);
+        sm4_ctr_clean(&ctx);
+
+        if (ok) {
+            TEST_PASS("CTR 128-bit / 32-bit counter wrap");
+        } else {
+            TEST_FAIL("CTR 128-bit / 32-bit counter wrap");
+            pass = 0;
+        }
+    }
+
     return pass;
 }
 
@@ -547,6 +838,823 @@ static int sm4_cbc_self_check(void)
         }
     }
 
+    /* Test: chunked and in-place decryption through the chaining state */
+    {
+        size_t len = 4096 + 48;
+        uint8_t *pt = malloc(len);
+        uint8_t *ct = malloc(len);
+        uint8_t *rt = malloc(len);
+        uint8_t chain[16];
+        int ok = 1;
+
+        random_bytes(pt, len);
+        sm4_cbc_encrypt(rk, iv, pt, ct, len);
+
+        for (int t = 0; t < 50 && ok; t++) {
+            size_t off, n;
+
+            memcpy(rt, ct, len);
+            memcpy(chain, iv, 16);
+            for (off = 0; off < len; off += n) {
+                n = 16 * (size_t)(rand() % 40);
+                n = n > len - off ? len - off : n;
+                sm4_cbc_decrypt_chain(rk, chain, rt + off, rt + off, n, chain);
+            }
+            ok &= memcmp(rt, pt, len) == 0;
+            ok &= memcmp(chain, ct + len - 16, 16) == 0;
+        }
+
+        /* Out of place, trailing partial block is ignored */
+        memset(rt, 0, len);
+        sm4_cbc_decrypt_chain(rk, iv, ct, rt, len - 5, chain);
+        ok &= memcmp(rt, pt, len - 16) == 0;
+        ok &= memcmp(chain, ct + len - 32, 16) == 0;
+
+        if (ok) {
+            TEST_PASS("CBC chunked / in-place decryption");
+        } else {
+            TEST_FAIL("CBC chunked / in-place decryption");
+            pass = 0;
+        }
+
+        free(pt);
+        free(ct);
+        free(rt);
+    }
+
+    /* Test: multi-buffer encryption equals one stream at a time */
+    {
+        const SM4_IMPL impls[] = { SM4_IMPL_PORTABLE, SM4_IMPL_AESNI, SM4_IMPL_GFNI, SM4_IMPL_ARMV8 };
+        enum { MB_JOBS = 70, MB_MAX_LEN = 1500 };
+        SM4_CBC_JOB jobs[MB_JOBS];
+        uint32_t (*rks)[SM4_KEY_SCHEDULE] = malloc(MB_JOBS * sizeof(*rks));
+        uint8_t *ivs = malloc(MB_JOBS * 16);
+        uint8_t *pt = malloc(MB_JOBS * MB_MAX_LEN);
+        uint8_t *ct = malloc(MB_JOBS * MB_MAX_LEN);
+        uint8_t *ref = malloc(MB_JOBS * MB_MAX_LEN);
+        uint8_t k_j[16];
+        int ok = 1;
+
+        for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+            if (!sm4_set_impl(impls[k])) {
+                continue;
+            }
+
+            for (int t = 0; t < 20 && ok; t++) {
+                size_t njobs = (size_t)(rand() % MB_JOBS) + 1;
+
+                random_bytes(pt, MB_JOBS * MB_MAX_LEN);
+                memcpy(ct, pt, MB_JOBS * MB_MAX_LEN);
+                memcpy(ref, pt, MB_JOBS * MB_MAX_LEN);
+
+                for (size_t j = 0; j < njobs; j++) {
+                    random_bytes(k_j, sizeof(k_j));
+                    sm4_key_schedule(k_j, rks[j]);
+                    random_bytes(ivs + j * 16, 16);
+
+                    jobs[j].rk = rks[j];
+                    jobs[j].iv = ivs + j * 16;
+                    jobs[j].length = (size_t)(rand() % MB_MAX_LEN);
+                    /* Every other job in place */
+                    jobs[j].input = (j & 1) ? ct + j * MB_MAX_LEN : pt + j * MB_MAX_LEN;
+                    jobs[j].output = ct + j * MB_MAX_LEN;
+
+                    sm4_cbc_encrypt(rks[j], ivs + j * 16, pt + j * MB_MAX_LEN,
+                                    ref + j * MB_MAX_LEN, jobs[j].length);
+                }
+
+                sm4_cbc_encrypt_mb(jobs, njobs);
+                ok &= memcmp(ct, ref, MB_JOBS * MB_MAX_LEN) == 0;
+            }
+        }
+        sm4_set_impl(SM4_IMPL_AUTO);
+
+        if (ok) {
+            TEST_PASS("CBC multi-buffer encryption");
+        } else {
+            TEST_FAIL("CBC multi-buffer encryption");
+            pass = 0;
+        }
+
+        free(rks);
+        free(ivs);
+        free(pt);
+        free(ct);
+        free(ref);
+    }
+
+    /* Test: streaming API with PKCS#7 padding, random chunking */
+    {
+        enum { ST_MAX_LEN = 300 };
+        uint8_t st_key[16], pt[ST_MAX_LEN + 16], ct[ST_MAX_LEN + 16];
+        uint8_t ref[ST_MAX_LEN + 16], rt[ST_MAX_LEN + 16];
+        uint32_t st_rk[SM4_KEY_SCHEDULE];
+        SM4_CBC_CTX ctx;
+        size_t off, n, ct_len, rt_len, out_len;
+        int ok = 1;
+
+        random_bytes(st_key, sizeof(st_key));
+        sm4_key_schedule(st_key, st_rk);
+
+        for (int t = 0; t < 200 && ok; t++) {
+            size_t len = (size_t)(rand() % ST_MAX_LEN);
+            size_t pad = 16 - len % 16;
+
+            random_bytes(pt, len);
+
+            /* Reference: pad by hand, one-shot encrypt */
+            memcpy(ref, pt, len);
+            memset(ref + len, (int)pad, pad);
+            sm4_cbc_encrypt(st_rk, iv, ref, ref, len + pad);
+
+            sm4_cbc_init(&ctx, st_key, iv, 1, 1);
+            ct_len = 0;
+            for (off = 0; off < len; off += n) {
+                n = (size_t)(rand() % 70);
+                n = n > len - off ? len - off : n;
+                ok &= sm4_cbc_update(&ctx, pt + off, ct + ct_len, n, &out_len);
+                ct_len += out_len;
+            }
+            ok &= sm4_cbc_final(&ctx, ct + ct_len, &out_len);
+            ct_len += out_len;
+            ok &= ct_len == len + pad && memcmp(ct, ref, ct_len) == 0;
+
+            sm4_cbc_init(&ctx, st_key, iv, 0, 1);
+            rt_len = 0;
+            for (off = 0; off < ct_len; off += n) {
+                n = (size_t)(rand() % 70);
+                n = n > ct_len - off ? ct_len - off : n;
+                ok &= sm4_cbc_update(&ctx, ct + off, rt + rt_len, n, &out_len);
+                rt_len += out_len;
+            }
+            ok &= sm4_cbc_final(&ctx, rt + rt_len, &out_len);
+            rt_len += out_len;
+            ok &= rt_len == len && memcmp(rt, pt, len) == 0;
+        }
+
+        /* Bad padding: pad byte 0, 17, and inconsistent pad bytes */
+        {
+            const uint8_t bad_last[3][2] = { { 0x00, 0x00 }, { 0x11, 0x11 }, { 0x05, 0x03 } };
+
+            for (int b = 0; b < 3; b++) {
+                random_bytes(ref, 32);
+                ref[30] = bad_last[b][1];
+                ref[31] = bad_last[b][0];
+                sm4_cbc_encrypt(st_rk, iv, ref, ct, 32);
+
+                sm4_cbc_init(&ctx, st_key, iv, 0, 1);
+                ok &= sm4_cbc_update(&ctx, ct, rt, 32, &out_len) && out_len == 16;
+                ok &= !sm4_cbc_final(&ctx, rt + 16, &out_len) && out_len == 0;
+            }
+            /* Truncated ciphertext */
+            sm4_cbc_init(&ctx, st_key, iv, 0, 1);
+            ok &= sm4_cbc_update(&ctx, ct, rt, 31, &out_len);
+            ok &= !sm4_cbc_final(&ctx, rt + 16, &out_len);
+        }
+
+        /* No padding: in-place block-aligned updates, unaligned total fails */
+        {
+            memcpy(rt, pt, 256);
+            sm4_cbc_encrypt(st_rk, iv, pt, ref, 256);
+            sm4_cbc_init(&ctx, st_key, iv, 1, 0);
+            ok &= sm4_cbc_update(&ctx, rt, rt, 48, &out_len) && out_len == 48;
+            ok &= sm4_cbc_update(&ctx, rt + 48, rt + 48, 208, &out_len) && out_len == 208;
+            ok &= sm4_cbc_final(&ctx, rt + 256, &out_len) && out_len == 0;
+            ok &= memcmp(rt, ref, 256) == 0;
+
+            sm4_cbc_init(&ctx, st_key, iv, 0, 0);
+            ok &= sm4_cbc_update(&ctx, rt, rt, 256, &out_len) && out_len == 256;
+            ok &= memcmp(rt, pt, 256) == 0;
+            ok &= sm4_cbc_update(&ctx, rt, rt, 5, &out_len) && out_len == 0;
+            ok &= !sm4_cbc_final(&ctx, rt, &out_len);
+        }
+        sm4_cbc_clean(&ctx);
+
+        if (ok) {
+            TEST_PASS("CBC streaming API with PKCS#7 padding");
+        } else {
+            TEST_FAIL("CBC streaming API with PKCS#7 padding");
+            pass = 0;
+        }
+    }
+
+    return pass;
+}
+
+/* ============================================================
+ * SM4 GCM Tests
+ * ============================================================ */
+
+/* Encrypt and decrypt through the streaming API in random pieces */
+static int gcm_stream_roundtrip(const uint8_t key[16], const uint8_t *iv, size_t iv_len,
+                                const uint8_t *aad, size_t aad_len,
+                                const uint8_t *pt, size_t len, uint8_t *ct, uint8_t tag[16])
+{
+    SM4_GCM_CTX ctx;
+    uint8_t *dec = malloc(len + 1);
+    size_t off, n;
+    int ok = 1;
+
+    sm4_gcm_init(&ctx, key, iv, iv_len);
+    for (off = 0; off < aad_len; off += n) {
+        n = (size_t)(rand() % 40);
+        n = n > aad_len - off ? aad_len - off : n;
+        sm4_gcm_update_aad(&ctx, aad + off, n);
+    }
+    for (off = 0; off < len; off += n) {
+        n = (size_t)(rand() % 300);
+        n = n > len - off ? len - off : n;
+        sm4_gcm_encrypt_update(&ctx, pt + off, ct + off, n);
+    }
+    sm4_gcm_encrypt_final(&ctx, tag, 16);
+
+    /* In-place decryption */
+    memcpy(dec, ct, len);
+    sm4_gcm_init(&ctx, key, iv, iv_len);
+    sm4_gcm_update_aad(&ctx, aad, aad_len);
+    for (off = 0; off < len; off += n) {
+        n = (size_t)(rand() % 300);
+        n = n > len - off ? len - off : n;
+        sm4_gcm_decrypt_update(&ctx, dec + off, dec + off, n);
+    }
+    ok &= sm4_gcm_decrypt_final(&ctx, tag, 16);
+    ok &= memcmp(dec, pt, len) == 0;
+    sm4_gcm_clean(&ctx);
+
+    free(dec);
+    return ok;
+}
+
+static int test_sm4_gcm(void)
+{
+    printf("\n========== SM4 GCM Correctness Test ==========\n");
+
+    /* RFC 8998 Appendix A.1 */
+    const uint8_t key[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+        0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    const uint8_t iv[12] = {
+        0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00,
+        0x00, 0x00, 0xAB, 0xCD
+    };
+    const uint8_t aad[20] = {
+        0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+        0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+        0xAB, 0xAD, 0xDA, 0xD2
+    };
+    const uint8_t pt[64] = {
+        0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA,
+        0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB,
+        0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+        0xDD, 0xDD, 0xDD, 0xDD, 0xDD, 0xDD, 0xDD, 0xDD,
+        0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE,
+        0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA
+    };
+    const uint8_t expected_ct[64] = {
+        0x17, 0xF3, 0x99, 0xF0, 0x8C, 0x67, 0xD5, 0xEE,
+        0x19, 0xD0, 0xDC, 0x99, 0x69, 0xC4, 0xBB, 0x7D,
+        0x5F, 0xD4, 0x6F, 0xD3, 0x75, 0x64, 0x89, 0x06,
+        0x91, 0x57, 0xB2, 0x82, 0xBB, 0x20, 0x07, 0x35,
+        0xD8, 0x27, 0x10, 0xCA, 0x5C, 0x22, 0xF0, 0xCC,
+        0xFA, 0x7C, 0xBF, 0x93, 0xD4, 0x96, 0xAC, 0x15,
+        0xA5, 0x68, 0x34, 0xCB, 0xCF, 0x98, 0xC3, 0x97,
+        0xB4, 0x02, 0x4A, 0x26, 0x91, 0x23, 0x3B, 0x8D
+    };
+    const uint8_t expected_tag[16] = {
+        0x83, 0xDE, 0x35, 0x41, 0xE4, 0xC2, 0xB5, 0x81,
+        0x77, 0xE0, 0x65, 0xA9, 0xBF, 0x7B, 0x62, 0xEC
+    };
+
+    /* 60-byte IV (J0 derived through GHASH), 13-byte AAD, 77-byte text */
+    const uint8_t expected_ct2[77] = {
+        0x4B, 0x07, 0x1F, 0xB6, 0xA6, 0x5B, 0x19, 0x7E,
+        0x3F, 0x0F, 0xEA, 0xB0, 0xF5, 0x61, 0x13, 0x51,
+        0x14, 0x0A, 0xAC, 0x8B, 0x32, 0x5B, 0xB2, 0x63,
+        0x4E, 0x32, 0x80, 0x0A, 0xA8, 0xBD, 0x9C, 0x54,
+        0x30, 0x9B, 0x97, 0xB3, 0xE5, 0x08, 0x3A, 0x74,
+        0xB1, 0x02, 0x35, 0xCC, 0x73, 0x03, 0xB0, 0xBA,
+        0x7C, 0x5D, 0xE1, 0x0A, 0x68, 0x0C, 0x1C, 0xB6,
+        0xF9, 0xD7, 0x1D, 0x44, 0xF3, 0x49, 0xD4, 0x30,
+        0x3C, 0x46, 0x39, 0x2B, 0x92, 0xFB, 0xE0, 0x93,
+        0x7D, 0xD9, 0xFF, 0x1F, 0x10
+    };
+    const uint8_t expected_tag2[16] = {
+        0xC6, 0x40, 0xF4, 0x43, 0x1D, 0xE0, 0xFD, 0x8D,
+        0xE5, 0x5D, 0x53, 0x2D, 0x1A, 0xD6, 0x3F, 0xDF
+    };
+
+    const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+    uint8_t ct[1024], out[1024], tag[16], iv2[60], aad2[13], pt2[77];
+    int pass = 1;
+
+    for (size_t i = 0; i < sizeof(iv2); i++) iv2[i] = (uint8_t)(i + 1);
+    for (size_t i = 0; i < sizeof(aad2); i++) aad2[i] = (uint8_t)(i + 200);
+    for (size_t i = 0; i < sizeof(pt2); i++) pt2[i] = (uint8_t)i;
+
+    /* PCLMULQDQ GHASH by default, 4-bit tables with the portable implementation */
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        char label[96];
+        int ok = 1;
+
+        sm4_set_impl(impls[k]);
+        sm4_gcm_set_ghash_impl(impls[k] == SM4_IMPL_PORTABLE ? SM4_GHASH_IMPL_PORTABLE : SM4_GHASH_IMPL_AUTO);
+
+        /* Test 1: RFC 8998 vector */
+        ok &= sm4_gcm_encrypt(key, iv, sizeof(iv), aad, sizeof(aad), pt, sizeof(pt), ct, tag, 16);
+        ok &= memcmp(ct, expected_ct, sizeof(expected_ct)) == 0;
+        ok &= memcmp(tag, expected_tag, sizeof(expected_tag)) == 0;
+        ok &= sm4_gcm_decrypt(key, iv, sizeof(iv), aad, sizeof(aad), ct, sizeof(pt), out, tag, 16);
+        ok &= memcmp(out, pt, sizeof(pt)) == 0;
+
+        /* Test 2: long IV, partial blocks */
+        ok &= sm4_gcm_encrypt(key, iv2, sizeof(iv2), aad2, sizeof(aad2), pt2, sizeof(pt2), ct, tag, 16);
+        ok &= memcmp(ct, expected_ct2, sizeof(expected_ct2)) == 0;
+        ok &= memcmp(tag, expected_tag2, sizeof(expected_tag2)) == 0;
+
+        snprintf(label, sizeof(label), "GCM test vectors (%s)", sm4_get_impl_name());
+        if (ok) {
+            TEST_PASS(label);
+        } else {
+            TEST_FAIL(label);
+            pass = 0;
+        }
+    }
+    sm4_set_impl(SM4_IMPL_AUTO);
+    sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL_AUTO);
+
+    /* Each GHASH implementation with the default SM4 one */
+    {
+        const SM4_GHASH_IMPL ghash[] = { SM4_GHASH_IMPL_PORTABLE, SM4_GHASH_IMPL_CLMUL };
+        int ok = sm4_gcm_set_ghash_impl((SM4_GHASH_IMPL)99) == 0;
+
+        for (size_t k = 0; k < sizeof(ghash) / sizeof(ghash[0]); k++) {
+            if (!sm4_gcm_set_ghash_impl(ghash[k])) {
+                continue;
+            }
+            ok &= sm4_gcm_encrypt(key, iv2, sizeof(iv2), aad2, sizeof(aad2), pt2, sizeof(pt2), ct, tag, 16);
+            ok &= memcmp(ct, expected_ct2, sizeof(expected_ct2)) == 0;
+            ok &= memcmp(tag, expected_tag2, sizeof(expected_tag2)) == 0;
+        }
+        sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL_AUTO);
+        if (ok) {
+            TEST_PASS("GCM GHASH implementations");
+        } else {
+            TEST_FAIL("GCM GHASH implementations");
+            pass = 0;
+        }
+    }
+
+    /* Test 3: tampering is detected and the output wiped */
+    {
+        int ok = 1;
+
+        sm4_gcm_encrypt(key, iv, sizeof(iv), aad, sizeof(aad), pt, sizeof(pt), ct, tag, 16);
+        ct[5] ^= 0x01;
+        ok &= !sm4_gcm_decrypt(key, iv, sizeof(iv), aad, sizeof(aad), ct, sizeof(pt), out, tag, 16);
+        ok &= out[0] == 0 && out[63] == 0;
+        ct[5] ^= 0x01;
+        tag[15] ^= 0x80;
+        ok &= !sm4_gcm_decrypt(key, iv, sizeof(iv), aad, sizeof(aad), ct, sizeof(pt), out, tag, 16);
+        tag[15] ^= 0x80;
+        ok &= !sm4_gcm_decrypt(key, iv, sizeof(iv), aad, sizeof(aad) - 1, ct, sizeof(pt), out, tag, 16);
+        /* Truncated tag */
+        ok &= sm4_gcm_decrypt(key, iv, sizeof(iv), aad, sizeof(aad), ct, sizeof(pt), out, tag, 12);
+
+        if (ok) {
+            TEST_PASS("GCM tag verification");
+        } else {
+            TEST_FAIL("GCM tag verification");
+            pass = 0;
+        }
+    }
+
+    /* Test 4: streaming in random pieces equals one-shot, both GHASH paths agree */
+    {
+        uint8_t k2[16], n2[16], a2[64], tag_ref[16], tag_port[16], ct_port[1024];
+        int ok = 1;
+
+        for (int t = 0; t < 200 && ok; t++) {
+            size_t len = (size_t)(rand() % 1024);
+            size_t aad_len = (size_t)(rand() % 64);
+            size_t iv_len = (t & 1) ? 12 : (size_t)(rand() % 16) + 1;
+
+            random_bytes(k2, 16);
+            random_bytes(n2, iv_len);
+            random_bytes(a2, aad_len);
+            random_bytes(out, len);
+
+            sm4_gcm_encrypt(k2, n2, iv_len, a2, aad_len, out, len, ct, tag_ref, 16);
+            sm4_set_impl(SM4_IMPL_PORTABLE);
+            sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL_PORTABLE);
+            sm4_gcm_encrypt(k2, n2, iv_len, a2, aad_len, out, len, ct_port, tag_port, 16);
+            sm4_set_impl(SM4_IMPL_AUTO);
+            sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL_AUTO);
+            ok &= memcmp(ct, ct_port, len) == 0 && memcmp(tag_ref, tag_port, 16) == 0;
+
+            ok &= gcm_stream_roundtrip(k2, n2, iv_len, a2, aad_len, out, len, ct, tag);
+            ok &= memcmp(tag, tag_ref, 16) == 0;
+        }
+
+        if (ok) {
+            TEST_PASS("GCM streaming / GHASH implementations consistency");
+        } else {
+            TEST_FAIL("GCM streaming / GHASH implementations consistency");
+            pass = 0;
+        }
+    }
+
+    return pass;
+}
+
+/* ============================================================
+ * SM4 CCM Tests
+ * ============================================================ */
+
+/* Encrypt and decrypt through the streaming API in random pieces */
+static int ccm_stream_roundtrip(const uint8_t key[16], const uint8_t *nonce, size_t nonce_len,
+                                const uint8_t *aad, size_t aad_len,
+                                const uint8_t *pt, size_t len, uint8_t *ct, uint8_t tag[16])
+{
+    SM4_CCM_CTX ctx;
+    uint8_t *dec = malloc(len + 1);
+    size_t off, n;
+    int ok = 1;
+
+    ok &= sm4_ccm_init(&ctx, key, nonce, nonce_len, aad_len, len, 16);
+    for (off = 0; off < aad_len; off += n) {
+        n = (size_t)(rand() % 40);
+        n = n > aad_len - off ? aad_len - off : n;
+        ok &= sm4_ccm_update_aad(&ctx, aad + off, n);
+    }
+    for (off = 0; off < len; off += n) {
+        n = (size_t)(rand() % 300);
+        n = n > len - off ? len - off : n;
+        ok &= sm4_ccm_encrypt_update(&ctx, pt + off, ct + off, n);
+    }
+    ok &= sm4_ccm_encrypt_final(&ctx, tag);
+
+    /* In-place decryption */
+    memcpy(dec, ct, len);
+    ok &= sm4_ccm_init(&ctx, key, nonce, nonce_len, aad_len, len, 16);
+    ok &= sm4_ccm_update_aad(&ctx, aad, aad_len);
+    for (off = 0; off < len; off += n) {
+        n = (size_t)(rand() % 300);
+        n = n > len - off ? len - off : n;
+        ok &= sm4_ccm_decrypt_update(&ctx, dec + off, dec + off, n);
+    }
+    ok &= sm4_ccm_decrypt_final(&ctx, tag);
+    ok &= memcmp(dec, pt, len) == 0;
+    sm4_ccm_clean(&ctx);
+
+    free(dec);
+    return ok;
+}
+
+static int test_sm4_ccm(void)
+{
+    printf("\n========== SM4 CCM Correctness Test ==========\n");
+
+    /* RFC 8998 Appendix A.2 */
+    const uint8_t key[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+        0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    const uint8_t nonce[12] = {
+        0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00,
+        0x00, 0x00, 0xAB, 0xCD
+    };
+    const uint8_t aad[20] = {
+        0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+        0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+        0xAB, 0xAD, 0xDA, 0xD2
+    };
+    const uint8_t pt[64] = {
+        0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA,
+        0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB,
+        0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+        0xDD, 0xDD, 0xDD, 0xDD, 0xDD, 0xDD, 0xDD, 0xDD,
+        0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE, 0xEE,
+        0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA
+    };
+    const uint8_t expected_ct[64] = {
+        0x48, 0xAF, 0x93, 0x50, 0x1F, 0xA6, 0x2A, 0xDB,
+        0xCD, 0x41, 0x4C, 0xCE, 0x60, 0x34, 0xD8, 0x95,
+        0xDD, 0xA1, 0xBF, 0x8F, 0x13, 0x2F, 0x04, 0x20,
+        0x98, 0x66, 0x15, 0x72, 0xE7, 0x48, 0x30, 0x94,
+        0xFD, 0x12, 0xE5, 0x18, 0xCE, 0x06, 0x2C, 0x98,
+        0xAC, 0xEE, 0x28, 0xD9, 0x5D, 0xF4, 0x41, 0x6B,
+        0xED, 0x31, 0xA2, 0xF0, 0x44, 0x76, 0xC1, 0x8B,
+        0xB4, 0x0C, 0x84, 0xA7, 0x4B, 0x97, 0xDC, 0x5B
+    };
+    const uint8_t expected_tag[16] = {
+        0x16, 0x84, 0x2D, 0x4F, 0xA1, 0x86, 0xF5, 0x6A,
+        0xB3, 0x32, 0x56, 0x97, 0x1F, 0xA1, 0x10, 0xF4
+    };
+
+    /* 7-byte nonce, 13-byte AAD, 77-byte text, 8-byte tag */
+    const uint8_t expected_ct2[77] = {
+        0xDC, 0x67, 0x0A, 0xB4, 0xAE, 0x04, 0x4F, 0x2E,
+        0x0E, 0xAD, 0x36, 0xC9, 0x9E, 0x86, 0x74, 0x26,
+        0xBC, 0xFF, 0xCD, 0x02, 0x73, 0x22, 0x53, 0x3F,
+        0x8A, 0x09, 0x5E, 0x21, 0xB4, 0x35, 0xE2, 0xAB,
+        0x05, 0x8B, 0xB7, 0x72, 0x5A, 0x25, 0x57, 0x7B,
+        0x60, 0x2D, 0xFD, 0x60, 0x6D, 0x6A, 0xEA, 0x91,
+        0x44, 0xD0, 0x2C, 0xC2, 0x3D, 0xEB, 0x0A, 0x30,
+        0xA5, 0xD5, 0x4D, 0x42, 0x82, 0x80, 0x01, 0x15,
+        0x85, 0xF1, 0x37, 0x0C, 0x07, 0x38, 0xDA, 0x9C,
+        0x7C, 0xC5, 0x44, 0xB0, 0xD9
+    };
+    const uint8_t expected_tag2[8] = {
+        0x98, 0xD1, 0x26, 0xD5, 0x9D, 0xC2, 0xD0, 0xA4
+    };
+
+    /* 13-byte nonce, no AAD, 33-byte text, 4-byte tag */
+    const uint8_t expected_ct3[33] = {
+        0x5A, 0x58, 0xE9, 0x98, 0x55, 0xC1, 0x3F, 0x32,
+        0xD1, 0xBF, 0xDF, 0x4A, 0x72, 0x77, 0x7B, 0xC9,
+        0xA4, 0x4C, 0x99, 0x9D, 0xEC, 0xB2, 0x0A, 0x40,
+        0x1C, 0x2A, 0x25, 0x9C, 0xB9, 0x2D, 0x68, 0x75,
+        0x1A
+    };
+    const uint8_t expected_tag3[4] = {
+        0xA2, 0xB8, 0xF8, 0x62
+    };
+
+    const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+    uint8_t ct[1024], out[1024], tag[16], nonce2[13], aad2[13], pt2[77];
+    int pass = 1;
+
+    for (size_t i = 0; i < sizeof(nonce2); i++) nonce2[i] = (uint8_t)(i + 1);
+    for (size_t i = 0; i < sizeof(aad2); i++) aad2[i] = (uint8_t)(i + 200);
+    for (size_t i = 0; i < sizeof(pt2); i++) pt2[i] = (uint8_t)i;
+
+    /* Paired MAC/CTR blocks by default, single-block rounds with the portable implementation */
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        char label[96];
+        int ok = 1;
+
+        sm4_set_impl(impls[k]);
+
+        /* Test 1: RFC 8998 vector */
+        ok &= sm4_ccm_encrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), pt, sizeof(pt), ct, tag, 16);
+        ok &= memcmp(ct, expected_ct, sizeof(expected_ct)) == 0;
+        ok &= memcmp(tag, expected_tag, sizeof(expected_tag)) == 0;
+        ok &= sm4_ccm_decrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), ct, sizeof(pt), out, tag, 16);
+        ok &= memcmp(out, pt, sizeof(pt)) == 0;
+
+        /* Test 2: short nonce, partial blocks, truncated tag */
+        ok &= sm4_ccm_encrypt(key, nonce2, 7, aad2, sizeof(aad2), pt2, sizeof(pt2), ct, tag, 8);
+        ok &= memcmp(ct, expected_ct2, sizeof(expected_ct2)) == 0;
+        ok &= memcmp(tag, expected_tag2, sizeof(expected_tag2)) == 0;
+
+        /* Test 3: long nonce, no AAD */
+        ok &= sm4_ccm_encrypt(key, nonce2, 13, NULL, 0, pt2, 33, ct, tag, 4);
+        ok &= memcmp(ct, expected_ct3, sizeof(expected_ct3)) == 0;
+        ok &= memcmp(tag, expected_tag3, sizeof(expected_tag3)) == 0;
+
+        snprintf(label, sizeof(label), "CCM test vectors (%s)", sm4_get_impl_name());
+        if (ok) {
+            TEST_PASS(label);
+        } else {
+            TEST_FAIL(label);
+            pass = 0;
+        }
+    }
+    sm4_set_impl(SM4_IMPL_AUTO);
+
+    /* Test 4: tampering, bad parameters and length mismatches are rejected */
+    {
+        SM4_CCM_CTX ctx;
+        int ok = 1;
+
+        sm4_ccm_encrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), pt, sizeof(pt), ct, tag, 16);
+        ct[5] ^= 0x01;
+        ok &= !sm4_ccm_decrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), ct, sizeof(pt), out, tag, 16);
+        ok &= out[0] == 0 && out[63] == 0;
+        ct[5] ^= 0x01;
+        tag[15] ^= 0x80;
+        ok &= !sm4_ccm_decrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), ct, sizeof(pt), out, tag, 16);
+        tag[15] ^= 0x80;
+        ok &= !sm4_ccm_decrypt(key, nonce, sizeof(nonce), aad, sizeof(aad) - 1, ct, sizeof(pt), out, tag, 16);
+        ok &= !sm4_ccm_decrypt(key, nonce, sizeof(nonce), aad, sizeof(aad), ct, sizeof(pt), out, tag, 12);
+
+        ok &= !sm4_ccm_init(&ctx, key, nonce, 6, 0, 16, 16);
+        ok &= !sm4_ccm_init(&ctx, key, nonce, 12, 0, 16, 15);
+        ok &= !sm4_ccm_init(&ctx, key, nonce, 13, 0, 1 << 16, 16);
+
+        /* Text before all AAD, more text than declared, final before all text */
+        ok &= sm4_ccm_init(&ctx, key, nonce, 12, 4, 32, 16);
+        ok &= !sm4_ccm_encrypt_update(&ctx, pt, ct, 16);
+        ok &= sm4_ccm_update_aad(&ctx, aad, 4);
+        ok &= !sm4_ccm_encrypt_update(&ctx, pt, ct, 33);
+        ok &= sm4_ccm_encrypt_update(&ctx, pt, ct, 16);
+        ok &= !sm4_ccm_encrypt_final(&ctx, tag);
+        sm4_ccm_clean(&ctx);
+
+        if (ok) {
+            TEST_PASS("CCM tag and parameter validation");
+        } else {
+            TEST_FAIL("CCM tag and parameter validation");
+            pass = 0;
+        }
+    }
+
+    /* Test 5: streaming in random pieces equals one-shot, both implementations agree */
+    {
+        uint8_t k2[16], n2[13], a2[64], tag_ref[16], tag_port[16], ct_port[1024];
+        int ok = 1;
+
+        for (int t = 0; t < 200 && ok; t++) {
+            size_t len = (size_t)(rand() % 1024);
+            size_t aad_len = (size_t)(rand() % 64);
+            size_t nonce_len = (size_t)(rand() % 7) + 7;
+
+            random_bytes(k2, 16);
+            random_bytes(n2, nonce_len);
+            random_bytes(a2, aad_len);
+            random_bytes(out, len);
+
+            ok &= sm4_ccm_encrypt(k2, n2, nonce_len, a2, aad_len, out, len, ct, tag_ref, 16);
+            sm4_set_impl(SM4_IMPL_PORTABLE);
+            sm4_ccm_encrypt(k2, n2, nonce_len, a2, aad_len, out, len, ct_port, tag_port, 16);
+            sm4_set_impl(SM4_IMPL_AUTO);
+            ok &= memcmp(ct, ct_port, len) == 0 && memcmp(tag_ref, tag_port, 16) == 0;
+
+            ok &= ccm_stream_roundtrip(k2, n2, nonce_len, a2, aad_len, out, len, ct, tag);
+            ok &= memcmp(tag, tag_ref, 16) == 0;
+        }
+
+        if (ok) {
+            TEST_PASS("CCM streaming / implementations consistency");
+        } else {
+            TEST_FAIL("CCM streaming / implementations consistency");
+            pass = 0;
+        }
+    }
+
+    return pass;
+}
+
+/* ============================================================
+ * SM4 XTS Tests
+ * ============================================================ */
+
+static int test_sm4_xts(void)
+{
+    printf("\n========== SM4 XTS Correctness Test ==========\n");
+
+    /* Data key || tweak key */
+    const uint8_t key[32] = {
+        0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+        0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+    };
+    const uint8_t iv[16] = {
+        0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+        0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+    };
+    const uint8_t pt[64] = {
+        0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+        0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+        0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+        0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+        0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+        0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+        0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+        0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+    };
+    const uint8_t expected_ct[64] = {
+        0xE9, 0x53, 0x82, 0x51, 0xC7, 0x1D, 0x7B, 0x80,
+        0xBB, 0xE4, 0x48, 0x3F, 0xEF, 0x49, 0x7B, 0xD1,
+        0xB3, 0xDB, 0x1A, 0x3E, 0x60, 0x40, 0x8C, 0x57,
+        0x5D, 0x63, 0xFF, 0x7D, 0xB3, 0x9F, 0x83, 0x26,
+        0x27, 0xD1, 0x6C, 0x0D, 0xB6, 0xD2, 0xCF, 0xC7,
+        0x41, 0x31, 0x46, 0x42, 0xED, 0x88, 0x07, 0x9D,
+        0x50, 0x36, 0x73, 0x8C, 0x35, 0x7C, 0xD2, 0x4D,
+        0x07, 0x81, 0xC9, 0xF4, 0x77, 0xF2, 0xD3, 0x16
+    };
+    /* First 55 bytes, the last two blocks use ciphertext stealing */
+    const uint8_t expected_ct2[55] = {
+        0xE9, 0x53, 0x82, 0x51, 0xC7, 0x1D, 0x7B, 0x80,
+        0xBB, 0xE4, 0x48, 0x3F, 0xEF, 0x49, 0x7B, 0xD1,
+        0xB3, 0xDB, 0x1A, 0x3E, 0x60, 0x40, 0x8C, 0x57,
+        0x5D, 0x63, 0xFF, 0x7D, 0xB3, 0x9F, 0x83, 0x26,
+        0x83, 0x73, 0xEA, 0xC6, 0x9B, 0x3C, 0xD9, 0xC0,
+        0xCF, 0x24, 0xE4, 0xCA, 0x7A, 0x8F, 0xCF, 0xF3,
+        0x27, 0xD1, 0x6C, 0x0D, 0xB6, 0xD2, 0xCF
+    };
+
+    const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+    SM4_XTS_CTX ctx;
+    uint8_t ct[64], out[64];
+    int pass = 1;
+
+    sm4_xts_init(&ctx, key);
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        char label[96];
+        int ok = 1;
+
+        sm4_set_impl(impls[k]);
+
+        /* Test 1: whole blocks */
+        ok &= sm4_xts_encrypt(&ctx, iv, pt, ct, sizeof(pt));
+        ok &= memcmp(ct, expected_ct, sizeof(expected_ct)) == 0;
+        ok &= sm4_xts_decrypt(&ctx, iv, ct, out, sizeof(pt));
+        ok &= memcmp(out, pt, sizeof(pt)) == 0;
+
+        /* Test 2: ciphertext stealing, in place */
+        memcpy(out, pt, sizeof(expected_ct2));
+        ok &= sm4_xts_encrypt(&ctx, iv, out, out, sizeof(expected_ct2));
+        ok &= memcmp(out, expected_ct2, sizeof(expected_ct2)) == 0;
+        ok &= sm4_xts_decrypt(&ctx, iv, out, out, sizeof(expected_ct2));
+        ok &= memcmp(out, pt, sizeof(expected_ct2)) == 0;
+
+        snprintf(label, sizeof(label), "XTS test vectors (%s)", sm4_get_impl_name());
+        if (ok) {
+            TEST_PASS(label);
+        } else {
+            TEST_FAIL(label);
+            pass = 0;
+        }
+    }
+    sm4_set_impl(SM4_IMPL_AUTO);
+
+    /* Test 3: invalid parameters */
+    {
+        SM4_XTS_CTX bad;
+        uint8_t same[32];
+        int ok = 1;
+
+        memcpy(same, key, 16);
+        memcpy(same + 16, key, 16);
+        ok &= !sm4_xts_init(&bad, same);
+        ok &= !sm4_xts_encrypt(&ctx, iv, pt, ct, 15);
+        ok &= !sm4_xts_decrypt(&ctx, iv, ct, out, 0);
+        ok &= !sm4_xts_encrypt_sectors(&ctx, 0, 8, pt, ct, 8);
+
+        if (ok) {
+            TEST_PASS("XTS parameter validation");
+        } else {
+            TEST_FAIL("XTS parameter validation");
+            pass = 0;
+        }
+    }
+
+    /* Test 4: sector batches equal one call per sector, including tweak carry */
+    {
+        const size_t sector_sizes[] = { 16, 520, 512, 4096 };
+        const u8 first[] = { 0, 0xFFFFFFFFFFFFFFF0ULL };
+        size_t nsectors = 37;
+        size_t max_len = nsectors * 4096;
+        uint8_t *data = malloc(max_len);
+        uint8_t *batch = malloc(max_len);
+        uint8_t *ref = malloc(max_len);
+        int ok = 1;
+
+        random_bytes(data, max_len);
+
+        for (size_t z = 0; z < sizeof(sector_sizes) / sizeof(sector_sizes[0]); z++) {
+            for (size_t f = 0; f < sizeof(first) / sizeof(first[0]); f++) {
+                size_t sz = sector_sizes[z];
+
+                for (size_t s = 0; s < nsectors; s++) {
+                    uint8_t tweak[16] = {0};
+                    u8 sector = first[f] + s;
+
+                    for (int b = 0; b < 8; b++) {
+                        tweak[b] = (uint8_t)(sector >> (8 * b));
+                    }
+                    tweak[8] = sector < first[f];
+                    sm4_xts_encrypt(&ctx, tweak, data + s * sz, ref + s * sz, sz);
+                }
+
+                ok &= sm4_xts_encrypt_sectors(&ctx, first[f], sz, data, batch, nsectors);
+                ok &= memcmp(batch, ref, nsectors * sz) == 0;
+                ok &= sm4_xts_decrypt_sectors(&ctx, first[f], sz, batch, batch, nsectors);
+                ok &= memcmp(batch, data, nsectors * sz) == 0;
+            }
+        }
+
+        free(data);
+        free(batch);
+        free(ref);
+
+        if (ok) {
+            TEST_PASS("XTS sector batches");
+        } else {
+            TEST_FAIL("XTS sector batches");
+            pass = 0;
+        }
+    }
+
+    sm4_xts_clean(&ctx);
     return pass;
 }
 
@@ -708,6 +1816,81 @@ static int test_sm4_cbc_vs_openssl(void)
         return 0;
     }
 }
+static int test_sm4_cbc_pkcs7_vs_openssl(void)
+{
+    printf("\n========== SM4 CBC PKCS#7 vs OpenSSL Test ==========\n");
+
+    uint8_t key[16], iv[16];
+    uint8_t *plaintext = malloc(4096);
+    uint8_t *our_result = malloc(4096 + 16);
+    uint8_t *openssl_result = malloc(4096 + 16);
+    int fail_count = 0;
+
+    for (int test = 0; test < NTESTS; test++) {
+        size_t len = (size_t)(rand() % 4096);
+        size_t our_len, out_len;
+        int openssl_len = -1, tmplen;
+        SM4_CBC_CTX ctx;
+        EVP_CIPHER_CTX *evp = EVP_CIPHER_CTX_new();
+
+        random_bytes(key, 16);
+        random_bytes(iv, 16);
+        random_bytes(plaintext, len);
+
+        /* Our implementation, split at a random point */
+        size_t split = len ? (size_t)rand() % len : 0;
+        sm4_cbc_init(&ctx, key, iv, 1, 1);
+        sm4_cbc_update(&ctx, plaintext, our_result, split, &our_len);
+        sm4_cbc_update(&ctx, plaintext + split, our_result + our_len, len - split, &out_len);
+        our_len += out_len;
+        sm4_cbc_final(&ctx, our_result + our_len, &out_len);
+        our_len += out_len;
+
+        /* OpenSSL with its default PKCS#7 padding */
+        if (evp && EVP_EncryptInit_ex(evp, EVP_sm4_cbc(), NULL, key, iv) == 1 &&
+            EVP_EncryptUpdate(evp, openssl_result, &openssl_len, plaintext, (int)len) == 1 &&
+            EVP_EncryptFinal_ex(evp, openssl_result + openssl_len, &tmplen) == 1) {
+            openssl_len += tmplen;
+        } else {
+            openssl_len = -1;
+        }
+        EVP_CIPHER_CTX_free(evp);
+
+        if (openssl_len < 0 || our_len != (size_t)openssl_len ||
+            memcmp(our_result, openssl_result, our_len) != 0) {
+            fail_count++;
+            if (fail_count <= 3) {
+                printf("[FAIL] Encryption mismatch at test %d, len=%zu\n", test, len);
+            }
+            continue;
+        }
+
+        /* Decrypt OpenSSL's ciphertext */
+        sm4_cbc_init(&ctx, key, iv, 0, 1);
+        if (!sm4_cbc_update(&ctx, openssl_result, our_result, (size_t)openssl_len, &our_len) ||
+            !sm4_cbc_final(&ctx, our_result + our_len, &out_len) ||
+            our_len + out_len != len || memcmp(our_result, plaintext, len) != 0) {
+            fail_count++;
+            if (fail_count <= 3) {
+                printf("[FAIL] Decryption failed at test %d, len=%zu\n", test, len);
+            }
+        }
+        sm4_cbc_clean(&ctx);
+    }
+
+    free(plaintext);
+    free(our_result);
+    free(openssl_result);
+
+    if (fail_count == 0) {
+        printf("[PASS] All %d tests passed against OpenSSL\n", NTESTS);
+        return 1;
+    } else {
+        printf("[FAIL] %d/%d tests failed against OpenSSL\n", fail_count, NTESTS);
+        return 0;
+    }
+}
+
 #endif
 
 /* ============================================================
@@ -729,6 +1912,20 @@ int main(void)
         all_pass = 0;
     }
 
+    /* Multi-block ECB */
+    if (!test_sm4_multi_block()) {
+        all_pass = 0;
+    }
+
+    /* SIMD / bit-sliced backends */
+    if (!test_sm4_backends()) {
+        all_pass = 0;
+    }
+
+    if (!test_sm4_impl_select()) {
+        all_pass = 0;
+    }
+
     /* CTR self check */
     if (!sm4_ctr_self_check()) {
         all_pass = 0;
@@ -739,6 +1936,21 @@ int main(void)
         all_pass = 0;
     }
 
+    /* GCM */
+    if (!test_sm4_gcm()) {
+        all_pass = 0;
+    }
+
+    /* CCM */
+    if (!test_sm4_ccm()) {
+        all_pass = 0;
+    }
+
+    /* XTS */
+    if (!test_sm4_xts()) {
+        all_pass = 0;
+    }
+
 #ifdef TEST_WITH_OPENSSL
     /* CTR vs OpenSSL */
     if (!test_sm4_ctr_vs_openssl()) {
@@ -749,6 +1961,11 @@ int main(void)
     if (!test_sm4_cbc_vs_openssl()) {
         all_pass = 0;
     }
+
+    /* CBC with padding vs OpenSSL */
+    if (!test_sm4_cbc_pkcs7_vs_openssl()) {
+        all_pass = 0;
+    }
 #else
     printf("\n[INFO] Compile with TEST_WITH_OPENSSL=1 to test against OpenSSL\n");
 #endif
@@ -111,6 +111,37 @@ static void bench_sm4_ecb(void)
 
     double mb_per_sec = (total_bytes / 1e6) / elapsed;
     print_speed("sm4_encrypt (ref)", mb_per_sec);
+
+    /* Multi-block: 32 independent blocks per call, for each implementation */
+    const SM4_IMPL impls[] = { SM4_IMPL_PORTABLE, SM4_IMPL_AESNI, SM4_IMPL_GFNI, SM4_IMPL_ARMV8 };
+    __attribute__((aligned(64))) uint8_t mbuf[32 * 16];
+    char name[64];
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (!sm4_set_impl(impls[k])) {
+            continue;
+        }
+
+        memset(mbuf, 0x55, sizeof(mbuf));
+        total_bytes = 0;
+        iterations = 16;
+        start = get_time_sec();
+
+        do {
+            for (uint64_t i = 0; i < iterations; i++) {
+                sm4_encrypt_blocks(rk, mbuf, mbuf, 32);
+            }
+            total_bytes += sizeof(mbuf) * iterations;
+            iterations <<= 1;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        mb_per_sec = (total_bytes / 1e6) / elapsed;
+        snprintf(name, sizeof(name), "sm4_encrypt_blocks (%s)", sm4_get_impl_name());
+        print_speed(name, mb_per_sec);
+    }
+
+    sm4_set_impl(SM4_IMPL_AUTO);
 }
 
 /* ============================================================
@@ -290,6 +321,71 @@ static void bench_sm4_cbc(void)
         print_speed("sm4_cbc_decrypt (ref)", mb_per_sec);
     }
 
+    /* Benchmark in-place decryption in 64KB chunks through the chaining state */
+    {
+        uint64_t total_bytes = 0;
+        int iterations = 0;
+        double start = get_time_sec();
+        double elapsed;
+
+        do {
+            uint8_t chain[16];
+            size_t chunk_size = 64 * 1024;
+
+            memcpy(chain, iv, sizeof(chain));
+            for (size_t offset = 0; offset < data_size; offset += chunk_size) {
+                size_t len = (offset + chunk_size <= data_size) ? chunk_size : (data_size - offset);
+                sm4_cbc_decrypt_chain(rk, chain, output + offset, output + offset, len, chain);
+            }
+
+            total_bytes += data_size;
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        double mb_per_sec = (total_bytes / 1e6) / elapsed;
+        print_speed("sm4_cbc_decrypt in-place (64KB)", mb_per_sec);
+    }
+
+    /* Benchmark the streaming API: padded decryption in 4KB updates */
+    {
+        SM4_CBC_CTX ctx;
+        uint8_t *plain = malloc(data_size + 16);
+        size_t ct_len, out_len;
+        uint64_t total_bytes = 0;
+        int iterations = 0;
+
+        sm4_cbc_init(&ctx, key, iv, 1, 1);
+        sm4_cbc_update(&ctx, input, output, data_size - 16, &ct_len);
+        sm4_cbc_final(&ctx, output + ct_len, &out_len);
+        ct_len += out_len;
+
+        double start = get_time_sec();
+        double elapsed;
+
+        do {
+            size_t chunk_size = 4096, pt_len = 0;
+
+            sm4_cbc_init(&ctx, key, iv, 0, 1);
+            for (size_t offset = 0; offset < ct_len; offset += chunk_size) {
+                size_t len = (offset + chunk_size <= ct_len) ? chunk_size : (ct_len - offset);
+                sm4_cbc_update(&ctx, output + offset, plain + pt_len, len, &out_len);
+                pt_len += out_len;
+            }
+            sm4_cbc_final(&ctx, plain + pt_len, &out_len);
+
+            total_bytes += data_size;
+            iterations++;
+            elapsed = get_time_sec() - start;
+        } while (elapsed < MIN_BENCH_TIME);
+
+        double mb_per_sec = (total_bytes / 1e6) / elapsed;
+        print_speed("sm4_cbc_update decrypt (4KB)", mb_per_sec);
+
+        sm4_cbc_clean(&ctx);
+        free(plain);
+    }
+
 #ifdef TEST_WITH_OPENSSL
     /* Benchmark OpenSSL */
     {
@@ -310,10 +406,245 @@ static void bench_sm4_cbc(void)
     }
 #endif
 
+    /* Benchmark multi-buffer encryption: independent 16KB streams, one key each */
+    {
+        enum { MB_STREAMS = 64 };
+        const size_t stream_len = 16 * 1024;
+        const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+        static uint32_t rks[MB_STREAMS][SM4_KEY_SCHEDULE];
+        SM4_CBC_JOB jobs[MB_STREAMS];
+        char name[64];
+
+        for (size_t j = 0; j < MB_STREAMS; j++) {
+            uint8_t k_j[16];
+
+            memcpy(k_j, key, sizeof(k_j));
+            k_j[0] ^= (uint8_t)j;
+            sm4_key_schedule(k_j, rks[j]);
+            jobs[j].rk = rks[j];
+            jobs[j].iv = iv;
+            jobs[j].length = stream_len;
+        }
+
+        for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+            uint64_t total_bytes = 0;
+            double start, elapsed;
+
+            sm4_set_impl(impls[k]);
+            start = get_time_sec();
+
+            do {
+                for (size_t off = 0; off + MB_STREAMS * stream_len <= data_size;
+                     off += MB_STREAMS * stream_len) {
+                    for (size_t j = 0; j < MB_STREAMS; j++) {
+                        jobs[j].input = input + off + j * stream_len;
+                        jobs[j].output = output + off + j * stream_len;
+                    }
+                    sm4_cbc_encrypt_mb(jobs, MB_STREAMS);
+                }
+                total_bytes += data_size;
+                elapsed = get_time_sec() - start;
+            } while (elapsed < MIN_BENCH_TIME);
+
+            snprintf(name, sizeof(name), "sm4_cbc_encrypt_mb x%d (%s)", MB_STREAMS, sm4_get_impl_name());
+            print_speed(name, (total_bytes / 1e6) / elapsed);
+        }
+        sm4_set_impl(SM4_IMPL_AUTO);
+    }
+
+    free(input);
+    free(output);
+}
+
+/* ============================================================
+ * GCM Benchmark
+ * ============================================================ */
+
+static void bench_sm4_gcm(void)
+{
+    printf("\n========== SM4 GCM Benchmark ==========\n");
+
+    const uint8_t key[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+        0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    const uint8_t iv[12] = {
+        0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00,
+        0x00, 0x00, 0xAB, 0xCD
+    };
+    const uint8_t aad[13] = {0};
+    const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+    /* Bulk data and TLS sized records */
+    const size_t sizes[] = { DATA_SIZE_MB * 1024 * 1024, 16 * 1024 };
+
+    size_t data_size = DATA_SIZE_MB * 1024 * 1024;
+    uint8_t *input = aligned_alloc(64, data_size);
+    uint8_t *output = aligned_alloc(64, data_size);
+    uint8_t tag[16];
+    char name[64];
+
+    if (!input || !output) {
+        printf("  [ERROR] Failed to allocate memory\n");
+        free(input);
+        free(output);
+        return;
+    }
+
+    memset(input, 0xAA, data_size);
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        sm4_set_impl(impls[k]);
+        sm4_gcm_set_ghash_impl(impls[k] == SM4_IMPL_PORTABLE ? SM4_GHASH_IMPL_PORTABLE : SM4_GHASH_IMPL_AUTO);
+
+        for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+            uint64_t total_bytes = 0;
+            double start = get_time_sec();
+            double elapsed;
+
+            do {
+                for (size_t off = 0; off + sizes[z] <= data_size; off += sizes[z]) {
+                    sm4_gcm_encrypt(key, iv, sizeof(iv), aad, sizeof(aad),
+                                    input + off, sizes[z], output + off, tag, 16);
+                }
+                total_bytes += data_size;
+                elapsed = get_time_sec() - start;
+            } while (elapsed < MIN_BENCH_TIME);
+
+            snprintf(name, sizeof(name), "sm4_gcm %s (%s)",
+                     z == 0 ? "bulk" : "16KB records", sm4_get_impl_name());
+            print_speed(name, (total_bytes / 1e6) / elapsed);
+        }
+    }
+    sm4_set_impl(SM4_IMPL_AUTO);
+    sm4_gcm_set_ghash_impl(SM4_GHASH_IMPL_AUTO);
+
+    free(input);
+    free(output);
+}
+
+/* ============================================================
+ * CCM Benchmark
+ * ============================================================ */
+
+static void bench_sm4_ccm(void)
+{
+    printf("\n========== SM4 CCM Benchmark ==========\n");
+
+    const uint8_t key[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+        0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    /* 12-byte nonces limit messages to 16 MB, the bulk run needs a wider length field */
+    const uint8_t nonce[8] = {
+        0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0xAB, 0xCD
+    };
+    const uint8_t aad[13] = {0};
+    const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+    /* Bulk data and TLS sized records */
+    const size_t sizes[] = { DATA_SIZE_MB * 1024 * 1024, 16 * 1024 };
+
+    size_t data_size = DATA_SIZE_MB * 1024 * 1024;
+    uint8_t *input = aligned_alloc(64, data_size);
+    uint8_t *output = aligned_alloc(64, data_size);
+    uint8_t tag[16];
+    char name[64];
+
+    if (!input || !output) {
+        printf("  [ERROR] Failed to allocate memory\n");
+        free(input);
+        free(output);
+        return;
+    }
+
+    memset(input, 0xAA, data_size);
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        sm4_set_impl(impls[k]);
+
+        for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+            uint64_t total_bytes = 0;
+            double start = get_time_sec();
+            double elapsed;
+
+            do {
+                for (size_t off = 0; off + sizes[z] <= data_size; off += sizes[z]) {
+                    sm4_ccm_encrypt(key, nonce, sizeof(nonce), aad, sizeof(aad),
+                                    input + off, sizes[z], output + off, tag, 16);
+                }
+                total_bytes += data_size;
+                elapsed = get_time_sec() - start;
+            } while (elapsed < MIN_BENCH_TIME);
+
+            snprintf(name, sizeof(name), "sm4_ccm %s (%s)",
+                     z == 0 ? "bulk" : "16KB records", sm4_get_impl_name());
+            print_speed(name, (total_bytes / 1e6) / elapsed);
+        }
+    }
+    sm4_set_impl(SM4_IMPL_AUTO);
+
     free(input);
     free(output);
 }
 
+/* ============================================================
+ * XTS Benchmark
+ * ============================================================ */
+
+static void bench_sm4_xts(void)
+{
+    printf("\n========== SM4 XTS Benchmark ==========\n");
+
+    const uint8_t key[32] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+        0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+    };
+    const SM4_IMPL impls[] = { SM4_IMPL_AUTO, SM4_IMPL_PORTABLE };
+    /* Disk sector and page sized data units */
+    const size_t sizes[] = { 512, 4096 };
+
+    size_t data_size = DATA_SIZE_MB * 1024 * 1024;
+    uint8_t *input = aligned_alloc(64, data_size);
+    uint8_t *output = aligned_alloc(64, data_size);
+    SM4_XTS_CTX ctx;
+    char name[64];
+
+    if (!input || !output) {
+        printf("  [ERROR] Failed to allocate memory\n");
+        free(input);
+        free(output);
+        return;
+    }
+
+    memset(input, 0xAA, data_size);
+    sm4_xts_init(&ctx, key);
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        sm4_set_impl(impls[k]);
+
+        for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+            uint64_t total_bytes = 0;
+            double start = get_time_sec();
+            double elapsed;
+
+            do {
+                sm4_xts_encrypt_sectors(&ctx, 0, sizes[z], input, output, data_size / sizes[z]);
+                total_bytes += data_size;
+                elapsed = get_time_sec() - start;
+            } while (elapsed < MIN_BENCH_TIME);
+
+            snprintf(name, sizeof(name), "sm4_xts %zuB sectors (%s)",
+                     sizes[z], sm4_get_impl_name());
+            print_speed(name, (total_bytes / 1e6) / elapsed);
+        }
+    }
+    sm4_set_impl(SM4_IMPL_AUTO);
+    sm4_xts_clean(&ctx);
+
+    free(input);
+    free(output);
+}
 /* ============================================================
  * Throughput for various data sizes
  * ============================================================ */
@@ -392,6 +723,7 @@ int main(void)
     printf("============================================\n");
     printf("  Data size: %d MB\n", DATA_SIZE_MB);
     printf("  Min bench time: %.1f sec\n", MIN_BENCH_TIME);
+    printf("  SM4 implementation: %s\n", sm4_get_impl_name());
 #ifdef TEST_WITH_OPENSSL
     printf("  OpenSSL comparison: enabled\n");
 #else
@@ -402,6 +734,9 @@ int main(void)
     bench_sm4_ecb();
     bench_sm4_ctr();
     bench_sm4_cbc();
+    bench_sm4_gcm();
+    bench_sm4_ccm();
+    bench_sm4_xts();
     bench_sm4_ctr_sizes();
 
     printf("\n============================================\n");